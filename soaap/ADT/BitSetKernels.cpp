@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "ADT/BitSetKernels.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SOAAP_BITSET_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+using namespace soaap;
+
+typedef BitSetKernels::WordType WordType;
+
+//
+// Portable versions
+//
+static bool orIntoScalar(WordType* dst, const WordType* src, size_t n) {
+  WordType diff = 0;
+  for (size_t i=0; i<n; i++) {
+    diff |= src[i] & ~dst[i];
+    dst[i] |= src[i];
+  }
+  return diff != 0;
+}
+
+static bool andIntoScalar(WordType* dst, const WordType* src, size_t n) {
+  WordType diff = 0;
+  for (size_t i=0; i<n; i++) {
+    diff |= dst[i] & ~src[i];
+    dst[i] &= src[i];
+  }
+  return diff != 0;
+}
+
+static unsigned popcountScalar(const WordType* words, size_t n) {
+  unsigned count = 0;
+  for (size_t i=0; i<n; i++) {
+    count += llvm::countPopulation(words[i]);
+  }
+  return count;
+}
+
+static bool equalScalar(const WordType* a, const WordType* b, size_t n) {
+  for (size_t i=0; i<n; i++) {
+    if (a[i] != b[i]) return false;
+  }
+  return true;
+}
+
+static bool noneScalar(const WordType* words, size_t n) {
+  for (size_t i=0; i<n; i++) {
+    if (words[i]) return false;
+  }
+  return true;
+}
+
+#ifdef SOAAP_BITSET_X86_KERNELS
+
+//
+// SSE2 versions: two words per step. There is no byte shuffle in SSE2, so
+// popcount stays scalar (but benefits from -mpopcnt if enabled).
+//
+__attribute__((target("sse2")))
+static bool orIntoSSE2(WordType* dst, const WordType* src, size_t n) {
+  __m128i diff = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i+2<=n; i+=2) {
+    __m128i D = _mm_loadu_si128((const __m128i*)(dst+i));
+    __m128i S = _mm_loadu_si128((const __m128i*)(src+i));
+    diff = _mm_or_si128(diff, _mm_andnot_si128(D, S));
+    _mm_storeu_si128((__m128i*)(dst+i), _mm_or_si128(D, S));
+  }
+  bool changed = _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF;
+  return orIntoScalar(dst+i, src+i, n-i) || changed;
+}
+
+__attribute__((target("sse2")))
+static bool andIntoSSE2(WordType* dst, const WordType* src, size_t n) {
+  __m128i diff = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i+2<=n; i+=2) {
+    __m128i D = _mm_loadu_si128((const __m128i*)(dst+i));
+    __m128i S = _mm_loadu_si128((const __m128i*)(src+i));
+    diff = _mm_or_si128(diff, _mm_andnot_si128(S, D));
+    _mm_storeu_si128((__m128i*)(dst+i), _mm_and_si128(D, S));
+  }
+  bool changed = _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF;
+  return andIntoScalar(dst+i, src+i, n-i) || changed;
+}
+
+__attribute__((target("sse2")))
+static bool equalSSE2(const WordType* a, const WordType* b, size_t n) {
+  size_t i = 0;
+  for (; i+2<=n; i+=2) {
+    __m128i A = _mm_loadu_si128((const __m128i*)(a+i));
+    __m128i B = _mm_loadu_si128((const __m128i*)(b+i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(A, B)) != 0xFFFF) return false;
+  }
+  return equalScalar(a+i, b+i, n-i);
+}
+
+__attribute__((target("sse2")))
+static bool noneSSE2(const WordType* words, size_t n) {
+  __m128i acc = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i+2<=n; i+=2) {
+    acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i*)(words+i)));
+  }
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xFFFF) return false;
+  return noneScalar(words+i, n-i);
+}
+
+//
+// AVX2 versions: four words per step. Popcount uses the nibble lookup
+// table approach (vpshufb), summing byte counts with vpsadbw.
+//
+__attribute__((target("avx2")))
+static bool orIntoAVX2(WordType* dst, const WordType* src, size_t n) {
+  __m256i diff = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i+4<=n; i+=4) {
+    __m256i D = _mm256_loadu_si256((const __m256i*)(dst+i));
+    __m256i S = _mm256_loadu_si256((const __m256i*)(src+i));
+    diff = _mm256_or_si256(diff, _mm256_andnot_si256(D, S));
+    _mm256_storeu_si256((__m256i*)(dst+i), _mm256_or_si256(D, S));
+  }
+  bool changed = !_mm256_testz_si256(diff, diff);
+  return orIntoScalar(dst+i, src+i, n-i) || changed;
+}
+
+__attribute__((target("avx2")))
+static bool andIntoAVX2(WordType* dst, const WordType* src, size_t n) {
+  __m256i diff = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i+4<=n; i+=4) {
+    __m256i D = _mm256_loadu_si256((const __m256i*)(dst+i));
+    __m256i S = _mm256_loadu_si256((const __m256i*)(src+i));
+    diff = _mm256_or_si256(diff, _mm256_andnot_si256(S, D));
+    _mm256_storeu_si256((__m256i*)(dst+i), _mm256_and_si256(D, S));
+  }
+  bool changed = !_mm256_testz_si256(diff, diff);
+  return andIntoScalar(dst+i, src+i, n-i) || changed;
+}
+
+__attribute__((target("avx2")))
+static unsigned popcountAVX2(const WordType* words, size_t n) {
+  const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i lowMask = _mm256_set1_epi8(0x0f);
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i+4<=n; i+=4) {
+    __m256i V = _mm256_loadu_si256((const __m256i*)(words+i));
+    __m256i lo = _mm256_and_si256(V, lowMask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(V, 4), lowMask);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+  }
+  uint64_t lanes[4];
+  _mm256_storeu_si256((__m256i*)lanes, acc);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + popcountScalar(words+i, n-i);
+}
+
+__attribute__((target("avx2")))
+static bool equalAVX2(const WordType* a, const WordType* b, size_t n) {
+  size_t i = 0;
+  for (; i+4<=n; i+=4) {
+    __m256i A = _mm256_loadu_si256((const __m256i*)(a+i));
+    __m256i B = _mm256_loadu_si256((const __m256i*)(b+i));
+    __m256i X = _mm256_xor_si256(A, B);
+    if (!_mm256_testz_si256(X, X)) return false;
+  }
+  return equalScalar(a+i, b+i, n-i);
+}
+
+__attribute__((target("avx2")))
+static bool noneAVX2(const WordType* words, size_t n) {
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i+4<=n; i+=4) {
+    acc = _mm256_or_si256(acc, _mm256_loadu_si256((const __m256i*)(words+i)));
+  }
+  if (!_mm256_testz_si256(acc, acc)) return false;
+  return noneScalar(words+i, n-i);
+}
+
+#endif
+
+const BitSetKernels::Impl& BitSetKernels::getImpl() {
+  static const Impl scalarImpl = { "scalar", orIntoScalar, andIntoScalar, popcountScalar, equalScalar, noneScalar };
+#ifdef SOAAP_BITSET_X86_KERNELS
+  static const Impl sse2Impl = { "sse2", orIntoSSE2, andIntoSSE2, popcountScalar, equalSSE2, noneSSE2 };
+  static const Impl avx2Impl = { "avx2", orIntoAVX2, andIntoAVX2, popcountAVX2, equalAVX2, noneAVX2 };
+  static const Impl& selected = __builtin_cpu_supports("avx2") ? avx2Impl
+                              : __builtin_cpu_supports("sse2") ? sse2Impl
+                              : scalarImpl;
+  return selected;
+#else
+  return scalarImpl;
+#endif
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_ADT_BITSETKERNELS_H
+#define SOAAP_ADT_BITSETKERNELS_H
+
+#include "llvm/Support/MathExtras.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace soaap {
+
+  // Word-parallel operations over arrays of 64-bit words, shared by the
+  // dense bit sets used as dataflow facts. Each operation makes a single
+  // pass over its operands. On x86 the AVX2 or SSE2 versions are picked
+  // at first use according to what the host CPU supports, otherwise (and
+  // for arrays of a couple of words, where the call would cost more than
+  // the loop) the portable versions are used.
+  class BitSetKernels {
+    public:
+      typedef uint64_t WordType;
+
+      // dst[i] |= src[i] for i < n; returns true if dst changed
+      static bool orInto(WordType* dst, const WordType* src, size_t n) {
+        if (n <= INLINE_WORDS) {
+          WordType diff = 0;
+          for (size_t i=0; i<n; i++) {
+            diff |= src[i] & ~dst[i];
+            dst[i] |= src[i];
+          }
+          return diff != 0;
+        }
+        return getImpl().orInto(dst, src, n);
+      }
+
+      // dst[i] &= src[i] for i < n; returns true if dst changed
+      static bool andInto(WordType* dst, const WordType* src, size_t n) {
+        if (n <= INLINE_WORDS) {
+          WordType diff = 0;
+          for (size_t i=0; i<n; i++) {
+            diff |= dst[i] & ~src[i];
+            dst[i] &= src[i];
+          }
+          return diff != 0;
+        }
+        return getImpl().andInto(dst, src, n);
+      }
+
+      // number of bits set in words[0..n)
+      static unsigned popcount(const WordType* words, size_t n) {
+        if (n <= INLINE_WORDS) {
+          unsigned count = 0;
+          for (size_t i=0; i<n; i++) {
+            count += llvm::countPopulation(words[i]);
+          }
+          return count;
+        }
+        return getImpl().popcount(words, n);
+      }
+
+      // a[0..n) == b[0..n)
+      static bool equal(const WordType* a, const WordType* b, size_t n) {
+        if (n <= INLINE_WORDS) {
+          for (size_t i=0; i<n; i++) {
+            if (a[i] != b[i]) return false;
+          }
+          return true;
+        }
+        return getImpl().equal(a, b, n);
+      }
+
+      // no bits set in words[0..n)
+      static bool none(const WordType* words, size_t n) {
+        if (n <= INLINE_WORDS) {
+          for (size_t i=0; i<n; i++) {
+            if (words[i]) return false;
+          }
+          return true;
+        }
+        return getImpl().none(words, n);
+      }
+
+      // name of the kernels in use ("avx2", "sse2" or "scalar")
+      static const char* getImplName() { return getImpl().name; }
+
+    private:
+      static const size_t INLINE_WORDS = 2;
+
+      struct Impl {
+        const char* name;
+        bool (*orInto)(WordType*, const WordType*, size_t);
+        bool (*andInto)(WordType*, const WordType*, size_t);
+        unsigned (*popcount)(const WordType*, size_t);
+        bool (*equal)(const WordType*, const WordType*, size_t);
+        bool (*none)(const WordType*, size_t);
+      };
+
+      static const Impl& getImpl();
+  };
+
+}
+
+#endif
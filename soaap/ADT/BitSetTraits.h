@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_ADT_BITSETTRAITS_H
+#define SOAAP_ADT_BITSETTRAITS_H
+
+#include "ADT/IndexSet.h"
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/SparseBitVector.h"
+#include "llvm/ADT/iterator_range.h"
+
+using namespace llvm;
+
+namespace soaap {
+  // Element-wise operations on the bit set types used as dataflow facts, so
+  // that analyses can be written once for both dense and sparse sets.
+  // Indices beyond the current size of a dense set are treated as unset.
+  template<class SetType>
+  struct BitSetTraits;
+
+  template<>
+  struct BitSetTraits<BitVector> {
+    typedef iterator_range<BitVector::const_set_bits_iterator> element_range;
+
+    static void set(BitVector& S, unsigned Idx) {
+      if (S.size() <= Idx) {
+        S.resize(Idx+1);
+      }
+      S.set(Idx);
+    }
+    static void reset(BitVector& S, unsigned Idx) {
+      if (Idx < S.size()) {
+        S.reset(Idx);
+      }
+    }
+    static bool test(const BitVector& S, unsigned Idx) { return Idx < S.size() && S.test(Idx); }
+    static unsigned count(const BitVector& S) { return S.count(); }
+    static element_range elements(const BitVector& S) { return S.set_bits(); }
+    static size_t getMemoryUsage(const BitVector& S) { return sizeof(S) + S.getMemorySize(); }
+  };
+
+  template<>
+  struct BitSetTraits<IndexSet> {
+    typedef iterator_range<IndexSet::const_iterator> element_range;
+
+    static void set(IndexSet& S, unsigned Idx) { S.set(Idx); }
+    static void reset(IndexSet& S, unsigned Idx) { S.reset(Idx); }
+    static bool test(const IndexSet& S, unsigned Idx) { return S.test(Idx); }
+    static unsigned count(const IndexSet& S) { return S.count(); }
+    static element_range elements(const IndexSet& S) { return make_range(S.begin(), S.end()); }
+    static size_t getMemoryUsage(const IndexSet& S) { return sizeof(S) + S.getMemorySize(); }
+  };
+
+  template<unsigned ElementSize>
+  struct BitSetTraits<SparseBitVector<ElementSize> > {
+    typedef SparseBitVector<ElementSize> SetType;
+    typedef iterator_range<typename SetType::iterator> element_range;
+
+    static void set(SetType& S, unsigned Idx) { S.set(Idx); }
+    static void reset(SetType& S, unsigned Idx) { S.reset(Idx); }
+    static bool test(const SetType& S, unsigned Idx) { return S.test(Idx); }
+    static unsigned count(const SetType& S) { return S.count(); }
+    static element_range elements(const SetType& S) { return make_range(S.begin(), S.end()); }
+    static size_t getMemoryUsage(const SetType& S) {
+      // one list node (element plus prev/next links) per non-empty
+      // ElementSize-bit block
+      size_t numElements = 0;
+      unsigned lastBlock = ~0U;
+      for (unsigned Idx : S) {
+        if (Idx / ElementSize != lastBlock) {
+          lastBlock = Idx / ElementSize;
+          numElements++;
+        }
+      }
+      return sizeof(S) + numElements * (sizeof(SparseBitVectorElement<ElementSize>) + 2*sizeof(void*));
+    }
+  };
+}
+
+#endif
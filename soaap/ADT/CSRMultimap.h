@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_ADT_CSRMULTIMAP_H
+#define SOAAP_ADT_CSRMULTIMAP_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace soaap {
+
+  // Maps each key to a duplicate-free list of values, in insertion order.
+  // Duplicates are found by scanning the key's list, so no per-pair index
+  // is kept alongside the lists; only lists in the overlay that grow past
+  // IndexThreshold values get a (temporary) hash index.
+  //
+  // Values live in one of two places. compact() packs every key's values
+  // into a single compressed-sparse-row array (one contiguous slice per key,
+  // located via an offsets array). Values inserted since the last compact()
+  // go into a small mutable overlay that holds the complete list for each
+  // key it touches. Either way, lookup() returns a contiguous ArrayRef and
+  // never copies or allocates.
+  //
+  // An ArrayRef returned by lookup() is invalidated by the next insert() or
+  // compact().
+  template<typename KeyT, typename ValueT>
+  class CSRMultimap {
+    public:
+      typedef llvm::ArrayRef<ValueT> ValueRange;
+
+      // returns true if V was not already mapped from K
+      bool insert(const KeyT& K, const ValueT& V);
+      ValueRange lookup(const KeyT& K) const;
+      // moves the overlay into the CSR arrays
+      void compact();
+      void clear();
+      // keys in order of first insertion
+      const std::vector<KeyT>& keys() const { return keyList; }
+      bool isCompact() const { return overlay.empty(); }
+
+    private:
+      static const unsigned IndexThreshold = 32;
+      struct OverlayRow {
+        std::vector<ValueT> values;
+        llvm::DenseSet<ValueT> index; // empty until values is large
+      };
+      llvm::DenseMap<KeyT,unsigned> keyToRow;
+      std::vector<unsigned> offsets; // row i is values[offsets[i], offsets[i+1])
+      std::vector<ValueT> values;
+      llvm::DenseMap<KeyT,OverlayRow> overlay;
+      std::vector<KeyT> keyList;
+      ValueRange csrRow(const KeyT& K) const;
+  };
+
+  template<typename KeyT, typename ValueT>
+  bool CSRMultimap<KeyT,ValueT>::insert(const KeyT& K, const ValueT& V) {
+    typename llvm::DenseMap<KeyT,OverlayRow>::iterator I = overlay.find(K);
+    if (I == overlay.end()) {
+      ValueRange existing = csrRow(K);
+      if (std::find(existing.begin(), existing.end(), V) != existing.end()) {
+        return false;
+      }
+      // copy-on-write: the overlay holds the complete list for K
+      if (existing.empty() && keyToRow.count(K) == 0) {
+        keyList.push_back(K);
+      }
+      I = overlay.insert(std::make_pair(K, OverlayRow())).first;
+      I->second.values.assign(existing.begin(), existing.end());
+    }
+    OverlayRow& row = I->second;
+    if (row.index.empty()) {
+      if (std::find(row.values.begin(), row.values.end(), V) != row.values.end()) {
+        return false;
+      }
+      if (row.values.size() >= IndexThreshold) {
+        row.index.insert(row.values.begin(), row.values.end());
+      }
+    }
+    else if (row.index.count(V)) {
+      return false;
+    }
+    row.values.push_back(V);
+    if (!row.index.empty()) {
+      row.index.insert(V);
+    }
+    return true;
+  }
+
+  template<typename KeyT, typename ValueT>
+  typename CSRMultimap<KeyT,ValueT>::ValueRange CSRMultimap<KeyT,ValueT>::lookup(const KeyT& K) const {
+    if (!overlay.empty()) {
+      typename llvm::DenseMap<KeyT,OverlayRow>::const_iterator I = overlay.find(K);
+      if (I != overlay.end()) {
+        return I->second.values;
+      }
+    }
+    return csrRow(K);
+  }
+
+  template<typename KeyT, typename ValueT>
+  typename CSRMultimap<KeyT,ValueT>::ValueRange CSRMultimap<KeyT,ValueT>::csrRow(const KeyT& K) const {
+    typename llvm::DenseMap<KeyT,unsigned>::const_iterator I = keyToRow.find(K);
+    if (I == keyToRow.end()) {
+      return ValueRange();
+    }
+    unsigned row = I->second;
+    return ValueRange(values.data() + offsets[row], offsets[row+1] - offsets[row]);
+  }
+
+  template<typename KeyT, typename ValueT>
+  void CSRMultimap<KeyT,ValueT>::compact() {
+    if (overlay.empty()) {
+      return;
+    }
+    llvm::DenseMap<KeyT,unsigned> newKeyToRow;
+    std::vector<unsigned> newOffsets;
+    std::vector<ValueT> newValues;
+    newKeyToRow.reserve(keyList.size());
+    newOffsets.reserve(keyList.size()+1);
+    size_t numValues = values.size();
+    for (typename llvm::DenseMap<KeyT,OverlayRow>::const_iterator I = overlay.begin(), E = overlay.end(); I != E; ++I) {
+      numValues += I->second.values.size();
+    }
+    newValues.reserve(numValues);
+    for (const KeyT& K : keyList) {
+      ValueRange row = lookup(K);
+      newKeyToRow[K] = newOffsets.size();
+      newOffsets.push_back(newValues.size());
+      newValues.insert(newValues.end(), row.begin(), row.end());
+    }
+    newOffsets.push_back(newValues.size());
+    keyToRow.swap(newKeyToRow);
+    offsets.swap(newOffsets);
+    values.swap(newValues);
+    overlay.clear();
+  }
+
+  template<typename KeyT, typename ValueT>
+  void CSRMultimap<KeyT,ValueT>::clear() {
+    keyToRow.clear();
+    offsets.clear();
+    values.clear();
+    overlay.clear();
+    keyList.clear();
+  }
+
+}
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_ADT_FACTINTERNER_H
+#define SOAAP_ADT_FACTINTERNER_H
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include <stdint.h>
+
+using namespace llvm;
+
+namespace soaap {
+
+  typedef uint32_t FactId;
+
+  // Hash-consed store of dataflow facts. Each distinct fact (as decided by
+  // Lattice::equal) is stored once and named by a 32-bit id, so that values
+  // and contexts with the same fact share it, facts are copied as integers
+  // and equal facts have equal ids. Joins and meets of two ids are memoised,
+  // so repeating a merge is a single hash lookup.
+  //
+  // Id 0 is always the default-constructed fact. Facts are never removed, so
+  // the store grows with the number of distinct facts (including
+  // intermediate ones) seen during an analysis. References returned by get()
+  // stay valid as more facts are interned.
+  template<typename FactType, typename Lattice>
+  class FactInterner {
+    public:
+      static const FactId DefaultId = 0;
+
+      FactInterner() : numCombines(0), numCombineHits(0) {
+        intern(FactType());
+      }
+
+      FactId intern(const FactType& F) {
+        unsigned hash = getHash(F);
+        DenseMap<unsigned,FactId>::const_iterator I = buckets.find(hash);
+        FactId bucketHead = I == buckets.end() ? NoId : I->second;
+        for (FactId id = bucketHead; id != NoId; id = nextInBucket[id]) {
+          if (Lattice::equal(facts[id], F)) {
+            return id;
+          }
+        }
+        FactId id = facts.size();
+        facts.push_back(F);
+        nextInBucket.push_back(bucketHead);
+        buckets[hash] = id;
+        return id;
+      }
+
+      const FactType& get(FactId id) const { return facts[id]; }
+
+      // ids of Lattice::join and Lattice::meet of the two facts
+      FactId join(FactId id1, FactId id2) { return combine(id1, id2, joins, true); }
+      FactId meet(FactId id1, FactId id2) { return combine(id1, id2, meets, false); }
+
+      // number of distinct facts
+      unsigned size() const { return facts.size(); }
+
+      // joins and meets requested of two different facts, and how many of
+      // those were answered from the memo tables
+      uint64_t getNumCombines() const { return numCombines; }
+      uint64_t getNumCombineHits() const { return numCombineHits; }
+
+      size_t getMemoryUsage() const {
+        size_t bytes = 0;
+        for (const FactType& F : facts) {
+          bytes += Lattice::getMemoryUsage(F);
+        }
+        return bytes + nextInBucket.capacity() * sizeof(FactId)
+                 + buckets.getMemorySize() + joins.getMemorySize() + meets.getMemorySize();
+      }
+
+      void clear() {
+        facts.clear();
+        nextInBucket.clear();
+        buckets.clear();
+        joins.clear();
+        meets.clear();
+        numCombines = numCombineHits = 0;
+        intern(FactType());
+      }
+
+    private:
+      static const FactId NoId = ~(FactId)0;
+
+      std::deque<FactType> facts;
+      std::vector<FactId> nextInBucket; // facts with the same hash are chained
+      DenseMap<unsigned,FactId> buckets; // hash -> most recently added fact
+      DenseMap<uint64_t,FactId> joins;
+      DenseMap<uint64_t,FactId> meets;
+      uint64_t numCombines;
+      uint64_t numCombineHits;
+
+      // the top bit is cleared to keep clear of DenseMap's empty and
+      // tombstone keys
+      static unsigned getHash(const FactType& F) {
+        return Lattice::getHash(F) & 0x7fffffff;
+      }
+
+      // join and meet are commutative, so each unordered pair is memoised once
+      FactId combine(FactId id1, FactId id2, DenseMap<uint64_t,FactId>& memo, bool isJoin) {
+        if (id1 == id2) {
+          return id1;
+        }
+        numCombines++;
+        uint64_t key = ((uint64_t)std::min(id1, id2) << 32) | std::max(id1, id2);
+        DenseMap<uint64_t,FactId>::const_iterator I = memo.find(key);
+        if (I != memo.end()) {
+          numCombineHits++;
+          return I->second;
+        }
+        FactType result = facts[id1];
+        if (isJoin) {
+          Lattice::join(facts[id2], result);
+        }
+        else {
+          Lattice::meet(facts[id2], result);
+        }
+        FactId id = intern(result);
+        memo[key] = id;
+        return id;
+      }
+  };
+
+}
+
+#endif
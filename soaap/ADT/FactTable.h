@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_ADT_FACTTABLE_H
+#define SOAAP_ADT_FACTTABLE_H
+
+#include "ADT/FactInterner.h"
+#include "ADT/ValueNumbering.h"
+#include "Analysis/InfoFlow/Context.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <stdint.h>
+
+using namespace llvm;
+
+namespace soaap {
+
+  // Dataflow facts for a single context, indexed by the dense ids handed out
+  // by a ValueNumbering that is shared by all contexts (normally the module
+  // numbering).
+  //
+  // Facts are stored in fixed-size pages that are allocated on first insert,
+  // each carrying a bitmask of the slots that hold a fact. This gives every
+  // value an explicit "absent" state that is distinct from the bottom fact,
+  // lets lookups run without allocating, and keeps references to facts stable
+  // as more values are added (unlike a DenseMap, which rehashes).
+  template<typename FactType>
+  class ContextFacts {
+    private:
+      static const unsigned PageBits = 6;
+      static const unsigned PageSize = 1 << PageBits;
+      static const unsigned PageMask = PageSize - 1;
+
+      struct Page {
+        uint64_t present;
+        FactType facts[PageSize];
+        Page() : present(0) { }
+      };
+
+    public:
+      // Iterates over the (Value*, fact) pairs present in this context in id
+      // order.
+      class iterator {
+        public:
+          iterator(ContextFacts* F, unsigned I) : facts(F), id(I) { }
+          const Value* getValue() const { return facts->numbering.getValue(id); }
+          FactType& getFact() const { return *facts->lookup(id); }
+          unsigned getId() const { return id; }
+          iterator& operator++() { id = facts->nextPresent(id+1); return *this; }
+          bool operator==(const iterator& other) const { return id == other.id; }
+          bool operator!=(const iterator& other) const { return id != other.id; }
+
+        private:
+          ContextFacts* facts;
+          unsigned id;
+      };
+
+      ContextFacts(ValueNumbering& VN) : numbering(VN), numFacts(0) { }
+
+      // Returns V's fact, inserting a default-constructed one if absent
+      // (mirrors DenseMap::operator[]).
+      FactType& operator[](const Value* V) {
+        return getOrInsert(numbering.getOrCreateId(V));
+      }
+
+      FactType& getOrInsert(unsigned id) {
+        unsigned pageIdx = id >> PageBits;
+        if (pageIdx >= pages.size()) {
+          pages.resize(pageIdx+1);
+        }
+        if (!pages[pageIdx]) {
+          pages[pageIdx].reset(new Page);
+        }
+        Page& P = *pages[pageIdx];
+        uint64_t bit = (uint64_t)1 << (id & PageMask);
+        if ((P.present & bit) == 0) {
+          P.present |= bit;
+          P.facts[id & PageMask] = FactType();
+          numFacts++;
+        }
+        return P.facts[id & PageMask];
+      }
+
+      // Return NULL if V has no fact in this context. These never allocate.
+      FactType* lookup(const Value* V) {
+        return lookup(numbering.getId(V));
+      }
+
+      const FactType* lookup(const Value* V) const {
+        return const_cast<ContextFacts*>(this)->lookup(V);
+      }
+
+      FactType* lookup(unsigned id) {
+        if (id == ValueNumbering::NoId) {
+          return NULL;
+        }
+        unsigned pageIdx = id >> PageBits;
+        if (pageIdx >= pages.size() || !pages[pageIdx]) {
+          return NULL;
+        }
+        Page& P = *pages[pageIdx];
+        if ((P.present & ((uint64_t)1 << (id & PageMask))) == 0) {
+          return NULL;
+        }
+        return &P.facts[id & PageMask];
+      }
+
+      // Returns V's fact, or a default-constructed fact if V has none. Unlike
+      // operator[] this does not insert anything.
+      const FactType& lookupOrDefault(const Value* V) const {
+        static const FactType absent = FactType();
+        const FactType* F = lookup(V);
+        return F ? *F : absent;
+      }
+
+      bool count(const Value* V) const { return lookup(V) != NULL; }
+
+      iterator find(const Value* V) {
+        unsigned id = numbering.getId(V);
+        return lookup(id) ? iterator(this, id) : end();
+      }
+
+      iterator begin() { return iterator(this, nextPresent(0)); }
+      iterator end() { return iterator(this, endId()); }
+
+      unsigned size() const { return numFacts; }
+      bool empty() const { return numFacts == 0; }
+
+      void clear() {
+        pages.clear();
+        numFacts = 0;
+      }
+
+    private:
+      ValueNumbering& numbering;
+      std::vector<std::unique_ptr<Page> > pages;
+      unsigned numFacts;
+
+      unsigned endId() const { return pages.size() << PageBits; }
+
+      // returns the first id >= id that has a fact, or endId()
+      unsigned nextPresent(unsigned id) const {
+        for (unsigned pageIdx = id >> PageBits; pageIdx < pages.size(); pageIdx++) {
+          if (pages[pageIdx]) {
+            uint64_t bits = pages[pageIdx]->present;
+            if (pageIdx == (id >> PageBits)) {
+              bits &= ~(uint64_t)0 << (id & PageMask);
+            }
+            if (bits != 0) {
+              return (pageIdx << PageBits) + countTrailingZeros(bits);
+            }
+          }
+        }
+        return endId();
+      }
+  };
+
+  // Per-context dataflow state of an analysis: maps each Context to its
+  // ContextFacts, all of which share one ValueNumbering so that a Value has
+  // the same id in every context. By default this is the module numbering,
+  // so ids also agree across analyses and with DefUseOrder and AliasClasses.
+  //
+  // The facts themselves are interned (see FactInterner.h): each context
+  // holds a FactId per Value, so copying facts between values or contexts
+  // is an integer copy, and identical facts are stored once. Analyses read
+  // facts with lookupOrDefault() and write them with set() or join(). The
+  // per-context tables, and the id operations, are used directly by the
+  // solver.
+  //
+  // Once every context has a table, different contexts' tables may be used
+  // from different threads. The interner is shared by all of them, so
+  // setConcurrent(true) serialises the operations that go through it.
+  template<typename FactType, typename Lattice>
+  class FactTable {
+    public:
+      typedef ContextFacts<FactId> Facts;
+      typedef FactInterner<FactType,Lattice> Interner;
+
+      FactTable() : numbering(ValueNumbering::getModuleNumbering()), concurrent(false) { }
+      FactTable(ValueNumbering& VN) : numbering(VN), concurrent(false) { }
+
+      // Returns C's facts, creating an empty table if C has none yet
+      Facts& operator[](Context* C) {
+        typename DenseMap<Context*,unsigned>::iterator I = contextToIdx.find(C);
+        if (I != contextToIdx.end()) {
+          return *facts[I->second];
+        }
+        std::pair<typename DenseMap<Context*,unsigned>::iterator,bool> res
+          = contextToIdx.insert(std::make_pair(C, (unsigned)contexts.size()));
+        if (res.second) {
+          contexts.push_back(C);
+          facts.push_back(std::unique_ptr<Facts>(new Facts(numbering)));
+        }
+        return *facts[res.first->second];
+      }
+
+      // Returns NULL if C has no facts. Never allocates.
+      Facts* lookup(Context* C) {
+        typename DenseMap<Context*,unsigned>::iterator I = contextToIdx.find(C);
+        return I == contextToIdx.end() ? NULL : facts[I->second].get();
+      }
+
+      // Returns the id of V's fact in C, or of the default fact if V has
+      // none. Never allocates.
+      FactId lookupId(Context* C, const Value* V) {
+        Facts* F = lookup(C);
+        return F ? F->lookupOrDefault(V) : Interner::DefaultId;
+      }
+
+      const FactType& lookupOrDefault(Context* C, const Value* V) {
+        return getFact(lookupId(C, V));
+      }
+
+      // Sets V's fact in C to f
+      void set(Context* C, const Value* V, const FactType& f) {
+        (*this)[C][V] = intern(f);
+      }
+
+      // Joins f into V's fact in C; returns true if the fact changed
+      bool join(Context* C, const Value* V, const FactType& f) {
+        FactId& id = (*this)[C][V];
+        FactId newId = joinIds(id, intern(f));
+        bool changed = newId != id;
+        id = newId;
+        return changed;
+      }
+
+      FactId intern(const FactType& f) {
+        InternerLock guard(*this);
+        return interner.intern(f);
+      }
+      // facts are never moved, so the reference outlives the lock
+      const FactType& getFact(FactId id) {
+        InternerLock guard(*this);
+        return interner.get(id);
+      }
+      FactId joinIds(FactId id1, FactId id2) {
+        if (id1 == id2) {
+          return id1;
+        }
+        InternerLock guard(*this);
+        return interner.join(id1, id2);
+      }
+      FactId meetIds(FactId id1, FactId id2) {
+        if (id1 == id2) {
+          return id1;
+        }
+        InternerLock guard(*this);
+        return interner.meet(id1, id2);
+      }
+      const Interner& getInterner() const { return interner; }
+
+      // whether the interner may be used from several threads at once
+      void setConcurrent(bool b) { concurrent = b; }
+
+      // Contexts that have a table, in order of creation
+      const std::vector<Context*>& getContexts() const { return contexts; }
+
+      ValueNumbering& getValueNumbering() { return numbering; }
+
+      bool empty() const { return contexts.empty(); }
+      unsigned size() const { return contexts.size(); }
+
+      void clear() {
+        contextToIdx.clear();
+        contexts.clear();
+        facts.clear();
+        interner.clear();
+      }
+
+    private:
+      // holds internerMutex while the table is concurrent
+      class InternerLock {
+        public:
+          InternerLock(FactTable& T) : mutex(T.concurrent ? &T.internerMutex : NULL) {
+            if (mutex) mutex->lock();
+          }
+          ~InternerLock() {
+            if (mutex) mutex->unlock();
+          }
+        private:
+          std::mutex* mutex;
+      };
+
+      ValueNumbering& numbering;
+      DenseMap<Context*,unsigned> contextToIdx;
+      std::vector<Context*> contexts;
+      std::vector<std::unique_ptr<Facts> > facts;
+      Interner interner;
+      std::mutex internerMutex;
+      bool concurrent;
+  };
+
+}
+
+#endif
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_ADT_INDEXSET_H
+#define SOAAP_ADT_INDEXSET_H
+
+#include "ADT/BitSetKernels.h"
+
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdint.h>
+
+namespace soaap {
+
+  // Set of small non-negative integers (e.g. sandbox name indices) stored
+  // as a bitset. The first 64 indices live inline; larger indices spill the
+  // words to the heap. Union, intersection and subset tests work a word at
+  // a time (union, intersection, equality and count through the vectorised
+  // BitSetKernels), and iteration skips to the next set bit. Sets of
+  // different widths compare equal if they hold the same indices. This is
+  // the dense fact type of the dataflow analyses.
+  class IndexSet {
+    typedef BitSetKernels::WordType WordType;
+    static const unsigned BITS_PER_WORD = 64;
+
+    public:
+      class const_iterator : public std::iterator<std::forward_iterator_tag, unsigned> {
+        public:
+          const_iterator(const IndexSet* s, int i) : set(s), idx(i) { }
+          unsigned operator*() const { return idx; }
+          const_iterator& operator++() { idx = set->find_next(idx); return *this; }
+          bool operator==(const const_iterator& RHS) const { return idx == RHS.idx; }
+          bool operator!=(const const_iterator& RHS) const { return idx != RHS.idx; }
+
+        private:
+          const IndexSet* set;
+          int idx;
+      };
+
+      IndexSet() : words(1, 0) { }
+
+      void set(unsigned idx) {
+        unsigned w = idx / BITS_PER_WORD;
+        if (w >= words.size()) {
+          words.resize(w+1, 0);
+        }
+        words[w] |= WordType(1) << (idx % BITS_PER_WORD);
+      }
+
+      void reset(unsigned idx) {
+        unsigned w = idx / BITS_PER_WORD;
+        if (w < words.size()) {
+          words[w] &= ~(WordType(1) << (idx % BITS_PER_WORD));
+        }
+      }
+
+      bool test(unsigned idx) const {
+        unsigned w = idx / BITS_PER_WORD;
+        return w < words.size() && (words[w] >> (idx % BITS_PER_WORD)) & 1;
+      }
+
+      bool empty() const {
+        return BitSetKernels::none(words.data(), words.size());
+      }
+
+      unsigned count() const {
+        return BitSetKernels::popcount(words.data(), words.size());
+      }
+
+      void clear() {
+        words.assign(1, 0);
+      }
+
+      // returns the first index in the set, or -1 if empty
+      int find_first() const {
+        return find_from(0);
+      }
+
+      // returns the next index in the set after prev, or -1 if none
+      int find_next(unsigned prev) const {
+        return find_from(prev+1);
+      }
+
+      const_iterator begin() const { return const_iterator(this, find_first()); }
+      const_iterator end() const { return const_iterator(this, -1); }
+
+      // union; returns true if this set changed
+      bool unionWith(const IndexSet& RHS) {
+        if (RHS.words.size() > words.size()) {
+          words.resize(RHS.words.size(), 0);
+        }
+        return BitSetKernels::orInto(words.data(), RHS.words.data(), RHS.words.size());
+      }
+
+      // intersection; returns true if this set changed
+      bool intersectWith(const IndexSet& RHS) {
+        unsigned common = std::min(words.size(), RHS.words.size());
+        bool changed = BitSetKernels::andInto(words.data(), RHS.words.data(), common);
+        // words beyond the end of RHS are cleared
+        if (!BitSetKernels::none(words.data()+common, words.size()-common)) {
+          std::fill(words.begin()+common, words.end(), 0);
+          changed = true;
+        }
+        return changed;
+      }
+
+      bool intersects(const IndexSet& RHS) const {
+        unsigned e = std::min(words.size(), RHS.words.size());
+        for (unsigned i=0; i<e; i++) {
+          if (words[i] & RHS.words[i]) return true;
+        }
+        return false;
+      }
+
+      bool isSubsetOf(const IndexSet& RHS) const {
+        for (unsigned i=0, e=words.size(); i<e; i++) {
+          WordType R = i < RHS.words.size() ? RHS.words[i] : 0;
+          if (words[i] & ~R) return false;
+        }
+        return true;
+      }
+
+      IndexSet& operator|=(const IndexSet& RHS) { unionWith(RHS); return *this; }
+      IndexSet& operator&=(const IndexSet& RHS) { intersectWith(RHS); return *this; }
+
+      IndexSet operator|(const IndexSet& RHS) const {
+        IndexSet result(*this);
+        result |= RHS;
+        return result;
+      }
+
+      IndexSet operator&(const IndexSet& RHS) const {
+        IndexSet result(*this);
+        result &= RHS;
+        return result;
+      }
+
+      bool operator==(const IndexSet& RHS) const {
+        const IndexSet& shorter = words.size() <= RHS.words.size() ? *this : RHS;
+        const IndexSet& longer = words.size() <= RHS.words.size() ? RHS : *this;
+        unsigned common = shorter.words.size();
+        return BitSetKernels::equal(words.data(), RHS.words.data(), common)
+                 && BitSetKernels::none(longer.words.data()+common, longer.words.size()-common);
+      }
+
+      bool operator!=(const IndexSet& RHS) const { return !(*this == RHS); }
+
+      // hash consistent with ==, i.e. ignoring trailing zero words
+      unsigned getHash() const {
+        unsigned e = words.size();
+        while (e > 0 && words[e-1] == 0) {
+          e--;
+        }
+        return llvm::hash_combine_range(words.begin(), words.begin()+e);
+      }
+
+      // heap memory held by the set, in bytes
+      size_t getMemorySize() const {
+        return words.capacity() > 1 ? words.capacity_in_bytes() : 0;
+      }
+
+    private:
+      llvm::SmallVector<WordType,1> words;
+
+      int find_from(unsigned idx) const {
+        unsigned w = idx / BITS_PER_WORD;
+        if (w >= words.size()) {
+          return -1;
+        }
+        WordType W = words[w] & (~WordType(0) << (idx % BITS_PER_WORD));
+        while (!W) {
+          if (++w == words.size()) {
+            return -1;
+          }
+          W = words[w];
+        }
+        return w * BITS_PER_WORD + llvm::countTrailingZeros(W);
+      }
+  };
+
+}
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_ADT_MESSAGEQUEUE_H
+#define SOAAP_ADT_MESSAGEQUEUE_H
+
+#include <atomic>
+#include <vector>
+
+namespace soaap {
+
+  // Lock-free multi-producer, single-consumer queue of messages. Producers
+  // push whole batches (a vector of messages) with a single compare-and-swap
+  // on the head of a linked stack; the consumer takes everything pushed so
+  // far by swapping the head with null. Since the consumer never pops
+  // single nodes, the stack cannot suffer from ABA.
+  //
+  // Batches are handed to the consumer oldest first; messages within a
+  // batch keep their order.
+  template<typename T>
+  class MessageQueue {
+    public:
+      typedef std::vector<T> Batch;
+
+      MessageQueue() : head(nullptr) { }
+      ~MessageQueue() { freeList(head.load()); }
+
+      // Moves B's messages onto the queue, leaving B empty. May be called
+      // from any thread.
+      void push(Batch& B) {
+        Node* N = new Node;
+        N->batch.swap(B);
+        N->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(N->next, N, std::memory_order_release,
+                                           std::memory_order_relaxed)) { }
+      }
+
+      bool empty() const { return head.load(std::memory_order_acquire) == nullptr; }
+
+      // Calls F on each message pushed so far and returns how many there
+      // were. Only the consumer may call this.
+      template<typename Func>
+      unsigned consume(Func F) {
+        Node* N = head.exchange(nullptr, std::memory_order_acquire);
+        // reverse the stack, so batches come out in push order
+        Node* oldest = nullptr;
+        while (N != nullptr) {
+          Node* next = N->next;
+          N->next = oldest;
+          oldest = N;
+          N = next;
+        }
+        unsigned count = 0;
+        for (Node* I = oldest; I != nullptr; I = I->next) {
+          for (T& msg : I->batch) {
+            F(msg);
+          }
+          count += I->batch.size();
+        }
+        freeList(oldest);
+        return count;
+      }
+
+    private:
+      struct Node {
+        Batch batch;
+        Node* next;
+      };
+      std::atomic<Node*> head;
+
+      MessageQueue(const MessageQueue&) = delete;
+      MessageQueue& operator=(const MessageQueue&) = delete;
+
+      static void freeList(Node* N) {
+        while (N != nullptr) {
+          Node* next = N->next;
+          delete N;
+          N = next;
+        }
+      }
+  };
+
+}
+
+#endif
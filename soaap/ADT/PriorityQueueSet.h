@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_ADT_PRIORITYQUEUESET_H
+#define SOAAP_ADT_PRIORITYQUEUESET_H
+
+#include "llvm/ADT/DenseSet.h"
+
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include <stdint.h>
+
+namespace soaap {
+
+  // A QueueSet whose elements are dequeued lowest priority first (ties are
+  // broken in FIFO order). An element is held at most once at a time. When
+  // no priority function is set every element has priority 0, so it behaves
+  // exactly like a QueueSet.
+  //
+  // Also counts dequeues and, if enabled with setCountRepops, "re-pops"
+  // (dequeues of an element that has already been dequeued before), which
+  // measure how well the priority order avoids revisiting elements.
+  // Counting re-pops remembers every element dequeued since the last
+  // clear(), so it is meant for debugging only.
+  template<typename T>
+  class PriorityQueueSet {
+    public:
+      typedef std::function<uint64_t(const T&)> PriorityFunction;
+
+      PriorityQueueSet() : countRepops(false), nextSeq(0), pops(0), repops(0) { }
+      void setPriorityFunction(PriorityFunction f) { priorityOf = f; }
+      void setCountRepops(bool b) { countRepops = b; }
+      bool enqueue(T elem);
+      T dequeue();
+      bool empty();
+      int size();
+      void clear();
+      uint64_t getNumPops() { return pops; }
+      uint64_t getNumRepops() { return repops; }
+
+    protected:
+      struct Entry {
+        uint64_t priority;
+        uint64_t seq;
+        T elem;
+      };
+      struct EntryCompare {
+        // std::priority_queue is a max-heap, so order "later" entries first
+        bool operator()(const Entry& a, const Entry& b) const {
+          return a.priority != b.priority ? a.priority > b.priority : a.seq > b.seq;
+        }
+      };
+      std::priority_queue<Entry, std::vector<Entry>, EntryCompare> heap;
+      llvm::DenseSet<T> queued;
+      llvm::DenseSet<T> popped;
+      PriorityFunction priorityOf;
+      bool countRepops;
+      uint64_t nextSeq;
+      uint64_t pops;
+      uint64_t repops;
+  };
+
+  template<typename T>
+  bool PriorityQueueSet<T>::enqueue(T elem) {
+    if (queued.insert(elem).second) {
+      Entry e = { priorityOf ? priorityOf(elem) : 0, nextSeq++, elem };
+      heap.push(e);
+      return true;
+    }
+    return false;
+  }
+
+  template<typename T>
+  T PriorityQueueSet<T>::dequeue() {
+    T elem = heap.top().elem;
+    heap.pop();
+    queued.erase(elem);
+    pops++;
+    if (countRepops && !popped.insert(elem).second) {
+      repops++;
+    }
+    return elem;
+  }
+
+  template<typename T>
+  bool PriorityQueueSet<T>::empty() {
+    return heap.empty();
+  }
+
+  template<typename T>
+  int PriorityQueueSet<T>::size() {
+    return heap.size();
+  }
+
+  template<typename T>
+  void PriorityQueueSet<T>::clear() {
+    heap = std::priority_queue<Entry, std::vector<Entry>, EntryCompare>();
+    queued.clear();
+    popped.clear();
+  }
+
+}
+
+#endif
@@ -34,14 +34,20 @@
 #ifndef SOAAP_ADT_QUEUESET_H
 #define SOAAP_ADT_QUEUESET_H
 
-#include <set>
-#include <list>
+#include "llvm/ADT/DenseSet.h"
+
+#include <vector>
 
 namespace soaap {
 
+  // FIFO queue that holds each element at most once at a time. Elements are
+  // kept in a ring buffer (whose capacity doubles when full) and membership
+  // in an open-addressed DenseSet, so enqueue and dequeue are O(1) and do
+  // not allocate per element.
   template<typename T>
   class QueueSet {
     public:
+      QueueSet() : head(0), count(0) { }
       bool enqueue(T elem);
       T dequeue();
       bool empty();
@@ -49,14 +55,21 @@ namespace soaap {
       void clear();
 
     protected:
-      std::set<T> set;
-      std::list<T> list;
+      llvm::DenseSet<T> set;
+      std::vector<T> ring;
+      unsigned head;
+      unsigned count;
+      void grow();
   };
 
   template<typename T>
   bool QueueSet<T>::enqueue(T elem) {
     if (set.insert(elem).second) {
-      list.push_back(elem);
+      if (count == ring.size()) {
+        grow();
+      }
+      ring[(head + count) & (ring.size() - 1)] = elem;
+      count++;
       return true;
     }
     return false;
@@ -64,26 +77,40 @@ namespace soaap {
 
   template<typename T>
   T QueueSet<T>::dequeue() {
-    T elem = list.front();
-    list.pop_front();
+    T elem = ring[head];
+    head = (head + 1) & (ring.size() - 1);
+    count--;
     set.erase(elem);
     return elem;
   }
 
   template<typename T>
   bool QueueSet<T>::empty() {
-    return list.empty();
+    return count == 0;
   }
 
   template<typename T>
   int QueueSet<T>::size() {
-    return list.size();
+    return count;
   }
 
   template<typename T>
   void QueueSet<T>::clear() {
-    list.clear();
     set.clear();
+    head = 0;
+    count = 0;
+  }
+
+  // doubles the ring's capacity (keeping it a power of two), unwrapping the
+  // queued elements to the front
+  template<typename T>
+  void QueueSet<T>::grow() {
+    std::vector<T> bigger(ring.empty() ? 16 : ring.size() * 2);
+    for (unsigned i=0; i<count; i++) {
+      bigger[i] = ring[(head + i) & (ring.size() - 1)];
+    }
+    ring.swap(bigger);
+    head = 0;
   }
 
 }
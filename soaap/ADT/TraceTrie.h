@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_ADT_TRACETRIE_H
+#define SOAAP_ADT_TRACETRIE_H
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <utility>
+#include <vector>
+
+namespace soaap {
+
+  // Stores a set of traces (sequences of ElemT) so that common prefixes are
+  // shared, and gives each distinct trace inserted a dense id.
+  //
+  // Nodes live in a single vector and are identified by their index, with
+  // node 0 being the empty prefix. A node's child for a given element is
+  // found through one hash table keyed by (parent node, element), so
+  // insertion costs one lookup per element regardless of fan-out.
+  template<typename ElemT>
+  class TraceTrie {
+    public:
+      static const unsigned Root = 0;
+      static const int NoTrace = -1;
+
+      TraceTrie() { clear(); }
+
+      // inserts the elements of [Begin,End) as a path from the root and
+      // returns the id of the trace ending at the final node
+      template<typename IterT>
+      int insert(IterT Begin, IterT End) {
+        unsigned N = Root;
+        for (; Begin != End; ++Begin) {
+          std::pair<typename ChildMap::iterator,bool> I
+            = children.insert(std::make_pair(std::make_pair(N, *Begin), (unsigned)nodes.size()));
+          if (I.second) {
+            Node child = { N, *Begin, NoTrace };
+            nodes.push_back(child);
+          }
+          N = I.first->second;
+        }
+        if (nodes[N].traceId == NoTrace) {
+          nodes[N].traceId = traceNodes.size();
+          traceNodes.push_back(N);
+        }
+        return nodes[N].traceId;
+      }
+
+      unsigned getNumTraces() const { return traceNodes.size(); }
+      unsigned getTraceNode(int Id) const { return traceNodes[Id]; }
+      unsigned getParent(unsigned N) const { return nodes[N].parent; }
+      const ElemT& getElement(unsigned N) const { return nodes[N].elem; }
+      // id of the trace ending at N, or NoTrace
+      int getTraceId(unsigned N) const { return nodes[N].traceId; }
+
+      // releases all nodes, including their memory
+      void clear() {
+        std::vector<Node>().swap(nodes);
+        ChildMap().swap(children);
+        std::vector<unsigned>().swap(traceNodes);
+        Node root = { Root, ElemT(), NoTrace };
+        nodes.push_back(root);
+      }
+
+    private:
+      struct Node {
+        unsigned parent;
+        ElemT elem;
+        int traceId;
+      };
+      typedef llvm::DenseMap<std::pair<unsigned,ElemT>,unsigned> ChildMap;
+
+      std::vector<Node> nodes;
+      ChildMap children;
+      std::vector<unsigned> traceNodes; // trace id -> node
+  };
+}
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_ADT_VALUENUMBERING_H
+#define SOAAP_ADT_VALUENUMBERING_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Value.h"
+
+#include <vector>
+
+using namespace llvm;
+
+namespace soaap {
+
+  // Assigns each Value a dense, stable id (0, 1, 2, ...) in order of first
+  // request, so that per-value state can be stored in arrays indexed by id
+  // rather than in a hash map per context.
+  //
+  // The module numbering (getModuleNumbering()) is built once per module by
+  // numberModule() and is shared by the fact tables of all analyses and by
+  // the module-wide passes that feed them (DefUseOrder, AliasClasses).
+  class ValueNumbering {
+    public:
+      static const unsigned NoId = ~0U;
+
+      static ValueNumbering& getModuleNumbering() {
+        static ValueNumbering numbering;
+        return numbering;
+      }
+
+      // Numbers M's globals and functions, then each function's args and
+      // instructions, so that the values of a function have consecutive ids.
+      // Constants that facts can flow into (the constant users of globals
+      // and functions, and the constant operands of instructions) come last,
+      // so that solvers running on several threads never number anything
+      // new. Values met later are numbered on first request.
+      void numberModule(Module& M) {
+        clear();
+        for (GlobalVariable& G : M.globals()) {
+          getOrCreateId(&G);
+        }
+        for (Function& F : M.functions()) {
+          getOrCreateId(&F);
+        }
+        for (Function& F : M.functions()) {
+          for (Argument& A : F.args()) {
+            getOrCreateId(&A);
+          }
+          for (BasicBlock& BB : F) {
+            for (Instruction& I : BB) {
+              getOrCreateId(&I);
+            }
+          }
+        }
+        std::vector<const Value*> worklist;
+        for (GlobalVariable& G : M.globals()) {
+          worklist.push_back(&G);
+        }
+        for (Function& F : M.functions()) {
+          worklist.push_back(&F);
+          for (BasicBlock& BB : F) {
+            for (Instruction& I : BB) {
+              for (Value* Op : I.operands()) {
+                if (isa<Constant>(Op) && !isa<GlobalValue>(Op)) {
+                  numberConstant(cast<Constant>(Op), worklist);
+                }
+              }
+            }
+          }
+        }
+        while (!worklist.empty()) {
+          const Value* V = worklist.back();
+          worklist.pop_back();
+          for (const User* U : V->users()) {
+            if (isa<Constant>(U) && !isa<GlobalValue>(U)) {
+              numberConstant(cast<Constant>(U), worklist);
+            }
+          }
+        }
+      }
+
+      // returns V's id, numbering V if it has not been seen before. Values
+      // that already have an id are only looked up.
+      unsigned getOrCreateId(const Value* V) {
+        DenseMap<const Value*,unsigned>::const_iterator I = valueToId.find(V);
+        if (I != valueToId.end()) {
+          return I->second;
+        }
+        std::pair<DenseMap<const Value*,unsigned>::iterator,bool> res
+          = valueToId.insert(std::make_pair(V, (unsigned)idToValue.size()));
+        if (res.second) {
+          idToValue.push_back(V);
+        }
+        return res.first->second;
+      }
+
+      // returns V's id, or NoId if V has not been numbered. Never allocates.
+      unsigned getId(const Value* V) const {
+        DenseMap<const Value*,unsigned>::const_iterator I = valueToId.find(V);
+        return I == valueToId.end() ? NoId : I->second;
+      }
+
+      const Value* getValue(unsigned id) const { return idToValue[id]; }
+      unsigned size() const { return idToValue.size(); }
+
+      void clear() {
+        valueToId.clear();
+        idToValue.clear();
+      }
+
+    private:
+      DenseMap<const Value*,unsigned> valueToId;
+      std::vector<const Value*> idToValue;
+
+      // numbers C and its constant operands, queueing those that are new so
+      // that their constant users are numbered too
+      void numberConstant(const Constant* C, std::vector<const Value*>& worklist) {
+        if (valueToId.count(C)) {
+          return;
+        }
+        getOrCreateId(C);
+        worklist.push_back(C);
+        for (const Value* Op : C->operands()) {
+          if (isa<Constant>(Op) && !isa<GlobalValue>(Op)) {
+            numberConstant(cast<Constant>(Op), worklist);
+          }
+        }
+      }
+  };
+
+}
+
+#endif
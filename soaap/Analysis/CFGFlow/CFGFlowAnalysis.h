@@ -37,6 +37,9 @@
 #include <map>
 #include <list>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Pass.h"
@@ -52,8 +55,9 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Transforms/Utils/Local.h"
 
-#include "ADT/QueueSet.h"
+#include "ADT/PriorityQueueSet.h"
 #include "Analysis/Analysis.h"
+#include "Analysis/InfoFlow/LatticeTraits.h"
 #include "Common/CmdLineOpts.h"
 #include "Common/Debug.h"
 #include "Util/CallGraphUtils.h"
@@ -67,31 +71,61 @@ using namespace llvm;
 
 namespace soaap {
   // Base class for CFG-oriented data flow analysis
-  template<class FactType>
+  //
+  // Facts only grow along the CFG: the fact holding after an instruction is
+  // the join of the fact at entry to its block and of any facts generated at
+  // or before it in the block (by initialise(), or by propagation into
+  // callees and back out of returns). So instead of a fact per instruction,
+  // the engine keeps facts at block entry and exit, at call and return
+  // sites, and at the instructions that generate facts. getState()
+  // recomputes the fact at any other instruction from these.
+  //
+  // A block is only walked again if the fact at its entry or one of the
+  // facts generated within it has changed since it was last walked. Blocks
+  // are visited in reverse post-order within each function. Facts are
+  // joined and compared through Lattice (see LatticeTraits.h).
+  template<class FactType, class Lattice = LatticeTraits<FactType> >
   class CFGFlowAnalysis : public Analysis {
     public:
+      CFGFlowAnalysis() : numOrderedFuncs(0) { }
       virtual void doAnalysis(Module& M, SandboxVector& sandboxes);
 
     protected:
-      map<Instruction*,FactType> state;
-      virtual void initialise(QueueSet<BasicBlock*>& worklist, Module& M, SandboxVector& sandboxes) = 0;
-      virtual void performDataFlowAnalysis(QueueSet<BasicBlock*>&, SandboxVector& sandboxes, Module& M);
-      virtual void updateStateAndPropagate(Instruction* I, FactType val, QueueSet<BasicBlock*>& worklist);
+      virtual void initialise(PriorityQueueSet<BasicBlock*>& worklist, Module& M, SandboxVector& sandboxes) = 0;
+      virtual void performDataFlowAnalysis(PriorityQueueSet<BasicBlock*>&, SandboxVector& sandboxes, Module& M);
+      virtual void updateStateAndPropagate(Instruction* I, const FactType& val, PriorityQueueSet<BasicBlock*>& worklist);
       virtual void postDataFlowAnalysis(Module& M, SandboxVector& sandboxes) = 0;
       virtual FactType bottomValue() = 0;
       virtual string stringifyFact(FactType& f) = 0;
+      // the fact holding after I
+      FactType getState(Instruction* I);
+      // generates f at I, for use by initialise()
+      void addState(Instruction* I, const FactType& f);
+
+    private:
+      DenseMap<const Instruction*,FactType> generated;
+      DenseMap<const Instruction*,FactType> siteState; // calls and returns
+      DenseMap<const BasicBlock*,FactType> entryState;
+      DenseMap<const BasicBlock*,FactType> exitState;
+      DenseSet<const BasicBlock*> changedBlocks; // generated facts changed since last walk
+      DenseMap<const BasicBlock*,uint64_t> blockOrder;
+      unsigned numOrderedFuncs;
+      uint64_t getBlockPriority(BasicBlock* BB);
   };
 
-  template <class FactType>
-  void CFGFlowAnalysis<FactType>::doAnalysis(Module& M, SandboxVector& sandboxes) {
-    QueueSet<BasicBlock*> worklist;
+  template <class FactType, class Lattice>
+  void CFGFlowAnalysis<FactType,Lattice>::doAnalysis(Module& M, SandboxVector& sandboxes) {
+    PriorityQueueSet<BasicBlock*> worklist;
+    worklist.setPriorityFunction([this](BasicBlock* const& BB) { return getBlockPriority(BB); });
+    // revisits are only reported when debugging
+    worklist.setCountRepops(!CmdLineOpts::DebugModule.empty());
     initialise(worklist, M, sandboxes);
     performDataFlowAnalysis(worklist, sandboxes, M);
     postDataFlowAnalysis(M, sandboxes);
   }
 
-  template <typename FactType>
-  void CFGFlowAnalysis<FactType>::performDataFlowAnalysis(QueueSet<BasicBlock*>& worklist, SandboxVector& sandboxes, Module& M) {
+  template <typename FactType, typename Lattice>
+  void CFGFlowAnalysis<FactType,Lattice>::performDataFlowAnalysis(PriorityQueueSet<BasicBlock*>& worklist, SandboxVector& sandboxes, Module& M) {
     while (!worklist.empty()) {
       BasicBlock* BB = worklist.dequeue();
 
@@ -101,29 +135,41 @@ namespace soaap {
       // First, calculate join of predecessor blocks
       FactType entryBB = bottomValue();
       for (pred_iterator PI = pred_begin(BB), PE = pred_end(BB); PI != PE; ++PI) {
-        BasicBlock* PredBB = *PI;
-        TerminatorInst* T = PredBB->getTerminator();
-        entryBB |= state[T];
+        typename DenseMap<const BasicBlock*,FactType>::const_iterator I = exitState.find(*PI);
+        if (I != exitState.end()) {
+          Lattice::join(I->second, entryBB);
+        }
       }
 
       SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_4 << "Computed entry: " << stringifyFact(entryBB) << "\n");
+
+      // Skip the block if nothing it depends on has changed
+      typename DenseMap<const BasicBlock*,FactType>::iterator EI = entryState.find(BB);
+      if (EI != entryState.end() && !changedBlocks.count(BB) && Lattice::equal(EI->second, entryBB)) {
+        SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_4 << "Unchanged, skipping\n");
+        continue;
+      }
+      entryState[BB] = entryBB;
+      changedBlocks.erase(BB);
+
       SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_4 << "Propagating through current BB (" << BB->getParent()->getName() << ")\n");
 
       // Second, process the current basic block
-      TerminatorInst* T = BB->getTerminator();
-      FactType oldTerminatorState = state[T];
-      Instruction* predI = NULL;
+      FactType curr = entryBB;
       for (Instruction& II : *BB) {
         Instruction* I = &II;
-        SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_5 << "Instruction: " << *I << "\n");
-        SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_6 << "State (before): " << stringifyFact(state[I]) << "\n")
-        state[I] |= (predI == NULL ? entryBB : state[predI]);
-        SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_6 << "State (after): " << stringifyFact(state[I]) << "\n");
+        typename DenseMap<const Instruction*,FactType>::const_iterator GI = generated.find(I);
+        if (GI != generated.end()) {
+          Lattice::join(GI->second, curr);
+          SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_5 << "Instruction: " << *I << "\n");
+          SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_6 << "State (after): " << stringifyFact(curr) << "\n");
+        }
 
         if (CallInst* CI = dyn_cast<CallInst>(I)) {
           if (!isa<IntrinsicInst>(CI)) {
-            SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_6 << "Call to non-intrinsic\n");
-            FunctionSet callees = CallGraphUtils::getCallees(CI, NULL, M);
+            siteState[CI] = curr;
+            SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_6 << "Call to non-intrinsic " << *CI << "\n");
+            FunctionRange callees = CallGraphUtils::getCallees(CI, NULL, M);
             for (Function* callee : callees) {
               if (callee->isDeclaration()) continue;
               if (!SandboxUtils::isSandboxEntryPoint(M, callee) && !callee->isDeclaration()) {
@@ -131,51 +177,112 @@ namespace soaap {
                 // propagate to the entry block, and propagate back from the return blocks
                 BasicBlock& calleeEntryBB = callee->getEntryBlock();
                 Instruction& calleeFirstI = *calleeEntryBB.begin();
-                updateStateAndPropagate(&calleeFirstI, state[I], worklist);
-                SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_6 << "New state: " << stringifyFact(state[&calleeFirstI]) << "\n");
+                updateStateAndPropagate(&calleeFirstI, curr, worklist);
               }
             }
           }
         }
         else if (ReturnInst* RI = dyn_cast<ReturnInst>(I)) {
+          siteState[RI] = curr;
           // propagate to callers
           SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_6 << "Return\n");
           Function* callee = RI->getParent()->getParent();
-          CallInstSet callers = CallGraphUtils::getCallers(callee, NULL, M);
+          CallInstRange callers = CallGraphUtils::getCallers(callee, NULL, M);
           for (CallInst* CI : callers) {
             SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_6 << "Propagating to caller " << *CI << "\n");
-            updateStateAndPropagate(CI, state[RI], worklist);
-            SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_6 << "New state: " << stringifyFact(state[CI]) << "\n");
+            updateStateAndPropagate(CI, curr, worklist);
           }
         }
-        predI = I;
-        SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << "\n");
       }
 
       SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_4 << "Propagating to successor BBs\n");
 
-      // Thirdly, propagate to successor blocks (if terminator's state changed)
-      if (state[T] != oldTerminatorState) {
+      // Thirdly, propagate to successor blocks (if the exit state changed)
+      typename DenseMap<const BasicBlock*,FactType>::iterator XI = exitState.find(BB);
+      if (XI == exitState.end()) {
+        XI = exitState.insert(make_pair(BB, bottomValue())).first;
+      }
+      if (!Lattice::equal(XI->second, curr)) {
+        XI->second = curr;
         for (succ_iterator SI = succ_begin(BB), SE = succ_end(BB); SI != SE; ++SI) {
           BasicBlock* SuccBB = *SI;
-          worklist.enqueue(SuccBB); 
+          worklist.enqueue(SuccBB);
         }
       }
-
-      //dbgs() << "Worklist size: " << worklist.size() << "\n";
     }
+    SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_1 << "Block visits: " << worklist.getNumPops() << ", revisits: " << worklist.getNumRepops() << "\n");
   }
 
-  template <typename FactType>
-  void CFGFlowAnalysis<FactType>::updateStateAndPropagate(Instruction* I, FactType val, QueueSet<BasicBlock*>& worklist) {
-    FactType oldState = state[I];
-    state[I] |= val;
-    if (state[I] != oldState) {
+  template <typename FactType, typename Lattice>
+  void CFGFlowAnalysis<FactType,Lattice>::updateStateAndPropagate(Instruction* I, const FactType& val, PriorityQueueSet<BasicBlock*>& worklist) {
+    typename DenseMap<const Instruction*,FactType>::iterator GI = generated.find(I);
+    if (GI == generated.end()) {
+      GI = generated.insert(make_pair(I, bottomValue())).first;
+    }
+    if (Lattice::join(val, GI->second)) {
+      SDEBUG("soaap.analysis.cfgflow", 3, dbgs() << INDENT_6 << "New state: " << stringifyFact(GI->second) << "\n");
       BasicBlock* BB = I->getParent();
+      changedBlocks.insert(BB);
       worklist.enqueue(BB);
     }
   }
 
+  template <typename FactType, typename Lattice>
+  void CFGFlowAnalysis<FactType,Lattice>::addState(Instruction* I, const FactType& f) {
+    generated[I] = f;
+    changedBlocks.insert(I->getParent());
+  }
+
+  template <typename FactType, typename Lattice>
+  FactType CFGFlowAnalysis<FactType,Lattice>::getState(Instruction* I) {
+    // walk back to the nearest call or return site, or to the block entry,
+    // picking up facts generated on the way
+    FactType state = bottomValue();
+    BasicBlock* BB = I->getParent();
+    for (BasicBlock::iterator J = I->getIterator(); ; --J) {
+      typename DenseMap<const Instruction*,FactType>::const_iterator SI = siteState.find(&*J);
+      if (SI != siteState.end()) {
+        Lattice::join(SI->second, state);
+        return state;
+      }
+      typename DenseMap<const Instruction*,FactType>::const_iterator GI = generated.find(&*J);
+      if (GI != generated.end()) {
+        Lattice::join(GI->second, state);
+      }
+      if (J == BB->begin()) {
+        break;
+      }
+    }
+    typename DenseMap<const BasicBlock*,FactType>::const_iterator EI = entryState.find(BB);
+    if (EI != entryState.end()) {
+      Lattice::join(EI->second, state);
+    }
+    return state;
+  }
+
+  // (function index, reverse post-order index of BB within the function)
+  template <typename FactType, typename Lattice>
+  uint64_t CFGFlowAnalysis<FactType,Lattice>::getBlockPriority(BasicBlock* BB) {
+    typename DenseMap<const BasicBlock*,uint64_t>::const_iterator I = blockOrder.find(BB);
+    if (I != blockOrder.end()) {
+      return I->second;
+    }
+    Function* F = BB->getParent();
+    uint64_t funcIdx = numOrderedFuncs++;
+    uint32_t rpoIdx = 0;
+    ReversePostOrderTraversal<Function*> RPOT(F);
+    for (BasicBlock* RBB : RPOT) {
+      blockOrder[RBB] = (funcIdx << 32) | rpoIdx++;
+    }
+    // unreachable blocks go last
+    for (BasicBlock& FBB : *F) {
+      if (!blockOrder.count(&FBB)) {
+        blockOrder[&FBB] = (funcIdx << 32) | rpoIdx++;
+      }
+    }
+    return blockOrder[BB];
+  }
+
 }
 
 #endif
@@ -42,6 +42,7 @@
 #include "Util/DebugUtils.h"
 #include "Util/SandboxUtils.h"
 #include "Util/PrettyPrinters.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/IntrinsicInst.h"
@@ -52,13 +53,13 @@
 
 using namespace soaap;
 
-void GlobalVariableAnalysis::initialise(QueueSet<BasicBlock*>& worklist, Module& M, SandboxVector& sandboxes) {
+void GlobalVariableAnalysis::initialise(PriorityQueueSet<BasicBlock*>& worklist, Module& M, SandboxVector& sandboxes) {
   // Initialise worklist with basic blocks that contain creation points.
   for (Sandbox* S : sandboxes) {
-    CallInstVector CV = S->getCreationPoints();
+    CallInstRange CV = S->getCreationPoints();
     SDEBUG("soaap.analysis.globals", 3, dbgs() << "Total number of sandboxed functions: " << S->getFunctions().size() << "\n");
     for (CallInst* C : CV) {
-      state[C] = (1 << S->getNameIdx()); // each creation point creates one sandbox
+      addState(C, S->getNameSet()); // each creation point creates one sandbox
       SDEBUG("soaap.analysis.globals", 3, dbgs() << INDENT_3 << "Added BB for creation point " << *C << "\n");
       BasicBlock* BB = C->getParent();
       worklist.enqueue(BB);
@@ -68,115 +69,75 @@ void GlobalVariableAnalysis::initialise(QueueSet<BasicBlock*>& worklist, Module&
 
 void GlobalVariableAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sandboxes) {
   // reverse map of shared global var to sandbox for later
-  map<GlobalVariable*,SandboxVector> varToSandboxes;
+  DenseMap<GlobalVariable*,SandboxVector> varToSandboxes;
   
   // find all uses of global variables and check that they are allowed
   // as per the annotations
   XO::List globalAccessWarningList("global_access_warning");
   for (Sandbox* S : sandboxes) {
-    GlobalVariableIntMap varToPerms = S->getGlobalVarPerms();
+    const GlobalVariableIntMap& varToPerms = S->getGlobalVarPerms();
     // update reverse map of global vars -> sandbox names for later
-    for (GlobalVariableIntMap::iterator I=varToPerms.begin(), E=varToPerms.end(); I != E; I++) {
+    for (GlobalVariableIntMap::const_iterator I=varToPerms.begin(), E=varToPerms.end(); I != E; I++) {
       varToSandboxes[I->first].push_back(S);
     }
     for (Function* F : S->getFunctions()) {
       if (shouldOutputWarningFor(F)) {
-        SmallVector<GlobalVariable*,10> alreadyReportedReads, alreadyReportedWrites;
         SDEBUG("soaap.analysis.globals", 3, dbgs() << "   Sandbox-reachable function: " << F->getName().str() << "\n");
-        for (BasicBlock& BB : F->getBasicBlockList()) {
-          for (Instruction& I : BB.getInstList()) {
-    //            I.dump();
-            if (LoadInst* load = dyn_cast<LoadInst>(&I)) {
-              Value* operand = load->getPointerOperand()->stripPointerCasts();
-              if (GetElementPtrInst* gep = dyn_cast<GetElementPtrInst>(operand)) {
-                operand = gep->getPointerOperand();
-              }
-              if (GlobalVariable* gv = dyn_cast<GlobalVariable>(operand)) {
-                //outs() << "VAR_READ_MASK?: " << (varToPerms[gv] & VAR_READ_MASK) << ", sandbox-check: " << stringifySandboxNames(globalVarToSandboxNames[gv] & sandboxedMethodToNames[F]) << "\n";
-                //if (gv->isDeclaration()) continue; // not concerned with externs
-                if (!(varToPerms[gv] & VAR_READ_MASK)) {
-                  if (CmdLineOpts::Pedantic || find(alreadyReportedReads.begin(), alreadyReportedReads.end(), gv) == alreadyReportedReads.end()) {
-                    SDEBUG("soaap.analysis.globals", 3, dbgs() << "  Found unannotated read to global \"" << gv->getName() << "\"\n");
-                    pair<string,int> declareLoc = DebugUtils::findGlobalDeclaration(gv);
-                    string declareLocStr = "";
-                    if (declareLoc.second != -1) {
-                      stringstream ss;
-                      ss << "(" << declareLoc.first << ":" << declareLoc.second << ")";
-                      declareLocStr = ss.str();
-                    }
-                    XO::Instance globalAccessWarningInstance(globalAccessWarningList);
-                    XO::emit(
-                      " *** Sandboxed method \"{:function/%s}\" [{:sandbox/%s}] "
-                      "{:access_type/%s} global variable \"{:var_name/%s}\" "
-                      "{d:declare_loc/%s} but is not allowed to. If the access "
-                      "is intended, the variable needs to be annotated with "
-                      "__soaap_var_read.\n",
-                      F->getName().str().c_str(),
-                      S->getName().c_str(),
-                      "read",
-                      gv->getName().str().c_str(),
-                      declareLocStr.c_str());
-                    if (declareLoc.second != -1) {
-                      XO::Container declareLocContainer("declare_loc");
-                      XO::emit("{e:line/%d}{e:file/%s}",
-                               declareLoc.second, declareLoc.first.c_str());
-                    }
-                    PrettyPrinters::ppInstruction(&I);
-                    if (CmdLineOpts::isSelected(SoaapAnalysis::Globals, CmdLineOpts::OutputTraces)) {
-                      CallGraphUtils::emitCallTrace(F, S, M);
-                    }
-                    alreadyReportedReads.push_back(gv);
-                    XO::emit("\n");
-                  }
-                }
-              }
+        for (const GlobalVarAccess& A : getGlobalVarAccesses(F)) {
+          GlobalVariable* gv = A.var;
+          if (A.isWrite ? S->isAllowedToWriteGlobalVar(gv) : S->isAllowedToReadGlobalVar(gv)) {
+            continue;
+          }
+          pair<string,int> declareLoc = DebugUtils::findGlobalDeclaration(gv);
+          string declareLocStr = "";
+          if (declareLoc.second != -1) {
+            stringstream ss;
+            ss << "(" << declareLoc.first << ":" << declareLoc.second << ")";
+            declareLocStr = ss.str();
+          }
+          XO::Instance globalAccessWarningInstance(globalAccessWarningList);
+          if (!A.isWrite) {
+            SDEBUG("soaap.analysis.globals", 3, dbgs() << "  Found unannotated read to global \"" << gv->getName() << "\"\n");
+            XO::emit(
+              " *** Sandboxed method \"{:function/%s}\" [{:sandbox/%s}] "
+              "{:access_type/%s} global variable \"{:var_name/%s}\" "
+              "{d:declare_loc/%s} but is not allowed to. If the access "
+              "is intended, the variable needs to be annotated with "
+              "__soaap_var_read.\n",
+              F->getName().str().c_str(),
+              S->getName().c_str(),
+              "read",
+              gv->getName().str().c_str(),
+              declareLocStr.c_str());
+            if (declareLoc.second != -1) {
+              XO::Container declareLocContainer("declare_loc");
+              XO::emit("{e:line/%d}{e:file/%s}",
+                       declareLoc.second, declareLoc.first.c_str());
             }
-            else if (StoreInst* store = dyn_cast<StoreInst>(&I)) {
-              Value* operand = store->getPointerOperand()->stripPointerCasts();
-              if (GetElementPtrInst* gep = dyn_cast<GetElementPtrInst>(operand)) {
-                operand = gep->getPointerOperand();
-              }
-              if (GlobalVariable* gv = dyn_cast<GlobalVariable>(operand)) {
-                if (gv->isDeclaration()) continue; // not concerned with externs
-                // check that the programmer has annotated that this
-                // variable can be written to
-                if (!(varToPerms[gv] & VAR_WRITE_MASK)) {
-                  if (CmdLineOpts::Pedantic || find(alreadyReportedWrites.begin(), alreadyReportedWrites.end(), gv) == alreadyReportedWrites.end()) {
-                    pair<string,int> declareLoc = DebugUtils::findGlobalDeclaration(gv);
-                    string declareLocStr = "";
-                    if (declareLoc.second != -1) {
-                      stringstream ss;
-                      ss << "(" << declareLoc.first << ":" << declareLoc.second << ")";
-                      declareLocStr = ss.str();
-                    }
-                    XO::Instance globalAccessWarningInstance(globalAccessWarningList);
-                    XO::emit(
-                      " *** Sandboxed method \"{:function/%s}\" [{:sandbox/%s}] "
-                      "{e:access_type/%s}wrote to global variable \"{:var_name/%s}\" "
-                      "{d:declare_loc/%s} but is not allowed to. If the access "
-                      "is intended, the variable needs to be annotated with "
-                      "__soaap_var_write.\n",
-                      F->getName().str().c_str(),
-                      S->getName().c_str(),
-                      "write",
-                      gv->getName().str().c_str(),
-                      declareLocStr.c_str());
-                    if (declareLoc.second != -1) {
-                      XO::Container declareLocContainer("declare_loc");
-                      XO::emit("{e:line/%d}{e:file%s}",
-                               declareLoc.second, declareLoc.first.c_str());
-                    }
-                    PrettyPrinters::ppInstruction(&I);
-                    if (CmdLineOpts::isSelected(SoaapAnalysis::Globals, CmdLineOpts::OutputTraces)) {
-                      CallGraphUtils::emitCallTrace(F, S, M);
-                    }
-                    alreadyReportedWrites.push_back(gv);
-                    XO::emit("\n");
-                  }
-                }
-              }
+          }
+          else {
+            XO::emit(
+              " *** Sandboxed method \"{:function/%s}\" [{:sandbox/%s}] "
+              "{e:access_type/%s}wrote to global variable \"{:var_name/%s}\" "
+              "{d:declare_loc/%s} but is not allowed to. If the access "
+              "is intended, the variable needs to be annotated with "
+              "__soaap_var_write.\n",
+              F->getName().str().c_str(),
+              S->getName().c_str(),
+              "write",
+              gv->getName().str().c_str(),
+              declareLocStr.c_str());
+            if (declareLoc.second != -1) {
+              XO::Container declareLocContainer("declare_loc");
+              XO::emit("{e:line/%d}{e:file%s}",
+                       declareLoc.second, declareLoc.first.c_str());
             }
           }
+          PrettyPrinters::ppInstruction(A.inst);
+          if (CmdLineOpts::isSelected(SoaapAnalysis::Globals, CmdLineOpts::OutputTraces)) {
+            CallGraphUtils::emitCallTrace(F, S, M);
+          }
+          XO::emit("\n");
         }
       }
     }
@@ -189,7 +150,7 @@ void GlobalVariableAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sand
   for (Function* F : privilegedMethods) {
     if (shouldOutputWarningFor(F)) {
       SDEBUG("soaap.analysis.globals", 3, dbgs() << INDENT_1 << "Privileged function: " << F->getName().str() << "\n");
-      SmallVector<GlobalVariable*,10> alreadyReported;
+      DenseSet<GlobalVariable*> alreadyReported;
       for (BasicBlock& BB : F->getBasicBlockList()) {
         for (Instruction& I : BB.getInstList()) {
           if (StoreInst* store = dyn_cast<StoreInst>(&I)) {
@@ -197,18 +158,19 @@ void GlobalVariableAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sand
               // check that the programmer has annotated that this
               // variable can be read from 
               SandboxVector& varSandboxes = varToSandboxes[gv];
-              int readerSandboxNames = 0;
+              SandboxSet readerSandboxNames;
               for (Sandbox* S : varSandboxes) {
                 if (S->isAllowedToReadGlobalVar(gv)) {
-                  readerSandboxNames |= (1 << S->getNameIdx());
+                  readerSandboxNames.set(S->getNameIdx());
                 }
               }
-              int possInconsSandboxes = readerSandboxNames & state[store];
-              if (possInconsSandboxes) {
+              SandboxSet reachingCreations = getState(store);
+              SandboxSet possInconsSandboxes = readerSandboxNames & reachingCreations;
+              if (!possInconsSandboxes.empty()) {
                 // check that this store is preceded by a sandbox_create annotation
                 SDEBUG("soaap.analysis.globals", 3, dbgs() << "   Checking write to annotated variable " << gv->getName() << "\n");
-                SDEBUG("soaap.analysis.globals", 3, dbgs() << "   readerSandboxNames: " << SandboxUtils::stringifySandboxNames(readerSandboxNames) << ", reaching creations: " << SandboxUtils::stringifySandboxNames(state[store]) << ", possInconsSandboxes: " << SandboxUtils::stringifySandboxNames(possInconsSandboxes) << "\n");
-                if (find(alreadyReported.begin(), alreadyReported.end(), gv) == alreadyReported.end()) {
+                SDEBUG("soaap.analysis.globals", 3, dbgs() << "   readerSandboxNames: " << SandboxUtils::stringifySandboxNames(readerSandboxNames) << ", reaching creations: " << SandboxUtils::stringifySandboxNames(reachingCreations) << ", possInconsSandboxes: " << SandboxUtils::stringifySandboxNames(possInconsSandboxes) << "\n");
+                if (alreadyReported.insert(gv).second) {
                   pair<string,int> declareLoc = DebugUtils::findGlobalDeclaration(gv);
                   string declareLocStr = "";
                   if (declareLoc.second != -1) {
@@ -238,7 +200,6 @@ void GlobalVariableAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sand
                              declareLoc.second, declareLoc.first.c_str());
                   }
                   PrettyPrinters::ppInstruction(&I);
-                  alreadyReported.push_back(gv);
                   XO::emit("\n");
                 }
               }
@@ -250,3 +211,40 @@ void GlobalVariableAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sand
   }
   globalLostUpdateList.close();
 }
+
+const GlobalVariableAnalysis::GlobalVarAccessList& GlobalVariableAnalysis::getGlobalVarAccesses(Function* F) {
+  DenseMap<const Function*,GlobalVarAccessList>::iterator I = funcToGlobalVarAccesses.find(F);
+  if (I != funcToGlobalVarAccesses.end()) {
+    return I->second;
+  }
+  GlobalVarAccessList& accesses = funcToGlobalVarAccesses[F];
+  DenseSet<GlobalVariable*> seenReads, seenWrites;
+  for (BasicBlock& BB : F->getBasicBlockList()) {
+    for (Instruction& I : BB.getInstList()) {
+      Value* ptr = NULL;
+      bool isWrite = false;
+      if (LoadInst* load = dyn_cast<LoadInst>(&I)) {
+        ptr = load->getPointerOperand();
+      }
+      else if (StoreInst* store = dyn_cast<StoreInst>(&I)) {
+        ptr = store->getPointerOperand();
+        isWrite = true;
+      }
+      else {
+        continue;
+      }
+      Value* operand = ptr->stripPointerCasts();
+      if (GetElementPtrInst* gep = dyn_cast<GetElementPtrInst>(operand)) {
+        operand = gep->getPointerOperand();
+      }
+      if (GlobalVariable* gv = dyn_cast<GlobalVariable>(operand)) {
+        if (isWrite && gv->isDeclaration()) continue; // not concerned with externs
+        if (CmdLineOpts::Pedantic || (isWrite ? seenWrites : seenReads).insert(gv).second) {
+          GlobalVarAccess access = { gv, isWrite, &I };
+          accesses.push_back(access);
+        }
+      }
+    }
+  }
+  return accesses;
+}
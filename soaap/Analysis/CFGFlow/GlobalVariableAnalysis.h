@@ -38,20 +38,35 @@
 
 #include "Util/SandboxUtils.h"
 
+#include "llvm/ADT/DenseMap.h"
+
 namespace soaap {
 
-  class GlobalVariableAnalysis : public CFGFlowAnalysis<int> {
+  class GlobalVariableAnalysis : public CFGFlowAnalysis<SandboxSet> {
     public:
       GlobalVariableAnalysis(FunctionSet& privMethods) : privilegedMethods(privMethods) { }
     
     protected:
-      virtual void initialise(QueueSet<BasicBlock*>& worklist, Module& M, SandboxVector& sandboxes);
+      virtual void initialise(PriorityQueueSet<BasicBlock*>& worklist, Module& M, SandboxVector& sandboxes);
       virtual void postDataFlowAnalysis(Module& M, SandboxVector& sandboxes);
-      virtual int bottomValue() { return 0; }
-      virtual string stringifyFact(int& fact) { return SandboxUtils::stringifySandboxNames(fact); }
+      virtual SandboxSet bottomValue() { return SandboxSet(); }
+      virtual string stringifyFact(SandboxSet& fact) { return SandboxUtils::stringifySandboxNames(fact); }
 
     private:
+      // A load from or store to a global variable. Unless running in
+      // pedantic mode, only the first read and first write of each
+      // variable in a function are recorded.
+      struct GlobalVarAccess {
+        GlobalVariable* var;
+        bool isWrite;
+        Instruction* inst;
+      };
+      typedef vector<GlobalVarAccess> GlobalVarAccessList;
+
       FunctionSet privilegedMethods;
+      DenseMap<const Function*,GlobalVarAccessList> funcToGlobalVarAccesses;
+
+      const GlobalVarAccessList& getGlobalVarAccesses(Function* F);
   };
 
 }
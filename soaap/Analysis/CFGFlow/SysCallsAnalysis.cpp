@@ -53,32 +53,28 @@
 
 using namespace soaap;
 
-void SysCallsAnalysis::initialise(QueueSet<BasicBlock*>& worklist, Module& M, SandboxVector& sandboxes) {
+void SysCallsAnalysis::initialise(PriorityQueueSet<BasicBlock*>& worklist, Module& M, SandboxVector& sandboxes) {
   for (Sandbox* S : sandboxes) {
-    CallInstVector sysCallLimitPoints = S->getSysCallLimitPoints();
+    CallInstRange sysCallLimitPoints = S->getSysCallLimitPoints();
     for (CallInst* C : sysCallLimitPoints) {
       SDEBUG("soaap.analysis.cfgflow.syscalls", 3, dbgs() << "syscall limit point: " << *C << "\n")
-      FunctionSet allowedSysCalls = S->getAllowedSysCalls(C);  
+      const FunctionSet& allowedSysCalls = S->getAllowedSysCalls(C);
       SDEBUG("soaap.analysis.cfgflow.syscalls", 3, dbgs() << "allowed sys calls: " << CallGraphUtils::stringifyFunctionSet(allowedSysCalls) << "\n")
-      BitVector allowedSysCallsBitVector;
+      IndexSet allowedSysCallIds;
 
       for (Function* F : allowedSysCalls) {
-        string sysCallName = F->getName();
-        SDEBUG("soaap.analysis.cfgflow.syscalls", 3, dbgs() << "setting bit for " << sysCallName << "\n")
-        int idx = operatingSystem->getIdx(sysCallName);
-        if (idx == -1) {
-          errs() << "WARNING: \"" << sysCallName << "\" does not appear to be a system call\n";
+        SDEBUG("soaap.analysis.cfgflow.syscalls", 3, dbgs() << "setting bit for " << F->getName() << "\n")
+        SysCallId idx = operatingSystem->getSysCallId(F);
+        if (idx == SysCallProvider::NoSysCall) {
+          errs() << "WARNING: \"" << F->getName() << "\" does not appear to be a system call\n";
           continue;
         }
         SDEBUG("soaap.analysis.cfgflow.syscalls", 3, dbgs() << "idx: " << idx << "\n")
-        if (allowedSysCallsBitVector.size() <= idx) {
-          allowedSysCallsBitVector.resize(idx+1);
-        }
-        allowedSysCallsBitVector.set(idx);
-        SDEBUG("soaap.analysis.cfgflow.syscalls", 3, dbgs() << "allowed sys calls vector size and count: " << allowedSysCallsBitVector.size() << "," << allowedSysCallsBitVector.count() << "\n")
+        allowedSysCallIds.set(idx);
+        SDEBUG("soaap.analysis.cfgflow.syscalls", 3, dbgs() << "allowed sys calls count: " << allowedSysCallIds.count() << "\n")
       }
 
-      state[C] = allowedSysCallsBitVector;
+      addState(C, allowedSysCallIds);
       worklist.enqueue(C->getParent());
     }
   }
@@ -93,30 +89,25 @@ void SysCallsAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sandboxes)
       if (shouldOutputWarningFor(C)) {
         SDEBUG("soaap.analysis.cfgflow.syscalls", 4, dbgs() << "call: " << *C << "\n")
         for (Function* Callee : CallGraphUtils::getCallees(C, S, M)) {
-          string funcName = Callee->getName();
-          SDEBUG("soaap.analysis.cfgflow.syscalls", 3, dbgs() << "callee: " << funcName << "\n")
-          if (operatingSystem->isSysCall(funcName)) {
-            SDEBUG("soaap.analysis.cfgflow.syscalls", 3, dbgs() << "syscall " << funcName << " found\n")
+          SDEBUG("soaap.analysis.cfgflow.syscalls", 3, dbgs() << "callee: " << Callee->getName() << "\n")
+          SysCallId idx = operatingSystem->getSysCallId(Callee);
+          if (idx != SysCallProvider::NoSysCall) {
+            SDEBUG("soaap.analysis.cfgflow.syscalls", 3, dbgs() << "syscall " << Callee->getName() << " found\n")
             bool sysCallAllowed = false;
             if (sandboxPlatform) {
               // sandbox platform dictates if the system call is allowed
-              sysCallAllowed = sandboxPlatform->isSysCallPermitted(funcName);
-            }
-            else if (state.find(C) == state.end()) { // no annotations, so disallow by default
-              sysCallAllowed = false;
+              sysCallAllowed = sandboxPlatform->isSysCallPermitted(idx);
             }
-            else { // there are annotations
-              // We distinguish an empty vector from C not appearing in state
-              // to avoid blowing up the state map
-              BitVector& vector = state[C];
-              int idx = operatingSystem->getIdx(funcName);
+            else { // no annotations yield an empty vector, so disallow by default
+              IndexSet allowedSysCallIds = getState(C);
               SDEBUG("soaap.analysis.cfgflow.syscalls", 3, dbgs() << "syscall idx: " << idx << "\n")
-              SDEBUG("soaap.analysis.cfgflow.syscalls", 3, dbgs() << "allowed sys calls vector size and count: " << vector.size() << "," << vector.count() << "\n")
-              sysCallAllowed = vector.size() > idx && vector.test(idx);
+              SDEBUG("soaap.analysis.cfgflow.syscalls", 3, dbgs() << "allowed sys calls count: " << allowedSysCallIds.count() << "\n")
+              sysCallAllowed = allowedSysCallIds.test(idx);
             }
 
             // Show warning if system call is not allowed
             if (!sysCallAllowed) {
+              string funcName = Callee->getName();
               XO::Instance syscallWarningInstance(syscallWarningList);
               XO::emit(" *** Sandbox \"{:sandbox/%s}\" performs system call "
                        "\"{:syscall/%s}\" but it is not allowed to,\n"
@@ -137,25 +128,20 @@ void SysCallsAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sandboxes)
   }
 }
 
-bool SysCallsAnalysis::allowedToPerformNamedSystemCallAtSandboxedPoint(Instruction* I, string sysCall) {
+bool SysCallsAnalysis::allowedToPerformSystemCallAtSandboxedPoint(Instruction* I, SysCallId idx) {
   if (sandboxPlatform) {
-    return sandboxPlatform->isSysCallPermitted(sysCall);
-  }
-  else if (state.find(I) != state.end()) {
-    int idx = operatingSystem->getIdx(sysCall);
-    BitVector& vector = state[I];
-    return vector.size() > idx && vector.test(idx);
+    return sandboxPlatform->isSysCallPermitted(idx);
   }
-  return false;
+  return getState(I).test(idx);
 }
 
-string SysCallsAnalysis::stringifyFact(BitVector& vector) {
+string SysCallsAnalysis::stringifyFact(IndexSet& sysCallIds) {
   stringstream ss;
   ss << "[";
-  int idx = 0;
-  for (int i=0; i<vector.count(); i++) {
-    idx = (i == 0) ? vector.find_first() : vector.find_next(idx);
-    ss << ((i > 0) ? "," : "") << operatingSystem->getSysCall(idx);
+  bool first = true;
+  for (unsigned idx : sysCallIds) {
+    ss << (first ? "" : ",") << operatingSystem->getSysCall(idx);
+    first = false;
   }
   ss << "]";
   return ss.str();
@@ -38,20 +38,20 @@
 #include "OS/SysCallProvider.h"
 #include "OS/Sandbox/SandboxPlatform.h"
 
-#include "llvm/ADT/BitVector.h"
+#include "ADT/IndexSet.h"
 
 namespace soaap {
 
-  class SysCallsAnalysis : public CFGFlowAnalysis<BitVector> {
+  class SysCallsAnalysis : public CFGFlowAnalysis<IndexSet> {
     public:
       SysCallsAnalysis(shared_ptr<SandboxPlatform>& platform, shared_ptr<SysCallProvider>& os) : sandboxPlatform(platform), operatingSystem(os) { }
-      bool allowedToPerformNamedSystemCallAtSandboxedPoint(Instruction* I, string sysCall);
+      bool allowedToPerformSystemCallAtSandboxedPoint(Instruction* I, SysCallId idx);
 
     protected:
-      virtual void initialise(QueueSet<BasicBlock*>& worklist, Module& M, SandboxVector& sandboxes);
+      virtual void initialise(PriorityQueueSet<BasicBlock*>& worklist, Module& M, SandboxVector& sandboxes);
       virtual void postDataFlowAnalysis(Module& M, SandboxVector& sandboxes);
-      virtual BitVector bottomValue() { return BitVector(); }
-      virtual string stringifyFact(BitVector& fact);
+      virtual IndexSet bottomValue() { return IndexSet(); }
+      virtual string stringifyFact(IndexSet& fact);
 
     private:
       shared_ptr<SysCallProvider> operatingSystem;
@@ -54,7 +54,7 @@ void AccessOriginAnalysis::initialise(ValueContextPairList& worklist, Module& M,
         for (Function* callee : CallGraphUtils::getCallees(C, ContextUtils::PRIV_CONTEXT, M)) {
           if (SandboxUtils::isSandboxEntryPoint(M, callee)) {
             addToWorklist(C, ContextUtils::PRIV_CONTEXT, worklist);
-            state[ContextUtils::PRIV_CONTEXT][C] = ORIGIN_SANDBOX;
+            state.set(ContextUtils::PRIV_CONTEXT, C, ORIGIN_SANDBOX);
             untrustedSources.push_back(C);
           }
         }
@@ -71,7 +71,7 @@ void AccessOriginAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sandbo
       if (CallInst* C = dyn_cast<CallInst>(&*I)) {
         if (C->getCalledFunction() == NULL) {
           if (shouldOutputWarningFor(C)) {
-            if (state[ContextUtils::PRIV_CONTEXT][C->getCalledValue()] == ORIGIN_SANDBOX) {
+            if (state.lookupOrDefault(ContextUtils::PRIV_CONTEXT, C->getCalledValue()) == ORIGIN_SANDBOX) {
               XO::Instance accessOriginInstance(accessOriginList);
               XO::emit(" *** Untrusted function pointer call in "
                        "\"{:function/%s}\"\n",
@@ -89,17 +89,6 @@ void AccessOriginAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sandbo
   }
 }
 
-
-bool AccessOriginAnalysis::performMeet(int from, int& to) {
-  return performUnion(from, to);
-}
-
-bool AccessOriginAnalysis::performUnion(int from, int& to) {
-  int oldTo = to;
-  to = from | to;
-  return to != oldTo;
-}
-
-string AccessOriginAnalysis::stringifyFact(int fact) {
-  return SandboxUtils::stringifySandboxNames(fact);
+string AccessOriginAnalysis::stringifyFact(const int& fact) {
+  return fact == ORIGIN_PRIV ? "[<privileged>]" : "[<sandbox>]";
 }
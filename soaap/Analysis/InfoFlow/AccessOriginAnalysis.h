@@ -39,22 +39,19 @@
 
 namespace soaap {
 
-  class AccessOriginAnalysis : public InfoFlowAnalysis<int> {
+  class AccessOriginAnalysis : public InfoFlowAnalysis<int,UnionLatticeTraits<int> > {
     static const int UNINITIALISED = INT_MAX;
     static const int ORIGIN_PRIV = 0;
     static const int ORIGIN_SANDBOX = 1;
 
     public:
-      AccessOriginAnalysis(bool contextInsensitive, FunctionSet& privileged) : InfoFlowAnalysis<int>(contextInsensitive), privilegedMethods(privileged) { }
+      AccessOriginAnalysis(bool contextInsensitive, FunctionSet& privileged) : InfoFlowAnalysis<int,UnionLatticeTraits<int> >(contextInsensitive), privilegedMethods(privileged) { }
 
     protected:
       virtual void initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes);
       virtual void postDataFlowAnalysis(Module& M, SandboxVector& sandboxes);
-      virtual bool performMeet(int from, int& to);
-      virtual bool performUnion(int from, int& to);
       virtual int bottomValue() { return 0; }
-      virtual bool checkEqual(int f1, int f2) { return f1 == f2; }
-      virtual string stringifyFact(int fact);
+      virtual string stringifyFact(const int& fact);
 
     private:
       FunctionSet privilegedMethods;
@@ -0,0 +1,423 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "Analysis/InfoFlow/AliasClasses.h"
+#include "Analysis/InfoFlow/ExternModels.h"
+#include "Common/Debug.h"
+#include "Util/CallGraphUtils.h"
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <utility>
+
+using namespace soaap;
+
+const unsigned AliasClasses::NoNode;
+
+bool AliasClasses::isClassThisParam(const Value* V) {
+  if (const Argument* A = dyn_cast<Argument>(V)) {
+    if (A->getArgNo() == 0 && A->getName() == "this") {
+      if (PointerType* PT = dyn_cast<PointerType>(A->getType())) {
+        if (StructType* ST = dyn_cast<StructType>(PT->getElementType())) {
+          return ST->hasName() && ST->getName().startswith("class.");
+        }
+      }
+    }
+  }
+  return false;
+}
+
+void AliasClasses::compute(Module& M) {
+  parent.clear();
+  rank.clear();
+  pointee.clear();
+  nodes.assign(ValueNumbering::getModuleNumbering().size(), NoNode);
+  numValues = 0;
+  returnNodes.clear();
+  thisNodes.clear();
+  roots.clear();
+  holders.clear();
+  classToAggregates.clear();
+  aggregates.clear();
+  interfaces.clear();
+  numClasses = 0;
+  stale = false;
+
+  for (GlobalVariable& G : M.globals()) {
+    addGlobal(G);
+  }
+  for (Function& F : M.functions()) {
+    if (F.isDeclaration()) continue;
+    // methods of the same class share the object that "this" points to
+    if (F.arg_size() > 0 && isClassThisParam(&*(F.arg_begin()))) {
+      Argument* A = &*(F.arg_begin());
+      StructType* ST = cast<StructType>(cast<PointerType>(A->getType())->getElementType());
+      DenseMap<StructType*,unsigned>::iterator I = thisNodes.find(ST);
+      if (I == thisNodes.end()) {
+        thisNodes[ST] = getNode(A);
+      }
+      else {
+        unify(I->second, getNode(A));
+      }
+    }
+    for (Argument& A : F.args()) {
+      getNode(&A);
+    }
+    for (BasicBlock& BB : F) {
+      for (Instruction& I : BB) {
+        addInstruction(I, M);
+      }
+    }
+  }
+
+  // record the named locations of each class, and which classes point to it
+  auto addRoot = [&](const Value* V) {
+    unsigned N = lookupClass(V);
+    if (N != NoNode) {
+      roots.insert(N, V);
+    }
+  };
+  for (GlobalVariable& G : M.globals()) {
+    addRoot(&G);
+  }
+  for (Function& F : M.functions()) {
+    if (F.isDeclaration()) continue;
+    for (Argument& A : F.args()) {
+      addRoot(&A);
+    }
+    for (BasicBlock& BB : F) {
+      for (Instruction& I : BB) {
+        if (isa<AllocaInst>(&I)) {
+          addRoot(&I);
+        }
+        else if (CallInst* CI = dyn_cast<CallInst>(&I)) {
+          if (CallGraphUtils::isExternCall(CI)) {
+            addRoot(CI);
+          }
+        }
+      }
+    }
+  }
+  for (unsigned N=0; N<parent.size(); N++) {
+    if (find(N) == N) {
+      numClasses++;
+      if (pointee[N] != NoNode) {
+        holders.insert(find(pointee[N]), N);
+      }
+    }
+  }
+  roots.compact();
+  holders.compact();
+
+  SDEBUG("soaap.analysis.infoflow.aliases", 3, dbgs() << "Partitioned " << numValues << " values into "
+                                                      << numClasses << " alias classes\n");
+}
+
+AliasClasses::ValueRange AliasClasses::getAggregates(const Value* P) {
+  std::lock_guard<std::mutex> guard(aggregatesMutex);
+  unsigned N = lookupClass(P);
+  if (N == NoNode) {
+    return ValueRange();
+  }
+  DenseMap<unsigned,unsigned>::iterator I = classToAggregates.find(N);
+  if (I != classToAggregates.end()) {
+    return aggregates[I->second];
+  }
+
+  // the object's own locations, then walk back through the classes holding
+  // pointers to it (i.e. the loads P was derived from), stopping at the
+  // first class with named locations on each path
+  vector<const Value*> result;
+  DenseSet<unsigned> visited;
+  SmallVector<unsigned,8> worklist;
+  visited.insert(N);
+  ValueRange R = roots.lookup(N);
+  result.insert(result.end(), R.begin(), R.end());
+  ArrayRef<unsigned> H = holders.lookup(N);
+  worklist.append(H.begin(), H.end());
+  while (!worklist.empty()) {
+    unsigned X = worklist.pop_back_val();
+    if (!visited.insert(X).second) continue;
+    R = roots.lookup(X);
+    if (R.empty()) {
+      H = holders.lookup(X);
+      worklist.append(H.begin(), H.end());
+    }
+    else {
+      result.insert(result.end(), R.begin(), R.end());
+    }
+  }
+
+  SDEBUG("soaap.analysis.infoflow.aliases", 4, dbgs() << "Aggregates of " << *P << ": " << result.size() << "\n");
+  classToAggregates[N] = aggregates.size();
+  aggregates.push_back(std::move(result));
+  return aggregates.back();
+}
+
+unsigned AliasClasses::newNode() {
+  unsigned N = parent.size();
+  parent.push_back(N);
+  rank.push_back(0);
+  pointee.push_back(NoNode);
+  return N;
+}
+
+unsigned AliasClasses::find(unsigned N) {
+  // path halving
+  while (parent[N] != N) {
+    parent[N] = parent[parent[N]];
+    N = parent[N];
+  }
+  return N;
+}
+
+void AliasClasses::unify(unsigned A, unsigned B) {
+  if (A == NoNode || B == NoNode) {
+    return;
+  }
+  // merging two classes merges the objects they point to, and so on
+  SmallVector<pair<unsigned,unsigned>,8> pending;
+  pending.push_back(make_pair(A, B));
+  while (!pending.empty()) {
+    A = find(pending.back().first);
+    B = find(pending.back().second);
+    pending.pop_back();
+    if (A == B) continue;
+    if (rank[A] < rank[B]) {
+      std::swap(A, B);
+    }
+    parent[B] = A;
+    if (rank[A] == rank[B]) {
+      rank[A]++;
+    }
+    if (pointee[A] == NoNode) {
+      pointee[A] = pointee[B];
+    }
+    else if (pointee[B] != NoNode) {
+      pending.push_back(make_pair(pointee[A], pointee[B]));
+    }
+  }
+}
+
+// Node for pointer value V, or NoNode if V is not a pointer or points to
+// nothing (null and undef would otherwise unify everything they are stored
+// to)
+unsigned AliasClasses::getNode(const Value* V) {
+  if (!V->getType()->isPointerTy() || isa<ConstantPointerNull>(V) || isa<UndefValue>(V)) {
+    return NoNode;
+  }
+  if (isa<ConstantExpr>(V)) {
+    V = V->stripInBoundsOffsets();
+  }
+  unsigned id = ValueNumbering::getModuleNumbering().getOrCreateId(V);
+  if (id >= nodes.size()) {
+    nodes.resize(id+1, NoNode);
+  }
+  if (nodes[id] == NoNode) {
+    nodes[id] = newNode();
+    numValues++;
+  }
+  return nodes[id];
+}
+
+unsigned AliasClasses::getPointee(unsigned N) {
+  if (N == NoNode) {
+    return NoNode;
+  }
+  N = find(N);
+  if (pointee[N] == NoNode) {
+    unsigned P = newNode();
+    pointee[N] = P;
+  }
+  return pointee[N];
+}
+
+unsigned AliasClasses::lookupClass(const Value* V) {
+  if (isa<ConstantExpr>(V)) {
+    V = V->stripInBoundsOffsets();
+  }
+  unsigned id = ValueNumbering::getModuleNumbering().getId(V);
+  if (id >= nodes.size() || nodes[id] == NoNode) {
+    return NoNode;
+  }
+  return find(nodes[id]);
+}
+
+void AliasClasses::addGlobal(GlobalVariable& G) {
+  unsigned N = getNode(&G);
+  if (!G.hasInitializer()) {
+    return;
+  }
+  // pointers anywhere in the initialiser are stored in G's object
+  SmallVector<const Constant*,8> worklist;
+  SmallPtrSet<const Constant*,8> visited;
+  worklist.push_back(G.getInitializer());
+  while (!worklist.empty()) {
+    const Constant* C = worklist.pop_back_val();
+    if (!visited.insert(C).second) continue;
+    if (isa<GlobalValue>(C) || (isa<ConstantExpr>(C) && C->getType()->isPointerTy())) {
+      unify(getPointee(N), getNode(C));
+    }
+    else {
+      for (const Use& U : C->operands()) {
+        if (const Constant* Op = dyn_cast<Constant>(U.get())) {
+          worklist.push_back(Op);
+        }
+      }
+    }
+  }
+}
+
+void AliasClasses::addInstruction(Instruction& I, Module& M) {
+  if (isa<AllocaInst>(&I)) {
+    getNode(&I);
+  }
+  else if (StoreInst* SI = dyn_cast<StoreInst>(&I)) {
+    unsigned V = getNode(SI->getValueOperand());
+    if (V != NoNode) {
+      unify(getPointee(getNode(SI->getPointerOperand())), V);
+    }
+  }
+  else if (LoadInst* LI = dyn_cast<LoadInst>(&I)) {
+    unsigned V = getNode(LI);
+    if (V != NoNode) {
+      unify(V, getPointee(getNode(LI->getPointerOperand())));
+    }
+  }
+  else if (GetElementPtrInst* GEP = dyn_cast<GetElementPtrInst>(&I)) {
+    unify(getNode(GEP), getNode(GEP->getPointerOperand()));
+  }
+  else if (CastInst* CI = dyn_cast<CastInst>(&I)) {
+    unify(getNode(CI), getNode(CI->getOperand(0)));
+  }
+  else if (PHINode* PHI = dyn_cast<PHINode>(&I)) {
+    unsigned N = getNode(PHI);
+    for (Value* IV : PHI->incoming_values()) {
+      unify(N, getNode(IV));
+    }
+  }
+  else if (SelectInst* Sel = dyn_cast<SelectInst>(&I)) {
+    unsigned N = getNode(Sel);
+    unify(N, getNode(Sel->getTrueValue()));
+    unify(N, getNode(Sel->getFalseValue()));
+  }
+  else if (CallInst* CI = dyn_cast<CallInst>(&I)) {
+    addCall(CI, M);
+  }
+}
+
+void AliasClasses::addCall(CallInst* CI, Module& M) {
+  if (IntrinsicInst* II = dyn_cast<IntrinsicInst>(CI)) {
+    if (MemTransferInst* MT = dyn_cast<MemTransferInst>(II)) {
+      unsigned Dest = getNode(MT->getRawDest());
+      unsigned Src = getNode(MT->getRawSource());
+      if (Dest != NoNode && Src != NoNode) {
+        unify(getPointee(Dest), getPointee(Src));
+      }
+    }
+    else if (II->getIntrinsicID() == Intrinsic::ptr_annotation) { // covers llvm.ptr.annotation.p0i8
+      unify(getNode(II), getNode(II->getArgOperand(0)));
+    }
+    return;
+  }
+  if (CallGraphUtils::isExternCall(CI)) {
+    // a returned pointer that the callee's model says an arg flows to may
+    // point into that arg (e.g. strchr, realloc)
+    unsigned callNode = getNode(CI);
+    const ExternModel* model = ExternModels::getModel(CallGraphUtils::getDirectCallee(CI));
+    if (callNode == NoNode || model == NULL) {
+      return;
+    }
+    unsigned numArgs = CI->getNumArgOperands();
+    for (const ExternFlow& flow : *model) {
+      if (flow.toArg != ExternFlow::RETURN) continue;
+      unsigned end = flow.fromRest ? numArgs : flow.fromArg+1;
+      for (unsigned argIdx=flow.fromArg; argIdx<end && argIdx<numArgs; argIdx++) {
+        unify(callNode, getNode(CI->getArgOperand(argIdx)));
+      }
+    }
+    return;
+  }
+
+  SmallVector<Function*,4> callees;
+  if (Function* F = CallGraphUtils::getDirectCallee(CI)) {
+    callees.push_back(F);
+  }
+  else {
+    // indirect call targets known so far
+    for (Function* F : CallGraphUtils::getCallees(CI, NULL, M)) {
+      callees.push_back(F);
+    }
+  }
+  unsigned callNode = getNode(CI);
+  for (Function* F : callees) {
+    if (F->isDeclaration()) continue;
+    const CallInterface& S = interfaces.get(F);
+    for (unsigned argIdx=0; argIdx<CI->getNumArgOperands(); argIdx++) {
+      unsigned A = getNode(CI->getArgOperand(argIdx));
+      if (A == NoNode) continue;
+      if (argIdx < S.params.size()) {
+        unify(getNode(S.params[argIdx]), A);
+      }
+      else if (S.vaList != NULL) {
+        // var args are stored in the va_list
+        unify(getPointee(getNode(S.vaList)), A);
+      }
+    }
+    if (callNode != NoNode) {
+      DenseMap<const Function*,unsigned>::iterator I = returnNodes.find(F);
+      unsigned R;
+      if (I == returnNodes.end()) {
+        R = newNode();
+        returnNodes[F] = R;
+        for (const Value* RV : S.returnValues) {
+          if (RV != NULL) {
+            unify(R, getNode(RV));
+          }
+        }
+      }
+      else {
+        R = I->second;
+      }
+      unify(callNode, R);
+    }
+  }
+}
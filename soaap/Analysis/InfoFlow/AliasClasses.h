@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_ANALYSIS_INFOFLOW_ALIASCLASSES_H
+#define SOAAP_ANALYSIS_INFOFLOW_ALIASCLASSES_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Value.h"
+
+#include "ADT/CSRMultimap.h"
+#include "ADT/ValueNumbering.h"
+#include "Analysis/InfoFlow/CallInterfaces.h"
+
+#include <mutex>
+#include <vector>
+
+using namespace llvm;
+
+namespace soaap {
+  // Steensgaard-style, field-insensitive points-to analysis. Pointer values
+  // are partitioned by union-find into classes that point to the same
+  // abstract object, and each class points to at most one other class (the
+  // object that pointers stored in it point to). GEPs and casts join their
+  // base's class; phis, selects, call args/params and returns are unified;
+  // loads and stores unify through the pointee class. An extern call's
+  // result is unified with the args that its model (see ExternModels.def)
+  // says flow to the return value. All methods whose
+  // "this" param has the same C++ class type share one object, as virtual
+  // calls may not have been resolved yet.
+  //
+  // InfoFlowAnalysis uses this to find the locations that own the object a
+  // store writes into (see getAggregates). Each value's node is stored in an
+  // array indexed by the module numbering.
+  //
+  // The classes are computed once per module (getModuleAliases()) and shared
+  // by all analyses. CallGraphUtils::addCallees invalidates them when an
+  // indirect call gets a new callee, and they are then recomputed by the
+  // next analysis to call update().
+  class AliasClasses {
+    public:
+      typedef ArrayRef<const Value*> ValueRange;
+
+      AliasClasses() : numClasses(0), stale(true) { }
+
+      static AliasClasses& getModuleAliases() {
+        static AliasClasses aliases;
+        return aliases;
+      }
+
+      void compute(Module& M);
+      // recomputes the classes if they have been invalidated
+      void update(Module& M) {
+        if (stale) {
+          compute(M);
+        }
+      }
+      void invalidate() { stale = true; }
+      // The named locations (allocas, globals, params and results of extern
+      // calls) that point to the object P points into, plus those of the
+      // objects holding a pointer to it, up to the first class that has any.
+      // The range is valid until the next call to compute(). This may be
+      // called from several threads at once.
+      ValueRange getAggregates(const Value* P);
+      unsigned getNumClasses() const { return numClasses; }
+      // whether V is the "this" param of a method of a C++ class
+      static bool isClassThisParam(const Value* V);
+
+    private:
+      static const unsigned NoNode = ~0U;
+      std::vector<unsigned> parent;
+      std::vector<unsigned> rank;
+      std::vector<unsigned> pointee;
+      std::vector<unsigned> nodes;
+      unsigned numValues;
+      DenseMap<const Function*,unsigned> returnNodes;
+      DenseMap<StructType*,unsigned> thisNodes;
+      CSRMultimap<unsigned,const Value*> roots;
+      CSRMultimap<unsigned,unsigned> holders;
+      DenseMap<unsigned,unsigned> classToAggregates;
+      std::vector<std::vector<const Value*> > aggregates;
+      unsigned numClasses;
+      bool stale;
+      CallInterfaces interfaces;
+      // guards the lazily-filled aggregates (and find()'s path halving)
+      std::mutex aggregatesMutex;
+
+      unsigned newNode();
+      unsigned find(unsigned N);
+      void unify(unsigned A, unsigned B);
+      unsigned getNode(const Value* V);
+      unsigned getPointee(unsigned N);
+      unsigned lookupClass(const Value* V);
+      void addGlobal(GlobalVariable& G);
+      void addInstruction(Instruction& I, Module& M);
+      void addCall(CallInst* CI, Module& M);
+  };
+}
+
+#endif
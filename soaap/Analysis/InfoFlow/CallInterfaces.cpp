@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "Analysis/InfoFlow/CallInterfaces.h"
+#include "Common/Debug.h"
+
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace soaap;
+
+const CallInterface& CallInterfaces::get(const Function* F) {
+  std::unique_ptr<CallInterface>& S = interfaces[F];
+  if (S) {
+    return *S;
+  }
+  S.reset(new CallInterface);
+  S->vaList = NULL;
+
+  for (const Argument& A : F->args()) {
+    S->params.push_back(&A);
+  }
+
+  if (F->isDeclaration()) {
+    return *S;
+  }
+
+  // var args are conflated into the va_list var, which will have type
+  // [1 x %struct.__va_list_tag]*
+  for (const Instruction& I : F->getEntryBlock()) {
+    if (const AllocaInst* Alloca = dyn_cast<AllocaInst>(&I)) {
+      if (ArrayType* AT = dyn_cast<ArrayType>(Alloca->getAllocatedType())) {
+        if (StructType* ST = dyn_cast<StructType>(AT->getElementType())) {
+          if (ST->hasName() && ST->getName() == "struct.__va_list_tag") {
+            S->vaList = Alloca;
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  for (const BasicBlock& B : *F) {
+    if (const ReturnInst* RI = dyn_cast<ReturnInst>(B.getTerminator())) {
+      S->returnValues.push_back(RI->getReturnValue());
+    }
+  }
+
+  SDEBUG("soaap.analysis.infoflow.interfaces", 3, dbgs() << "Cached interface of " << F->getName() << ": "
+                                                        << S->params.size() << " params, "
+                                                        << S->returnValues.size() << " returns\n");
+  return *S;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_ANALYSIS_INFOFLOW_CALLINTERFACES_H
+#define SOAAP_ANALYSIS_INFOFLOW_CALLINTERFACES_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+
+#include <memory>
+
+using namespace llvm;
+
+namespace soaap {
+  // Context-independent interface of a function as seen by interprocedural
+  // propagation: the Value* that each actual arg flows to and the values it
+  // returns.
+  struct CallInterface {
+    SmallVector<const Argument*,8> params;
+    // the va_list alloca that var args are conflated into (NULL if none)
+    const AllocaInst* vaList;
+    SmallVector<const Value*,4> returnValues;
+
+    // Value* that the arg at argIdx of a call flows to, or NULL
+    const Value* getParamFor(unsigned argIdx) const {
+      if (argIdx < params.size()) {
+        return params[argIdx];
+      }
+      return vaList;
+    }
+  };
+
+  // Memoised CallInterface for each function. It is computed the first
+  // time a function is called into and then shared by every calling
+  // context, instead of re-walking the callee's argument list, entry block
+  // and return instructions on every propagation. This only records where
+  // facts enter and leave a function; how they flow through its body is
+  // summarised by FlowSummaries.
+  class CallInterfaces {
+    public:
+      const CallInterface& get(const Function* F);
+      void clear() { interfaces.clear(); }
+
+    private:
+      DenseMap<const Function*,std::unique_ptr<CallInterface> > interfaces;
+  };
+}
+
+#endif
@@ -47,27 +47,15 @@ using namespace soaap;
 
 void CapabilityAnalysis::initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes) {
   for (Sandbox* S : sandboxes) {
-    ValueFunctionSetMap caps = S->getCapabilities();
-    for (pair<const Value*,FunctionSet> cap : caps) {
-      function<int (Function*)> func = [&](Function* F) -> int { return operatingSystem->getIdx(F->getName()); };
-      state[S][cap.first] = TypeUtils::convertFunctionSetToBitVector(cap.second, func);
+    const ValueFunctionSetMap& caps = S->getCapabilities();
+    for (const pair<const Value* const,FunctionSet>& cap : caps) {
+      function<int (Function*)> func = [&](Function* F) -> int { return operatingSystem->getSysCallId(F); };
+      state.set(S, cap.first, TypeUtils::convertFunctionSetToIndexSet(cap.second, func));
       addToWorklist(cap.first, S, worklist);
     }
   }
 }
 
-bool CapabilityAnalysis::performMeet(BitVector fromVal, BitVector& toVal) {
-  BitVector oldToVal = toVal;
-  toVal &= fromVal;
-  return toVal != oldToVal;
-}
-
-bool CapabilityAnalysis::performUnion(BitVector fromVal, BitVector& toVal) {
-  BitVector oldToVal = toVal;
-  toVal |= fromVal;
-  return toVal != oldToVal;
-}
-
 void CapabilityAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sandboxes) {
   for (Sandbox* S : sandboxes) {
     SDEBUG("soaap.analysis.infoflow.capability", 3, dbgs() << "sandbox: " << S->getName() << "\n")
@@ -77,24 +65,24 @@ void CapabilityAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sandboxe
         if (CallInst* C = dyn_cast<CallInst>(&*I)) {
           SDEBUG("soaap.analysis.infoflow.capability", 3, dbgs() << "call: " << *C << "\n")
           for (Function* Callee : CallGraphUtils::getCallees(C, S, M)) {
-            string funcName = Callee->getName();
-            SDEBUG("soaap.analysis.infoflow.capability", 3, dbgs() << "callee: " << funcName << "\n")
-            if (operatingSystem->isSysCall(funcName) && operatingSystem->hasFdArg(funcName)) {
+            SDEBUG("soaap.analysis.infoflow.capability", 3, dbgs() << "callee: " << Callee->getName() << "\n")
+            SysCallId sysCallIdx = operatingSystem->getSysCallId(Callee);
+            if (operatingSystem->hasFdArg(sysCallIdx)) {
+              string funcName = Callee->getName();
               SDEBUG("soaap.analysis.infoflow.capability", 3, dbgs() << "syscall " << funcName << " found\n")
               // this is a system call
-              int fdArgIdx = operatingSystem->getFdArgIdx(funcName);
-              int sysCallIdx = operatingSystem->getIdx(funcName);
+              int fdArgIdx = operatingSystem->getFdArgIdx(sysCallIdx);
               Value* fdArg = C->getArgOperand(fdArgIdx);
               
-              BitVector& vector = state[S][fdArg];
+              const IndexSet& allowedSysCallIds = state.lookupOrDefault(S, fdArg);
               SDEBUG("soaap.analysis.infoflow.capability", 3, dbgs() << "syscall idx: " << sysCallIdx << "\n")
               SDEBUG("soaap.analysis.infoflow.capability", 3, dbgs() << "fd arg idx: " << fdArgIdx << "\n")
               if (ConstantInt* CI = dyn_cast<ConstantInt>(fdArg)) {
                 SDEBUG("soaap.analysis.infoflow.capability", 3, dbgs() << "fd arg is a constant, value: " << CI->getSExtValue() << "\n")
               }
 
-              SDEBUG("soaap.analysis.infoflow.capability", 3, dbgs() << "allowed sys calls vector size and count for fd arg: " << vector.size() << "," << vector.count() << "\n")
-              if (vector.size() <= sysCallIdx || !vector.test(sysCallIdx)) {
+              SDEBUG("soaap.analysis.infoflow.capability", 3, dbgs() << "allowed sys calls count for fd arg: " << allowedSysCallIds.count() << "\n")
+              if (!allowedSysCallIds.test(sysCallIdx)) {
                 outs() << " *** Sandbox \"" << S->getName() << "\" performs system call \"" << funcName << "\"";
                 outs() << " but is not allowed to for the given fd arg.\n";
                 if (DILocation* loc = dyn_cast_or_null<DILocation>(C->getMetadata("dbg"))) {
@@ -110,13 +98,13 @@ void CapabilityAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sandboxe
   }
 }
 
-string CapabilityAnalysis::stringifyFact(BitVector vector) {
+string CapabilityAnalysis::stringifyFact(const IndexSet& sysCallIds) {
   stringstream ss;
   ss << "[";
-  int idx = 0;
-  for (int i=0; i<vector.count(); i++) {
-    idx = (i == 0) ? vector.find_first() : vector.find_next(idx);
-    ss << ((i > 0) ? "," : "") << operatingSystem->getSysCall(idx);
+  bool first = true;
+  for (unsigned idx : sysCallIds) {
+    ss << (first ? "" : ",") << operatingSystem->getSysCall(idx);
+    first = false;
   }
   ss << "]";
   return ss.str();
@@ -45,18 +45,15 @@ using namespace std;
 
 namespace soaap {
 
-  class CapabilityAnalysis : public InfoFlowAnalysis<BitVector> {
+  class CapabilityAnalysis : public InfoFlowAnalysis<IndexSet> {
     public:
-      CapabilityAnalysis(bool contextInsensitive, shared_ptr<SysCallProvider>& os) : InfoFlowAnalysis<BitVector>(contextInsensitive, true), operatingSystem(os) { }
+      CapabilityAnalysis(bool contextInsensitive, shared_ptr<SysCallProvider>& os) : InfoFlowAnalysis<IndexSet>(contextInsensitive, true), operatingSystem(os) { }
 
     protected:
       virtual void initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes);
       virtual void postDataFlowAnalysis(Module& M, SandboxVector& sandboxes);
-      virtual bool performMeet(BitVector fromVal, BitVector& toVal);
-      virtual bool performUnion(BitVector fromVal, BitVector& toVal);
-      virtual BitVector bottomValue() { return BitVector(); }
-      virtual bool checkEqual(BitVector f1, BitVector f2) { return f1 == f2; }
-      virtual string stringifyFact(BitVector vector);
+      virtual IndexSet bottomValue() { return IndexSet(); }
+      virtual string stringifyFact(const IndexSet& sysCallIds);
 
     private:
       shared_ptr<SysCallProvider> operatingSystem;
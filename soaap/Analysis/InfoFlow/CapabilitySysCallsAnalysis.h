@@ -36,10 +36,14 @@
 
 #include "Analysis/CFGFlow/SysCallsAnalysis.h"
 #include "Analysis/InfoFlow/InfoFlowAnalysis.h"
+#include "ADT/BitSetTraits.h"
+#include "ADT/IndexSet.h"
 #include "Common/Typedefs.h"
 #include "OS/FreeBSDSysCallProvider.h"
 #include "OS/Sandbox/SandboxPlatform.h"
 
+#include "llvm/ADT/SparseBitVector.h"
+
 #include <string>
 
 using namespace llvm;
@@ -47,13 +51,17 @@ using namespace std;
 
 namespace soaap {
 
-  class CapabilitySysCallsAnalysis : public InfoFlowAnalysis<BitVector> {
+  // Facts are sets of system call ids (see SysCallProvider), held either as
+  // dense or as sparse bit sets (see CmdLineOpts::InfoFlowSparseFacts)
+  template<class FactType>
+  class CapabilitySysCallsAnalysis : public InfoFlowAnalysis<FactType> {
     public:
+      typedef typename InfoFlowAnalysis<FactType>::ValueContextPairList ValueContextPairList;
       CapabilitySysCallsAnalysis(bool contextInsensitive,
                                  shared_ptr<SandboxPlatform>& platform,
                                  shared_ptr<SysCallProvider>& os,
                                  SysCallsAnalysis& analysis)
-           : InfoFlowAnalysis<BitVector>(contextInsensitive, true),
+           : InfoFlowAnalysis<FactType>(contextInsensitive, true),
              sandboxPlatform(platform),
              operatingSystem(os),
              sysCallsAnalysis(analysis) { }
@@ -62,16 +70,13 @@ namespace soaap {
       shared_ptr<SysCallProvider> operatingSystem;
       shared_ptr<SandboxPlatform> sandboxPlatform;
       SysCallsAnalysis& sysCallsAnalysis;
-      map<int,BitVector> intFdToAllowedSysCalls;
-      map<int,BitVector> fdKeyToAllowedSysCalls;
+      map<int,FactType> intFdToAllowedSysCalls;
+      map<int,FactType> fdKeyToAllowedSysCalls;
       virtual void initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes);
       virtual void postDataFlowAnalysis(Module& M, SandboxVector& sandboxes);
-      virtual bool performMeet(BitVector fromVal, BitVector& toVal);
-      virtual bool performUnion(BitVector fromVal, BitVector& toVal);
-      virtual BitVector bottomValue() { return BitVector(); }
-      virtual bool checkEqual(BitVector f1, BitVector f2) { return f1 == f2; }
-      virtual string stringifyFact(BitVector fact);
-      virtual BitVector convertFunctionSetToBitVector(FunctionSet sysCalls);
+      virtual FactType bottomValue() { return FactType(); }
+      virtual string stringifyFact(const FactType& fact);
+      virtual FactType convertFunctionSetToFact(const FunctionSet& sysCalls);
 
   };
 }
@@ -32,6 +32,7 @@
  */
 
 #include "Analysis/InfoFlow/ClassifiedAnalysis.h"
+#include "Common/AnnotationIndex.h"
 #include "Common/XO.h"
 #include "Util/ClassifiedUtils.h"
 #include "Util/DebugUtils.h"
@@ -45,52 +46,26 @@ using namespace soaap;
 void ClassifiedAnalysis::initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes) {
 
   // initialise with pointers to annotated fields and uses of annotated global variables
-  if (Function* F = M.getFunction("llvm.ptr.annotation.p0i8")) {
-    for (User* U : F->users()) {
-      if (IntrinsicInst* annotateCall = dyn_cast<IntrinsicInst>(U)) {
-        Value* annotatedVar = dyn_cast<Value>(annotateCall->getOperand(0)->stripPointerCasts());
+  for (const Annotation* A : AnnotationIndex::getAnnotations(CLASSIFY, M)) {
+    StringRef className = A->payload;
+    if (A->origin == Annotation::PtrAnnotation) {
+      ClassifiedUtils::assignBitIdxToClassName(className);
+      ClassSet classes;
+      classes.set(ClassifiedUtils::getBitIdxFromClassName(className));
 
-        GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(annotateCall->getOperand(1)->stripPointerCasts());
-        ConstantDataArray* annotationStrValArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-        StringRef annotationStrValCString = annotationStrValArray->getAsCString();
-        
-        if (annotationStrValCString.startswith(CLASSIFY)) {
-          StringRef className = annotationStrValCString.substr(strlen(CLASSIFY)+1); //+1 because of _
-          ClassifiedUtils::assignBitIdxToClassName(className);
-          int bitIdx = ClassifiedUtils::getBitIdxFromClassName(className);
-        
-          dbgs() << INDENT_1 << "Classification annotation " << annotationStrValCString << " found:\n";
-        
-          state[ContextUtils::NO_CONTEXT][annotatedVar] |= (1 << bitIdx);
-          addToWorklist(annotatedVar, ContextUtils::NO_CONTEXT, worklist);
-        }
-      }
-    }
-  }
-  
-  // annotations on variables are stored in the llvm.global.annotations global
-  // array
-  if (GlobalVariable* lga = M.getNamedGlobal("llvm.global.annotations")) {
-    ConstantArray* lgaArray = dyn_cast<ConstantArray>(lga->getInitializer()->stripPointerCasts());
-    for (User::op_iterator i=lgaArray->op_begin(), e = lgaArray->op_end(); e!=i; i++) {
-      ConstantStruct* lgaArrayElement = dyn_cast<ConstantStruct>(i->get());
+      dbgs() << INDENT_1 << "Classification annotation " << A->str << " found:\n";
 
-      // get the annotation value first
-      GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(lgaArrayElement->getOperand(1)->stripPointerCasts());
-      ConstantDataArray* annotationStrArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-      StringRef annotationStrArrayCString = annotationStrArray->getAsCString();
-      if (annotationStrArrayCString.startswith(CLASSIFY)) {
-        GlobalValue* annotatedVal = dyn_cast<GlobalValue>(lgaArrayElement->getOperand(0)->stripPointerCasts());
-        if (isa<GlobalVariable>(annotatedVal)) {
-          GlobalVariable* annotatedVar = dyn_cast<GlobalVariable>(annotatedVal);
-          if (annotationStrArrayCString.startswith(CLASSIFY)) {
-            StringRef className = annotationStrArrayCString.substr(strlen(CLASSIFY)+1);
-            ClassifiedUtils::assignBitIdxToClassName(className);
-            state[ContextUtils::NO_CONTEXT][annotatedVar] |= (1 << ClassifiedUtils::getBitIdxFromClassName(className));
-            addToWorklist(annotatedVar, ContextUtils::NO_CONTEXT, worklist);
-          }
-        }
-      }
+      state.join(ContextUtils::NO_CONTEXT, A->annotated, classes);
+      addToWorklist(A->annotated, ContextUtils::NO_CONTEXT, worklist);
+    }
+    else if (A->origin == Annotation::GlobalAnnotation && isa<GlobalVariable>(A->annotated)) {
+      // annotations on variables are stored in the llvm.global.annotations
+      // global array
+      ClassifiedUtils::assignBitIdxToClassName(className);
+      ClassSet classes;
+      classes.set(ClassifiedUtils::getBitIdxFromClassName(className));
+      state.join(ContextUtils::NO_CONTEXT, A->annotated, classes);
+      addToWorklist(A->annotated, ContextUtils::NO_CONTEXT, worklist);
     }
   }
 
@@ -102,8 +77,8 @@ void ClassifiedAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sandboxe
   XO::List classifiedWarningList("classified_warning");
   for (Sandbox* S : sandboxes) {
     SDEBUG("soaap.analysis.infoflow.classified", 3, dbgs() << INDENT_1 << "Sandbox: " << S->getName() << "\n");
-    FunctionVector sandboxedFuncs = S->getFunctions();
-    int clearances = S->getClearances();
+    FunctionRange sandboxedFuncs = S->getFunctions();
+    const ClassSet& clearances = S->getClearances();
     for (Function* F : sandboxedFuncs) {
       if (shouldOutputWarningFor(F)) {
         SDEBUG("soaap.analysis.infoflow.classified", 3, dbgs() << INDENT_1 << "Function: " << F->getName() << ", clearances: " << ClassifiedUtils::stringifyClassNames(clearances) << "\n");
@@ -119,16 +94,17 @@ void ClassifiedAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sandboxe
             }
 
             SDEBUG("soaap.analysis.infoflow.classified", 3, dbgs() << INDENT_3 << "Value dump: "; V->dump(););
-            SDEBUG("soaap.analysis.infoflow.classified", 3, dbgs() << INDENT_3 << "Value classes: " << state[S][V] << ", " << ClassifiedUtils::stringifyClassNames(state[S][V]) << "\n");
-            if (!(state[S][V] == 0 || (state[S][V] & clearances) == state[S][V])) {
+            const ClassSet& valueClasses = state.lookupOrDefault(S, V);
+            SDEBUG("soaap.analysis.infoflow.classified", 3, dbgs() << INDENT_3 << "Value classes: " << ClassifiedUtils::stringifyClassNames(valueClasses) << "\n");
+            if (!valueClasses.isSubsetOf(clearances)) {
               XO::Instance classifiedWarningInstance(classifiedWarningList);
               XO::emit(" *** Sandboxed method \"{:function/%s}\" "
                        "read data value of class: {d:data_classes/%s} but only "
                        "has clearances for: {d:clearances/%s}\n",
               F->getName().str().c_str(),
-              ClassifiedUtils::stringifyClassNames(state[S][V]).c_str(),
+              ClassifiedUtils::stringifyClassNames(valueClasses).c_str(),
               ClassifiedUtils::stringifyClassNames(clearances).c_str());
-              StringVector dataClassesVec = ClassifiedUtils::convertNamesToVector(state[S][V]);
+              StringVector dataClassesVec = ClassifiedUtils::convertNamesToVector(valueClasses);
               XO::List dataClassList("data_class");
               for (string class_name : dataClassesVec) {
                 XO::Instance dataClassInstance(dataClassList);
@@ -155,16 +131,6 @@ void ClassifiedAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sandboxe
   }
 }
 
-bool ClassifiedAnalysis::performMeet(int from, int& to) {
-  return performUnion(from, to);
-}
-
-bool ClassifiedAnalysis::performUnion(int from, int& to) {
-  int oldTo = to;
-  to = from | to;
-  return to != oldTo;
-}
-
-string ClassifiedAnalysis::stringifyFact(int fact) {
+string ClassifiedAnalysis::stringifyFact(const ClassSet& fact) {
   return ClassifiedUtils::stringifyClassNames(fact);
 }
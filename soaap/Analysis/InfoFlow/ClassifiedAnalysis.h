@@ -41,18 +41,17 @@ using namespace llvm;
 
 namespace soaap {
 
-  class ClassifiedAnalysis: public InfoFlowAnalysis<int> {
+  // Facts are the sets of classes (see ClassifiedUtils) of data that may
+  // flow to a value
+  class ClassifiedAnalysis: public InfoFlowAnalysis<ClassSet,UnionLatticeTraits<ClassSet> > {
     public:
-      ClassifiedAnalysis(bool contextInsensitive) : InfoFlowAnalysis<int>(contextInsensitive) { }
+      ClassifiedAnalysis(bool contextInsensitive) : InfoFlowAnalysis<ClassSet,UnionLatticeTraits<ClassSet> >(contextInsensitive) { }
 
     protected:
       virtual void initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes);
       virtual void postDataFlowAnalysis(Module& M, SandboxVector& sandboxes);
-      virtual bool performMeet(int from, int& to);
-      virtual bool performUnion(int from, int& to);
-      virtual int bottomValue() { return 0; }
-      virtual bool checkEqual(int f1, int f2) { return f1 == f2; }
-      virtual string stringifyFact(int fact);
+      virtual ClassSet bottomValue() { return ClassSet(); }
+      virtual string stringifyFact(const ClassSet& fact);
   };
 }
 
@@ -68,7 +68,7 @@ void DeclassifierAnalysis::initialise(ValueContextPairList& worklist, Module& M,
                 if (LoadInst* L = dyn_cast<LoadInst>(I)) {
                   if (L->getPointerOperand() == alloca) {
                     SDEBUG("soaap.analysis.infoflow.declassify", 3, dbgs() << "Adding " << *L << " to worklist\n");
-                    state[ContextUtils::NO_CONTEXT][L] = true;
+                    state.set(ContextUtils::NO_CONTEXT, L, true);
                     addToWorklist(L, ContextUtils::NO_CONTEXT, worklist);
                   }
                 }
@@ -109,22 +109,10 @@ void DeclassifierAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sandbo
   SDEBUG("soaap.analysis.infoflow.declassify", 3, dbgs() << "Finished declassifier analysis\n");
 }
 
-bool DeclassifierAnalysis::performMeet(bool from, bool& to) {
-  bool oldTo = to;
-  to = from && to;
-  return to != oldTo;
-}
-
-bool DeclassifierAnalysis::performUnion(bool from, bool& to) {
-  bool oldTo = to;
-  to |= from;
-  return to != oldTo;
-}
-
 bool DeclassifierAnalysis::isDeclassified(const Value* V) {
-  return state[ContextUtils::SINGLE_CONTEXT][V];
+  return state.lookupOrDefault(ContextUtils::SINGLE_CONTEXT, V);
 }
 
-string DeclassifierAnalysis::stringifyFact(bool fact) {
+string DeclassifierAnalysis::stringifyFact(const bool& fact) {
   return fact ? "true" : "false";
 }
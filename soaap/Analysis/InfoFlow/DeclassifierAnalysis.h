@@ -53,11 +53,8 @@ namespace soaap {
       map<Value*, InstVector> valueToDeclassifiedRegion;
       virtual void initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes);
       virtual void postDataFlowAnalysis(Module& M, SandboxVector& sandboxes);
-      virtual bool performMeet(bool from, bool& to);
-      virtual bool performUnion(bool from, bool& to);
       virtual bool bottomValue() { return false; }
-      virtual bool checkEqual(bool f1, bool f2) { return f1 == f2; }
-      virtual string stringifyFact(bool fact);
+      virtual string stringifyFact(const bool& fact);
       virtual void findAllFollowingInstructions(Instruction* I, Value* V);
   };
 }
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "Analysis/InfoFlow/DefUseOrder.h"
+#include "Analysis/InfoFlow/ExternModels.h"
+#include "Common/Debug.h"
+#include "Util/CallGraphUtils.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace soaap;
+
+const uint64_t DefUseOrder::Unordered;
+
+void DefUseOrder::compute(Module& M) {
+  ValueNumbering& numbering = ValueNumbering::getModuleNumbering();
+  priorities.clear();
+  numSCCs = 0;
+
+  // Iterative Tarjan over value ids. SCCs are completed in reverse
+  // topological order, so we record them and assign topological indices
+  // once all are known.
+  static const unsigned Unvisited = ~0U;
+  struct Frame {
+    unsigned id;
+    SmallVector<const Value*,8> succs;
+    unsigned nextSucc;
+  };
+  vector<unsigned> index;
+  vector<unsigned> lowlink;
+  vector<unsigned> postNum;
+  vector<bool> onStack;
+  vector<unsigned> stack;
+  vector<Frame> dfs;
+  vector<vector<unsigned> > sccs;
+  unsigned nextIndex = 0;
+  unsigned nextPostNum = 0;
+
+  // successors may be values outside the module numbering (e.g. constant
+  // exprs), which are numbered here
+  auto getId = [&](const Value* V) {
+    unsigned id = numbering.getOrCreateId(V);
+    if (id >= index.size()) {
+      unsigned n = std::max((size_t)numbering.size(), index.size());
+      index.resize(n, Unvisited);
+      lowlink.resize(n);
+      postNum.resize(n);
+      onStack.resize(n);
+    }
+    return id;
+  };
+
+  auto visit = [&](const Value* Root) {
+    if (index[getId(Root)] != Unvisited) {
+      return;
+    }
+    auto push = [&](unsigned id) {
+      index[id] = lowlink[id] = nextIndex++;
+      stack.push_back(id);
+      onStack[id] = true;
+      dfs.push_back(Frame());
+      dfs.back().id = id;
+      dfs.back().nextSucc = 0;
+      getSuccessors(numbering.getValue(id), dfs.back().succs, M);
+    };
+    push(getId(Root));
+    while (!dfs.empty()) {
+      Frame& F = dfs.back();
+      if (F.nextSucc < F.succs.size()) {
+        unsigned S = getId(F.succs[F.nextSucc++]);
+        if (index[S] == Unvisited) {
+          push(S); // invalidates F
+        }
+        else if (onStack[S]) {
+          lowlink[F.id] = std::min(lowlink[F.id], index[S]);
+        }
+        continue;
+      }
+      unsigned V = F.id;
+      dfs.pop_back();
+      postNum[V] = nextPostNum++;
+      if (!dfs.empty()) {
+        unsigned P = dfs.back().id;
+        lowlink[P] = std::min(lowlink[P], lowlink[V]);
+      }
+      if (lowlink[V] == index[V]) {
+        sccs.push_back(vector<unsigned>());
+        unsigned W;
+        do {
+          W = stack.back();
+          stack.pop_back();
+          onStack[W] = false;
+          sccs.back().push_back(W);
+        } while (W != V);
+      }
+    }
+  };
+
+  for (GlobalVariable& G : M.globals()) {
+    visit(&G);
+  }
+  for (Function& F : M.functions()) {
+    for (Argument& A : F.args()) {
+      visit(&A);
+    }
+    for (BasicBlock& BB : F) {
+      for (Instruction& I : BB) {
+        visit(&I);
+      }
+    }
+  }
+
+  numSCCs = sccs.size();
+  priorities.assign(index.size(), Unordered);
+  for (unsigned i=0; i<numSCCs; i++) {
+    vector<unsigned>& scc = sccs[i];
+    uint64_t topoIdx = numSCCs - 1 - i;
+    // reverse post-order within the SCC
+    std::sort(scc.begin(), scc.end(), [&](unsigned A, unsigned B) {
+      return postNum[A] > postNum[B];
+    });
+    for (unsigned j=0; j<scc.size(); j++) {
+      priorities[scc[j]] = (topoIdx << 32) | j;
+    }
+  }
+  SDEBUG("soaap.analysis.infoflow.order", 3, dbgs() << "Ordered " << nextIndex << " values into " << numSCCs << " SCCs\n");
+}
+
+void DefUseOrder::getSuccessors(const Value* V, SmallVectorImpl<const Value*>& succs, Module& M) {
+  for (const User* U : V->users()) {
+    if (isa<Constant>(U)) {
+      succs.push_back(U);
+    }
+    else if (const StoreInst* SI = dyn_cast<StoreInst>(U)) {
+      if (SI->getPointerOperand() != V) {
+        succs.push_back(SI->getPointerOperand());
+      }
+    }
+    else if (const ReturnInst* RI = dyn_cast<ReturnInst>(U)) {
+      for (CallInst* caller : CallGraphUtils::getCallers(RI->getParent()->getParent(), NULL, M)) {
+        succs.push_back(caller);
+      }
+    }
+    else if (const CallInst* CI = dyn_cast<CallInst>(U)) {
+      CallInst* C = const_cast<CallInst*>(CI);
+      if (CallGraphUtils::isExternCall(C)) {
+        // extern calls propagate as given by the callee's model (see
+        // InfoFlowAnalysis::propagateForExternCall)
+        if (const ExternModel* model = ExternModels::getModel(CallGraphUtils::getDirectCallee(C))) {
+          if (const Value* target = ExternModels::getFlowTarget(C, V, *model)) {
+            succs.push_back(target);
+          }
+        }
+      }
+      else {
+        for (Function* callee : CallGraphUtils::getCallees(CI, NULL, M)) {
+          if (callee->isDeclaration()) continue;
+          unsigned argIdx = 0;
+          for (Argument& A : callee->args()) {
+            if (argIdx >= CI->getNumArgOperands()) break;
+            if (CI->getArgOperand(argIdx) == V) {
+              succs.push_back(&A);
+            }
+            argIdx++;
+          }
+        }
+      }
+    }
+    else if (isa<Instruction>(U)) {
+      succs.push_back(U);
+    }
+  }
+}
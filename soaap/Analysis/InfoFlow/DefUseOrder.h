@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_ANALYSIS_INFOFLOW_DEFUSEORDER_H
+#define SOAAP_ANALYSIS_INFOFLOW_DEFUSEORDER_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Value.h"
+
+#include "ADT/ValueNumbering.h"
+
+#include <vector>
+
+#include <stdint.h>
+
+using namespace llvm;
+
+namespace soaap {
+  // Computes a visiting order for the values of a module that follows the
+  // direction in which InfoFlowAnalysis propagates facts: along def-use
+  // edges, from stored values to the store's pointer, from call args to
+  // callee params and from returned values to the call.
+  //
+  // The resulting graph is condensed into its strongly-connected components
+  // and each value's priority is (topological index of its SCC, reverse
+  // post-order index within its SCC). Draining a worklist lowest priority
+  // first therefore stabilises an SCC before any of its successors is
+  // visited, so facts tend to be pushed through each value once.
+  //
+  // Priorities are stored in an array indexed by the module numbering.
+  class DefUseOrder {
+    public:
+      static const uint64_t Unordered = ~(uint64_t)0;
+
+      void compute(Module& M);
+      uint64_t getPriority(const Value* V) const {
+        unsigned id = ValueNumbering::getModuleNumbering().getId(V);
+        return id < priorities.size() ? priorities[id] : Unordered;
+      }
+      unsigned getNumSCCs() const { return numSCCs; }
+
+    private:
+      std::vector<uint64_t> priorities;
+      unsigned numSCCs;
+      void getSuccessors(const Value* V, SmallVectorImpl<const Value*>& succs, Module& M);
+  };
+}
+
+#endif
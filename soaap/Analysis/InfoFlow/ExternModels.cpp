@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "Analysis/InfoFlow/ExternModels.h"
+#include "Common/CmdLineOpts.h"
+#include "Common/Debug.h"
+
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <fstream>
+
+using namespace soaap;
+
+StringMap<ExternModel> ExternModels::nameToModel;
+DenseMap<const Function*,ExternModel> ExternModels::funcToModel;
+
+void ExternModels::compile(Module& M) {
+  if (nameToModel.empty()) {
+    loadBuiltinModels();
+    if (!CmdLineOpts::ExternModelsFile.empty()) {
+      loadModelFile(CmdLineOpts::ExternModelsFile);
+    }
+  }
+
+  // resolve names to the module's declarations once, so the hot path in
+  // propagateForExternCall is a pointer lookup rather than string compares
+  funcToModel.clear();
+  for (Function& F : M.functions()) {
+    if (F.isDeclaration()) {
+      StringRef name = F.getName();
+      switch (F.getIntrinsicID()) {
+        case Intrinsic::memcpy: name = "memcpy"; break;
+        case Intrinsic::memmove: name = "memmove"; break;
+        default: break;
+      }
+      StringMap<ExternModel>::iterator I = nameToModel.find(name);
+      if (I != nameToModel.end()) {
+        funcToModel[&F] = I->second;
+      }
+    }
+  }
+  SDEBUG("soaap.analysis.infoflow.externs", 3, dbgs() << "Compiled " << funcToModel.size() << " of " << nameToModel.size() << " extern models\n");
+}
+
+const ExternModel* ExternModels::getModel(const Function* F) {
+  DenseMap<const Function*,ExternModel>::const_iterator I = funcToModel.find(F);
+  return I == funcToModel.end() ? NULL : &I->second;
+}
+
+Value* ExternModels::getFlowTarget(CallInst* CI, const Value* V, const ExternModel& model) {
+  unsigned numArgs = CI->getNumArgOperands();
+  for (const ExternFlow& flow : model) {
+    unsigned end = flow.fromRest ? numArgs : flow.fromArg+1;
+    for (unsigned argIdx=flow.fromArg; argIdx<end && argIdx<numArgs; argIdx++) {
+      if (CI->getArgOperand(argIdx) == V) {
+        if (flow.toArg == ExternFlow::RETURN) {
+          return CI;
+        }
+        if ((unsigned)flow.toArg < numArgs && CI->getArgOperand(flow.toArg) != V) {
+          return CI->getArgOperand(flow.toArg);
+        }
+      }
+    }
+  }
+  return NULL;
+}
+
+void ExternModels::loadBuiltinModels() {
+#define EXTERN_MODEL(Name, Rule) addRule(#Name, Rule);
+#include "Analysis/InfoFlow/ExternModels.def"
+}
+
+void ExternModels::loadModelFile(string path) {
+  ifstream modelFile(path);
+  if (!modelFile.is_open()) {
+    errs() << "ERROR: unable to open extern model file \"" << path << "\"\n";
+    return;
+  }
+  string line;
+  int lineNum = 0;
+  while (getline(modelFile, line)) {
+    lineNum++;
+    StringRef entry = StringRef(line).split('#').first.trim();
+    if (entry.empty()) {
+      continue;
+    }
+    pair<StringRef,StringRef> nameAndRule = entry.split(' ');
+    if (!addRule(nameAndRule.first, nameAndRule.second.trim())) {
+      errs() << "ERROR: malformed extern model at " << path << ":" << lineNum << ": \"" << line << "\"\n";
+    }
+  }
+}
+
+// parses a rule of the form "N[+] -> M" or "N[+] -> ret"
+bool ExternModels::addRule(StringRef funcName, StringRef rule) {
+  pair<StringRef,StringRef> lhsAndRhs = rule.split("->");
+  StringRef lhs = lhsAndRhs.first.trim();
+  StringRef rhs = lhsAndRhs.second.trim();
+  if (funcName.empty() || lhs.empty() || rhs.empty()) {
+    return false;
+  }
+  ExternFlow flow;
+  flow.fromRest = lhs.endswith("+");
+  if (flow.fromRest) {
+    lhs = lhs.drop_back();
+  }
+  if (lhs.getAsInteger(10, flow.fromArg)) {
+    return false;
+  }
+  if (rhs == "ret") {
+    flow.toArg = ExternFlow::RETURN;
+  }
+  else if (rhs.getAsInteger(10, flow.toArg) || flow.toArg < 0) {
+    return false;
+  }
+  nameToModel[funcName].push_back(flow);
+  return true;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_ANALYSIS_INFOFLOW_EXTERNMODELS_H
+#define SOAAP_ANALYSIS_INFOFLOW_EXTERNMODELS_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+#include <string>
+
+using namespace llvm;
+using namespace std;
+
+namespace soaap {
+  // One flow of an extern function's propagation model: the fact of arg
+  // fromArg (and, if fromRest, of every arg after it) flows to arg toArg,
+  // or to the call's return value if toArg is RETURN.
+  struct ExternFlow {
+    static const int RETURN = -1;
+    unsigned fromArg;
+    bool fromRest;
+    int toArg;
+  };
+  typedef SmallVector<ExternFlow,2> ExternModel;
+
+  // Propagation models for extern functions. The models are declared in
+  // ExternModels.def (plus an optional -soaap-extern-models file) and are
+  // compiled once per module into a Function*-keyed map, so that looking up
+  // the model for a call is a single pointer-keyed lookup.
+  class ExternModels {
+    public:
+      static void compile(Module& M);
+      static const ExternModel* getModel(const Function* F);
+      // Value* that V flows to when passed to CI, or NULL if none
+      static Value* getFlowTarget(CallInst* CI, const Value* V, const ExternModel& model);
+
+    private:
+      static StringMap<ExternModel> nameToModel;
+      static DenseMap<const Function*,ExternModel> funcToModel;
+      static void loadBuiltinModels();
+      static void loadModelFile(string path);
+      static bool addRule(StringRef funcName, StringRef rule);
+  };
+}
+
+#endif
@@ -32,85 +32,44 @@
  */
 
 #include "Analysis/InfoFlow/FPAnnotatedTargetsAnalysis.h"
+#include "Common/AnnotationIndex.h"
 #include "Util/DebugUtils.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/InstIterator.h"
 #include "soaap.h"
 
-#include <sstream>
-
 using namespace soaap;
 
-void FPAnnotatedTargetsAnalysis::initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes) {
-  FPTargetsAnalysis::initialise(worklist, M, sandboxes);
-  if (Function* F = M.getFunction("llvm.var.annotation")) {
-    for (User* U : F->users()) {
-      if (IntrinsicInst* annotateCall = dyn_cast<IntrinsicInst>(U)) {
-        ContextVector contexts = ContextUtils::getContextsForInstruction(annotateCall, contextInsensitive, sandboxes, M);
-        Value* annotatedVar = dyn_cast<Value>(annotateCall->getOperand(0)->stripPointerCasts());
-        GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(annotateCall->getOperand(1)->stripPointerCasts());
-        ConstantDataArray* annotationStrValArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-        StringRef annotationStrValStr = annotationStrValArray->getAsCString();
-        if (annotationStrValStr.startswith(SOAAP_FP)) {
-          FunctionSet callees;
-          string funcListCsv = annotationStrValStr.substr(strlen(SOAAP_FP)+1); //+1 because of _
-          SDEBUG("soaap.analysis.infoflow.fp.annotate", 3, dbgs() << INDENT_1 << "FP annotation " << annotationStrValStr << " found: " << *annotatedVar << ", funcList: " << funcListCsv << "\n");
-          istringstream ss(funcListCsv);
-          string func;
-          while(getline(ss, func, ',')) {
-            // trim leading and trailing spaces
-            size_t start = func.find_first_not_of(" ");
-            size_t end = func.find_last_not_of(" ");
-            func = func.substr(start, end-start+1);
-            SDEBUG("soaap.analysis.infoflow.fp.annotate", 3, dbgs() << INDENT_2 << "Function: " << func << "\n");
-            if (Function* callee = M.getFunction(func)) {
-              SDEBUG("soaap.analysis.infoflow.fp.annotate", 3, dbgs() << INDENT_3 << "Adding " << callee->getName() << "\n");
-              callees.insert(callee);
-            }
-          }
-          for (Context* Ctx : contexts) {
-            state[Ctx][annotatedVar] = convertFunctionSetToBitVector(callees);
-            addToWorklist(annotatedVar, Ctx, worklist);
-          }
-        }
-      }
+template <class FactType>
+void FPAnnotatedTargetsAnalysis<FactType>::initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes) {
+  FPTargetsAnalysisBase<FactType>::initialise(worklist, M, sandboxes);
+  // local variables and struct fields annotated with __soaap_fp(fns...)
+  for (const Annotation* A : AnnotationIndex::getAnnotations(SOAAP_FP, M)) {
+    if (A->origin != Annotation::VarAnnotation && A->origin != Annotation::PtrAnnotation) {
+      continue;
     }
-  }
-
-  if (Function* F = M.getFunction("llvm.ptr.annotation.p0i8")) {
-    for (User* U : F->users()) {
-      IntrinsicInst* annotateCall = dyn_cast<IntrinsicInst>(U);
-      Value* annotatedVar = dyn_cast<Value>(annotateCall->getOperand(0)->stripPointerCasts());
-      ContextVector contexts = ContextUtils::getContextsForInstruction(annotateCall, contextInsensitive, sandboxes, M);
-
-      GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(annotateCall->getOperand(1)->stripPointerCasts());
-      ConstantDataArray* annotationStrValArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-      StringRef annotationStrValStr = annotationStrValArray->getAsCString();
-      
-      if (annotationStrValStr.startswith(SOAAP_FP)) {
-        FunctionSet callees;
-        string funcListCsv = annotationStrValStr.substr(strlen(SOAAP_FP)+1); //+1 because of _
-        SDEBUG("soaap.analysis.infoflow.fp.annotate", 3, dbgs() << INDENT_1 << "FP annotation " << annotationStrValStr << " found: " << *annotatedVar << ", funcList: " << funcListCsv << "\n");
-        istringstream ss(funcListCsv);
-        string func;
-        while(getline(ss, func, ',')) {
-          // trim leading and trailing spaces
-          size_t start = func.find_first_not_of(" ");
-          size_t end = func.find_last_not_of(" ");
-          func = func.substr(start, end-start+1);
-          SDEBUG("soaap.analysis.infoflow.fp.annotate", 3, dbgs() << INDENT_2 << "Function: " << func << "\n");
-          if (Function* callee = M.getFunction(func)) {
-            SDEBUG("soaap.analysis.infoflow.fp.annotate", 3, dbgs() << INDENT_3 << "Adding " << callee->getName() << "\n");
-            callees.insert(callee);
-          }
-        }
-        for (Context* Ctx : contexts) {
-          state[Ctx][annotateCall] = convertFunctionSetToBitVector(callees);
-          addToWorklist(annotateCall, Ctx, worklist);
-        }
+    IntrinsicInst* annotateCall = A->call;
+    const ContextVector& contexts = ContextUtils::getContextsForInstruction(annotateCall, this->contextInsensitive, sandboxes, M);
+    FunctionSet callees;
+    SDEBUG("soaap.analysis.infoflow.fp.annotate", 3, dbgs() << INDENT_1 << "FP annotation " << A->str << " found: " << *A->annotated << ", funcList: " << A->payload << "\n");
+    for (const string& func : A->items) {
+      SDEBUG("soaap.analysis.infoflow.fp.annotate", 3, dbgs() << INDENT_2 << "Function: " << func << "\n");
+      if (Function* callee = M.getFunction(func)) {
+        SDEBUG("soaap.analysis.infoflow.fp.annotate", 3, dbgs() << INDENT_3 << "Adding " << callee->getName() << "\n");
+        callees.insert(callee);
       }
     }
+    // the pointer returned by a struct field annotation is what gets
+    // assigned to, whereas local variables are annotated directly
+    Value* annotatedVal = A->origin == Annotation::VarAnnotation ? A->annotated : annotateCall;
+    for (Context* Ctx : contexts) {
+      this->state.set(Ctx, annotatedVal, this->convertFunctionSetToFact(callees));
+      this->addToWorklist(annotatedVal, Ctx, worklist);
+    }
   }
 
 }
+
+template class soaap::FPAnnotatedTargetsAnalysis<IndexSet>;
+template class soaap::FPAnnotatedTargetsAnalysis<SparseBitVector<> >;
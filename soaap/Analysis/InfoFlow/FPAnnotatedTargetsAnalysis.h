@@ -40,9 +40,11 @@
 using namespace llvm;
 
 namespace soaap {
-  class FPAnnotatedTargetsAnalysis: public FPTargetsAnalysis {
+  template<class FactType>
+  class FPAnnotatedTargetsAnalysis: public FPTargetsAnalysisBase<FactType> {
     public:
-      FPAnnotatedTargetsAnalysis(bool c) : FPTargetsAnalysis(c) { }
+      typedef typename FPTargetsAnalysisBase<FactType>::ValueContextPairList ValueContextPairList;
+      FPAnnotatedTargetsAnalysis(bool c) : FPTargetsAnalysisBase<FactType>(c) { }
 
     protected:
       virtual void initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes);
@@ -44,8 +44,9 @@ using namespace soaap;
 
 FunctionSet fpTargetsUniv; // all possible fp targets in the program
 
-void FPInferredTargetsAnalysis::initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes) {
-  FPTargetsAnalysis::initialise(worklist, M, sandboxes);
+template <class FactType>
+void FPInferredTargetsAnalysis<FactType>::initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes) {
+  FPTargetsAnalysisBase<FactType>::initialise(worklist, M, sandboxes);
 
   SDEBUG("soaap.analysis.infoflow.fp.infer", 3, dbgs() << "Running FP inferred targets analysis\n");
 
@@ -103,7 +104,7 @@ void FPInferredTargetsAnalysis::initialise(ValueContextPairList& worklist, Modul
     if (F.isDeclaration()) continue;
     SDEBUG("soaap.analysis.infoflow.fp.infer", 3, dbgs() << F.getName() << "\n");
     for (Instruction& I : instructions(&F)) {
-      ContextVector contexts = ContextUtils::getContextsForInstruction(&I, contextInsensitive, sandboxes, M);
+      const ContextVector& contexts = ContextUtils::getContextsForInstruction(&I, this->contextInsensitive, sandboxes, M);
       if (StoreInst* S = dyn_cast<StoreInst>(&I)) { // assignments
         //SDEBUG("soaap.analysis.infoflow.fp.infer", 3, dbgs() << F->getName() << ": " << *S);
         Value* Rval = S->getValueOperand()->stripInBoundsConstantOffsets();
@@ -112,14 +113,13 @@ void FPInferredTargetsAnalysis::initialise(ValueContextPairList& worklist, Modul
           // we are assigning a function
           Value* Lvar = S->getPointerOperand()->stripInBoundsConstantOffsets();
           for (Context* C : contexts) {
-            setBitVector(state[C][Lvar], T);
+            this->addTarget(C, Lvar, T);
             SDEBUG("soaap.analysis.infoflow.fp.infer", 3, dbgs() << "Adding " << Lvar->getName() << " to worklist\n");
-            addToWorklist(Lvar, C, worklist);
+            this->addToWorklist(Lvar, C, worklist);
 
             if (isa<GetElementPtrInst>(Lvar)) {
-              SDEBUG("soaap.analysis.infoflow.fp.infer", 3, dbgs() << "Rewinding back to alloca\n");
-              ValueSet visited;
-              propagateToAggregate(Lvar, C, Lvar, visited, worklist, sandboxes, M);
+              SDEBUG("soaap.analysis.infoflow.fp.infer", 3, dbgs() << "Propagating to aggregate\n");
+              this->propagateToAggregate(Lvar, C, Lvar, worklist, sandboxes, M);
             }
           }
         }
@@ -161,7 +161,8 @@ void FPInferredTargetsAnalysis::initialise(ValueContextPairList& worklist, Modul
 
 }
 
-void FPInferredTargetsAnalysis::findAllFunctionPointersInValue(Value* V, ValueContextPairList& worklist, ValueSet& visited) {
+template <class FactType>
+void FPInferredTargetsAnalysis<FactType>::findAllFunctionPointersInValue(Value* V, ValueContextPairList& worklist, ValueSet& visited) {
   if (!visited.count(V)) {
     visited.insert(V);
     if (GlobalVariable* G = dyn_cast<GlobalVariable>(V)) {
@@ -181,8 +182,8 @@ void FPInferredTargetsAnalysis::findAllFunctionPointersInValue(Value* V, ValueCo
     else if (Function* F = dyn_cast<Function>(V)) {
       fpTargetsUniv.insert(F);
       SDEBUG("soaap.analysis.infoflow.fp.infer", 3, dbgs() << INDENT_1 << "Func: " << F->getName() << "\n");
-      setBitVector(state[ContextUtils::NO_CONTEXT][V], F);
-      addToWorklist(V, ContextUtils::NO_CONTEXT, worklist);
+      this->addTarget(ContextUtils::NO_CONTEXT, V, F);
+      this->addToWorklist(V, ContextUtils::NO_CONTEXT, worklist);
     }
     else if (ConstantStruct* S = dyn_cast<ConstantStruct>(V)) {
       SDEBUG("soaap.analysis.infoflow.fp.infer", 3, dbgs() << INDENT_1 << "Struct, num of fields: " << S->getNumOperands() << "\n");
@@ -194,17 +195,22 @@ void FPInferredTargetsAnalysis::findAllFunctionPointersInValue(Value* V, ValueCo
   }
 }
 
-void FPInferredTargetsAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sandboxes) {
+template <class FactType>
+void FPInferredTargetsAnalysis<FactType>::postDataFlowAnalysis(Module& M, SandboxVector& sandboxes) {
 }
 
-void FPInferredTargetsAnalysis::addInferredFunction(
+template <class FactType>
+void FPInferredTargetsAnalysis<FactType>::addInferredFunction(
     Function *F, ContextVector contexts, Value *V,
     ValueContextPairList& worklist) {
 
   fpTargetsUniv.insert(F);
 
   for (Context* Ctx : contexts) {
-    setBitVector(state[Ctx][V], F);
-    addToWorklist(V, Ctx, worklist);
+    this->addTarget(Ctx, V, F);
+    this->addToWorklist(V, Ctx, worklist);
   }
 }
+
+template class soaap::FPInferredTargetsAnalysis<IndexSet>;
+template class soaap::FPInferredTargetsAnalysis<SparseBitVector<> >;
@@ -40,9 +40,11 @@
 using namespace llvm;
 
 namespace soaap {
-  class FPInferredTargetsAnalysis: public FPTargetsAnalysis {
+  template<class FactType>
+  class FPInferredTargetsAnalysis: public FPTargetsAnalysisBase<FactType> {
     public:
-      FPInferredTargetsAnalysis(bool c) : FPTargetsAnalysis(c) { }
+      typedef typename FPTargetsAnalysisBase<FactType>::ValueContextPairList ValueContextPairList;
+      FPInferredTargetsAnalysis(bool c) : FPTargetsAnalysisBase<FactType>(c) { }
 
     protected:
       virtual void initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes);
@@ -45,7 +45,7 @@ using namespace soaap;
 map<Function*,int> FPTargetsAnalysis::funcToIdx;
 map<int,Function*> FPTargetsAnalysis::idxToFunc;
 
-void FPTargetsAnalysis::initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes) {
+void FPTargetsAnalysis::initialiseFunctionIndices(Module& M) {
   // iniitalise funcToIdx and idxToFunc maps (once)
   if (funcToIdx.empty()) {
     int nextIdx = 0;
@@ -63,61 +63,61 @@ void FPTargetsAnalysis::initialise(ValueContextPairList& worklist, Module& M, Sa
   }
 }
 
-void FPTargetsAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sandboxes) {
+template <class FactType>
+void FPTargetsAnalysisBase<FactType>::initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes) {
+  initialiseFunctionIndices(M);
 }
 
-// return the union of from and to
-bool FPTargetsAnalysis::performMeet(BitVector from, BitVector& to) {
-  return performUnion(from, to);
+template <class FactType>
+void FPTargetsAnalysisBase<FactType>::postDataFlowAnalysis(Module& M, SandboxVector& sandboxes) {
 }
 
-// return the union of from and to
-bool FPTargetsAnalysis::performUnion(BitVector from, BitVector& to) {
-  //static int counter = 0;
-  BitVector oldTo = to;
-  to |= from;
-  return to != oldTo;
+template <class FactType>
+FunctionSet FPTargetsAnalysisBase<FactType>::getTargets(Value* FP, Context* C) {
+  return convertFactToFunctionSet(this->state.lookupOrDefault(C, FP));
 }
 
-FunctionSet FPTargetsAnalysis::getTargets(Value* FP, Context* C) {
-  BitVector& vector = state[C][FP];
-  return convertBitVectorToFunctionSet(vector);
-}
-
-FunctionSet FPTargetsAnalysis::convertBitVectorToFunctionSet(BitVector vector) {
+template <class FactType>
+FunctionSet FPTargetsAnalysisBase<FactType>::convertFactToFunctionSet(const FactType& fact) {
   FunctionSet functions;
-  int idx = 0;
-  for (int i=0; i<vector.count(); i++) {
-    idx = (i == 0) ? vector.find_first() : vector.find_next(idx);
+  for (unsigned idx : BitSetTraits<FactType>::elements(fact)) {
     functions.insert(idxToFunc[idx]);
   }
   return functions;
 }
 
-BitVector FPTargetsAnalysis::convertFunctionSetToBitVector(FunctionSet funcs) {
-  BitVector vector;
+template <class FactType>
+FactType FPTargetsAnalysisBase<FactType>::convertFunctionSetToFact(const FunctionSet& funcs) {
+  FactType fact;
   for (Function* F : funcs) {
-    setBitVector(vector, F);
+    addTarget(fact, F);
   }
-  return vector;
+  return fact;
 }
 
-void FPTargetsAnalysis::setBitVector(BitVector& vector, Function* F) {
-  int idx = funcToIdx[F];
-  if (vector.size() <= idx) {
-    vector.resize(idx+1);
-  }
-  vector.set(idx);
+template <class FactType>
+void FPTargetsAnalysisBase<FactType>::addTarget(FactType& fact, Function* F) {
+  BitSetTraits<FactType>::set(fact, funcToIdx[F]);
 }
 
-string FPTargetsAnalysis::stringifyFact(BitVector fact) {
-  FunctionSet funcs = convertBitVectorToFunctionSet(fact);
+template <class FactType>
+void FPTargetsAnalysisBase<FactType>::addTarget(Context* C, const Value* V, Function* F) {
+  FactType target;
+  addTarget(target, F);
+  this->state.join(C, V, target);
+}
+
+template <class FactType>
+string FPTargetsAnalysisBase<FactType>::stringifyFact(const FactType& fact) {
+  FunctionSet funcs = convertFactToFunctionSet(fact);
   return CallGraphUtils::stringifyFunctionSet(funcs);
 }
 
-void FPTargetsAnalysis::stateChangedForFunctionPointer(CallInst* CI, const Value* FP, Context* C, BitVector& newState) {
+template <class FactType>
+void FPTargetsAnalysisBase<FactType>::stateChangedForFunctionPointer(CallInst* CI, const Value* FP, Context* C, FactType& newState) {
+  typedef BitSetTraits<FactType> Bits;
   // Filter out those callees that aren't compatible with FP's function type
-  SDEBUG("soaap.analysis.infoflow.fp", 3, dbgs() << "bits set (before): " << newState.count() << "\n");
+  SDEBUG("soaap.analysis.infoflow.fp", 3, dbgs() << "bits set (before): " << Bits::count(newState) << "\n");
   FunctionType* FT = NULL;
   if (PointerType* PT = dyn_cast<PointerType>(FP->getType())) {
     if (PointerType* PT2 = dyn_cast<PointerType>(PT->getElementType())) {
@@ -129,15 +129,14 @@ void FPTargetsAnalysis::stateChangedForFunctionPointer(CallInst* CI, const Value
   }
   
   if (FT != NULL) {
-    int idx;
-    int numSetBits = newState.count();
-    for (int i=0; i<numSetBits; i++) {
-      idx = (i == 0) ? newState.find_first() : newState.find_next(idx);
+    // collect first, as resetting bits of a sparse set invalidates iterators
+    SmallVector<unsigned,16> incompatible;
+    for (unsigned idx : Bits::elements(newState)) {
       Function* F = idxToFunc[idx];
       SDEBUG("soaap.analysis.infoflow.fp", 3, dbgs() << "F: " << F->getName() << "\n");
       SDEBUG("soaap.analysis.infoflow.fp", 3, dbgs() << "FT: " << *FT << "\n");
       if (!areTypeCompatible(F->getFunctionType(), FT)) {
-        newState.reset(idx);
+        incompatible.push_back(idx);
         FunctionType* FT2 = F->getFunctionType();
         SDEBUG("soaap.analysis.infoflow.fp", 3, dbgs() << "Function types don't match: " << *FT2 << "\n");
         SDEBUG("soaap.analysis.infoflow.fp", 3, dbgs() << "FT2.return: " << *(FT2->getReturnType()) << "\n");
@@ -146,12 +145,15 @@ void FPTargetsAnalysis::stateChangedForFunctionPointer(CallInst* CI, const Value
         SDEBUG("soaap.analysis.infoflow.fp", 3, dbgs() << "FT.vararg: " << FT->isVarArg() << "\n");
       }
     }
+    for (unsigned idx : incompatible) {
+      Bits::reset(newState, idx);
+    }
   }
   else {
     dbgs() << "Unrecognised FP: " << *FP->getType() << "\n";
   }
-  SDEBUG("soaap.analysis.infoflow.fp", 3, dbgs() << "bits set (after): " << newState.count() << "\n");
-  FunctionSet newFuncs = convertBitVectorToFunctionSet(newState);
+  SDEBUG("soaap.analysis.infoflow.fp", 3, dbgs() << "bits set (after): " << Bits::count(newState) << "\n");
+  FunctionSet newFuncs = convertFactToFunctionSet(newState);
   CallGraphUtils::addCallees(CI, C, newFuncs, true);
 }
 
@@ -180,3 +182,6 @@ bool FPTargetsAnalysis::areTypeCompatible(FunctionType* FT1, FunctionType* FT2)
   SDEBUG("soaap.analysis.infoflow.fp", 3, dbgs() << "not type compatible\n");
   return false;
 }
+
+template class soaap::FPTargetsAnalysisBase<IndexSet>;
+template class soaap::FPTargetsAnalysisBase<SparseBitVector<> >;
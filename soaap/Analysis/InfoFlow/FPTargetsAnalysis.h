@@ -35,34 +35,53 @@
 #define SOAAP_ANALYSIS_INFOFLOW_FPTARGETSANALYSIS_H
 
 #include "Analysis/InfoFlow/InfoFlowAnalysis.h"
+#include "ADT/BitSetTraits.h"
+#include "ADT/IndexSet.h"
 #include "Common/Typedefs.h"
 
-#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/SparseBitVector.h"
 
 using namespace llvm;
 
 namespace soaap {
-  class FPTargetsAnalysis: public InfoFlowAnalysis<BitVector> {
+  // Interface to the function-pointer target analyses. Target sets are
+  // indices into the module's address-taken functions, held either as dense
+  // or as sparse bit sets (see CmdLineOpts::InfoFlowSparseFacts).
+  class FPTargetsAnalysis {
     public:
-      FPTargetsAnalysis(bool contextInsens) : InfoFlowAnalysis<BitVector>(contextInsens, false) { }
-      virtual FunctionSet getTargets(Value* FP, Context* C);
-      virtual bool hasTargets() { return !state.empty(); } // TODO: should we be looking inside state?
+      virtual ~FPTargetsAnalysis() { }
+      virtual void doAnalysis(Module& M, SandboxVector& sandboxes) = 0;
+      virtual FunctionSet getTargets(Value* FP, Context* C) = 0;
+      virtual bool hasTargets() = 0;
 
     protected:
       static map<Function*,int> funcToIdx;
       static map<int,Function*> idxToFunc;
+      static void initialiseFunctionIndices(Module& M);
+      static bool areTypeCompatible(FunctionType* FT1, FunctionType* FT2);
+  };
+
+  template<class FactType>
+  class FPTargetsAnalysisBase : public FPTargetsAnalysis, public InfoFlowAnalysis<FactType,UnionLatticeTraits<FactType> > {
+    public:
+      typedef InfoFlowAnalysis<FactType,UnionLatticeTraits<FactType> > InfoFlowBase;
+      typedef typename InfoFlowBase::ValueContextPairList ValueContextPairList;
+      FPTargetsAnalysisBase(bool contextInsens) : InfoFlowBase(contextInsens, false) { }
+      virtual void doAnalysis(Module& M, SandboxVector& sandboxes) { InfoFlowBase::doAnalysis(M, sandboxes); }
+      virtual FunctionSet getTargets(Value* FP, Context* C);
+      virtual bool hasTargets() { return !this->state.empty(); } // TODO: should we be looking inside state?
+
+    protected:
       virtual void initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes) = 0;
       virtual void postDataFlowAnalysis(Module& M, SandboxVector& sandboxes);
-      virtual bool performMeet(BitVector from, BitVector& to);
-      virtual bool performUnion(BitVector from, BitVector& to);
-      virtual BitVector bottomValue() { return BitVector(); }
-      virtual bool checkEqual(BitVector f1, BitVector f2) { return f1 == f2; }
-      virtual string stringifyFact(BitVector fact);
-      virtual void stateChangedForFunctionPointer(CallInst* CI, const Value* FP, Context* C, BitVector& newState);
-      virtual FunctionSet convertBitVectorToFunctionSet(BitVector vector);
-      virtual BitVector convertFunctionSetToBitVector(FunctionSet funcs);
-      virtual void setBitVector(BitVector& vector, Function* F);
-      virtual bool areTypeCompatible(FunctionType* FT1, FunctionType* FT2);
+      virtual FactType bottomValue() { return FactType(); }
+      virtual string stringifyFact(const FactType& fact);
+      virtual void stateChangedForFunctionPointer(CallInst* CI, const Value* FP, Context* C, FactType& newState);
+      virtual FunctionSet convertFactToFunctionSet(const FactType& fact);
+      virtual FactType convertFunctionSetToFact(const FunctionSet& funcs);
+      virtual void addTarget(FactType& fact, Function* F);
+      // adds F to the targets of V in C
+      void addTarget(Context* C, const Value* V, Function* F);
   };
 }
 
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "Analysis/InfoFlow/FlowSummaries.h"
+#include "ADT/ValueNumbering.h"
+#include "Common/Debug.h"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace soaap;
+
+const FlowSummary& FlowSummaries::get(const Value* Param) {
+  std::unique_ptr<FlowSummary>& S = summaries[Param];
+  if (S) {
+    return *S;
+  }
+  S.reset(new FlowSummary);
+
+  const Function* F = isa<Argument>(Param) ? cast<Argument>(Param)->getParent()
+                                           : cast<Instruction>(Param)->getParent()->getParent();
+  ValueNumbering& numbering = ValueNumbering::getModuleNumbering();
+  SmallPtrSet<const Value*,32> visited;
+  SmallVector<const Value*,16> worklist;
+  visited.insert(Param);
+  worklist.push_back(Param);
+  while (!worklist.empty()) {
+    const Value* V = worklist.pop_back_val();
+    FlowSummary::Entry E;
+    E.id = numbering.getOrCreateId(V);
+    E.exit = false;
+    const Instruction* VI = dyn_cast<Instruction>(V);
+    if (!(V == Param || (VI != NULL && VI->getParent()->getParent() == F))) {
+      // e.g. a global stored into, whose uses are elsewhere
+      E.exit = true;
+      S->values.push_back(E);
+      continue;
+    }
+    // mirrors the cases of InfoFlowAnalysis::performDataFlowAnalysis
+    for (const User* U : V->users()) {
+      const Value* next = NULL;
+      const Instruction* I = dyn_cast<Instruction>(U);
+      if (I == NULL || I->getParent()->getParent() != F) {
+        E.exit = true;
+      }
+      else if (const StoreInst* SI = dyn_cast<StoreInst>(I)) {
+        if (SI->getPointerOperand() == V) {
+          continue;
+        }
+        if (isa<GetElementPtrInst>(SI->getPointerOperand())) {
+          E.exit = true;
+        }
+        else {
+          next = SI->getPointerOperand();
+        }
+      }
+      else if (const IntrinsicInst* II = dyn_cast<IntrinsicInst>(I)) {
+        if (II->getIntrinsicID() == Intrinsic::ptr_annotation) {
+          next = II;
+        }
+        else {
+          E.exit = true;
+        }
+      }
+      else if (isa<CallInst>(I) || isa<ReturnInst>(I) || I->isBinaryOp()) {
+        E.exit = true;
+      }
+      else {
+        next = I;
+      }
+      if (next != NULL && visited.insert(next).second) {
+        worklist.push_back(next);
+      }
+    }
+    S->values.push_back(E);
+  }
+
+  SDEBUG("soaap.analysis.infoflow.summaries", 3, dbgs() << "Summarised " << *Param << " of " << F->getName() << ": "
+                                                         << S->values.size() << " values\n");
+  return *S;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_ANALYSIS_INFOFLOW_FLOWSUMMARIES_H
+#define SOAAP_ANALYSIS_INFOFLOW_FLOWSUMMARIES_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Value.h"
+
+#include <memory>
+
+using namespace llvm;
+
+namespace soaap {
+  // Intraprocedural summary of a param (or va_list): the values of the
+  // function that a fact entering it is joined into by InfoFlowAnalysis,
+  // found by following the uses whose transfer is a plain join (casts,
+  // GEPs, loads, phis, selects, ptr annotations and stores into a non-GEP
+  // pointer).
+  //
+  // Uses with any other effect (calls, returns, binary ops, stores into a
+  // GEP, which also reach the aggregate) end the summary: the values with
+  // such uses are marked as exits, and values outside the function (e.g.
+  // globals stored into) are exits that are not followed further.
+  struct FlowSummary {
+    struct Entry {
+      unsigned id; // in the module numbering
+      bool exit;
+    };
+    SmallVector<Entry,16> values;
+  };
+
+  // Memoised FlowSummary for each param. A summary depends on neither the
+  // context nor the fact, so it is computed once and then applied by
+  // InfoFlowAnalysis at each call site, in every calling context, by joining
+  // the incoming fact into each value rather than walking the callee's body
+  // from the worklist (see InfoFlowAnalysis::applySummary). Only the exits
+  // that change are put on the worklist.
+  class FlowSummaries {
+    public:
+      const FlowSummary& get(const Value* Param);
+      void clear() { summaries.clear(); }
+
+    private:
+      DenseMap<const Value*,std::unique_ptr<FlowSummary> > summaries;
+  };
+}
+
+#endif
@@ -34,9 +34,16 @@
 #ifndef SOAAP_ANALYSIS_INFOFLOW_INFOFLOWANALYSIS_H
 #define SOAAP_ANALYSIS_INFOFLOW_INFOFLOWANALYSIS_H
 
+#include <atomic>
+#include <chrono>
 #include <map>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SetVector.h"
@@ -53,9 +60,17 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Transforms/Utils/Local.h"
 
+#include "ADT/FactTable.h"
+#include "ADT/MessageQueue.h"
+#include "ADT/PriorityQueueSet.h"
 #include "ADT/QueueSet.h"
 #include "Analysis/Analysis.h"
-#include "Analysis/InfoFlow/InfoFlowAnalysis.h"
+#include "Analysis/InfoFlow/AliasClasses.h"
+#include "Analysis/InfoFlow/DefUseOrder.h"
+#include "Analysis/InfoFlow/ExternModels.h"
+#include "Analysis/InfoFlow/CallInterfaces.h"
+#include "Analysis/InfoFlow/FlowSummaries.h"
+#include "Analysis/InfoFlow/LatticeTraits.h"
 #include "Common/CmdLineOpts.h"
 #include "Common/Debug.h"
 #include "Util/CallGraphUtils.h"
@@ -72,453 +87,686 @@ namespace soaap {
   // There are three types of context: no context, privileged context and sandbox.
   // A fourth context "single" is used for context-insensitivity
   // These contexts are found in Context.h
-  template<class FactType>
+  // Facts are merged using the operations of Lattice (see LatticeTraits.h).
+  // The solver works on interned fact ids (see FactTable.h), so merges of
+  // facts that have been merged before, and copying facts between contexts,
+  // cost a hash lookup or an integer copy.
+  // In may analyses whose facts only ever merge by join, a fact passed to a
+  // callee is pushed through the callee's body by applying the param's flow
+  // summary (see FlowSummaries.h) rather than from the worklist.
+  //
+  // Context-sensitive may analyses can be solved on several threads
+  // (-soaap-infoflow-threads). The contexts are then dealt out to
+  // partitions, each with its own worklist and caches, and each partition is
+  // solved by its own thread. Propagations into another partition's context
+  // (at sandbox entrypoints, callgates and returns from them, and from the
+  // "no context") are batched and posted to its lock-free inbox. A shared
+  // count of working partitions and undelivered messages tells the threads
+  // when the fixed point has been reached. Function-pointer callbacks change
+  // the call graph that all threads read, so they are deferred until the
+  // threads have stopped, after which another round is run.
+  template<class FactType, class Lattice = LatticeTraits<FactType> >
   class InfoFlowAnalysis : public Analysis {
     public:
-      typedef DenseMap<const Value*, FactType> DataflowFacts;
+      typedef ContextFacts<FactId> DataflowFacts;
       typedef pair<const Value*, Context*> ValueContextPair;
-      typedef QueueSet<ValueContextPair> ValueContextPairList;
-      InfoFlowAnalysis(bool c = false, bool m = false) : contextInsensitive(c), mustAnalysis(m) { }
+      typedef PriorityQueueSet<ValueContextPair> ValueContextPairList;
+      InfoFlowAnalysis(bool c = false, bool m = false) : aliases(AliasClasses::getModuleAliases()), contextInsensitive(c), mustAnalysis(m), outstanding(0), worklistPops(0), worklistRepops(0), summaryApplications(0), summaryHits(0), messagesPosted(0), solveTime(0) { }
       virtual void doAnalysis(Module& M, SandboxVector& sandboxes);
+      // number of worklist dequeues, and how many of those were of a
+      // (value, context) pair that had already been dequeued before
+      uint64_t getNumWorklistPops() { return worklistPops; }
+      uint64_t getNumWorklistRepops() { return worklistRepops; }
+      // size of the final state, and time spent reaching the fixed point
+      uint64_t getNumFacts();
+      uint64_t getFactMemoryUsage();
+      double getSolveTimeMillis() { return solveTime; }
+      // number of propagations posted from one partition to another
+      uint64_t getNumMessagesPosted() { return messagesPosted; }
 
     protected:
-      map<Context*, DataflowFacts> state;
-      map<StructType*, ArgumentSet> classToThisParams;
+      // what the receiver of a propagation does with the value it was
+      // propagated to
+      enum FollowUp { EnqueueAlways, EnqueueIfChanged, SummaryIfChanged };
+      // a propagation into a context owned by another partition: fact is
+      // merged into V's fact in C (joined if additive, met otherwise)
+      struct Message {
+        const Value* V;
+        Context* C;
+        FactId fact;
+        bool additive;
+        FollowUp followUp;
+      };
+      // A share of the contexts, with everything that solving them needs
+      // that is not shared. Every worklist the solver hands out is a
+      // partition.
+      struct Partition : public ValueContextPairList {
+        MessageQueue<Message> inbox;
+        // messages not yet posted, by destination partition
+        vector<vector<Message> > outboxes;
+        CallInterfaces interfaces;
+        FlowSummaries summaries;
+        // the param fact that each (param, context) last had its summary
+        // applied with
+        DenseMap<pair<const Value*,Context*>,FactId> summaryInputs;
+        uint64_t summaryApplications;
+        uint64_t summaryHits;
+        uint64_t messagesPosted;
+        Partition() : summaryApplications(0), summaryHits(0), messagesPosted(0) { }
+      };
+      static const unsigned MessageBatchSize = 64;
+      // how many pairs a partition's thread pops between checks of its inbox
+      static const unsigned PopsPerInboxCheck = 256;
+
+      FactTable<FactType,Lattice> state;
+      AliasClasses& aliases;
       bool contextInsensitive;
       bool mustAnalysis;
       map<Function*,map<Context*,CallInstSet> > inContextCallers;
+      DefUseOrder order;
+      vector<unique_ptr<Partition> > partitions;
+      DenseMap<Context*,unsigned> contextToPartition;
+      // partitions that are working plus messages posted but not yet
+      // received. The threads stop once it drops to zero.
+      atomic<int64_t> outstanding;
+      // function-pointer calls whose callbacks wait for the threads to stop
+      SetVector<pair<CallInst*,ValueContextPair> > deferredFPCalls;
+      mutex deferredFPCallsMutex;
+      uint64_t worklistPops;
+      uint64_t worklistRepops;
+      uint64_t summaryApplications;
+      uint64_t summaryHits;
+      uint64_t messagesPosted;
+      double solveTime;
       virtual void initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes) = 0;
       virtual void performDataFlowAnalysis(ValueContextPairList&, SandboxVector& sandboxes, Module& M);
-      // performMeet: toVal = fromVal /\ toVal. return true <-> toVal != fromVal /\ toVal
-      virtual bool performMeet(FactType fromVal, FactType& toVal) = 0;
-      virtual bool performUnion(FactType fromVal, FactType& toVal) = 0;
-      virtual bool checkEqual(FactType f1, FactType f2) = 0;
       virtual bool propagateToValue(const Value* from, const Value* to, Context* cFrom, Context* cTo, Module& M, bool additive = false);
-      virtual bool propagateToValue(FactType fact, const Value* to, Context* C, Module& M);
+      virtual bool propagateToValue(const FactType& fact, const Value* to, Context* C, Module& M);
+      // sets to's fact in C to the fact with the given id; returns true if it changed
+      bool updateFact(FactId fact, const Value* to, Context* C);
+      // joins (if additive) or meets the fact with the given id into to's
+      // fact in C; returns true if it changed
+      bool mergeFact(FactId fact, const Value* to, Context* C, bool additive);
+      // propagates from's fact in cFrom to to in cTo and then acts as F
+      // says. If cTo belongs to another partition, the propagation is
+      // posted to it instead.
+      void propagateToContext(const Value* from, const Value* to, Context* cFrom, Context* cTo, bool additive, FollowUp F, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M);
+      void followUp(const Value* V, Context* C, bool changed, FollowUp F, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M);
+      // propagates V's fact in C to its uses
+      void propagateFromValue(const Value* V, Context* C, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M);
+      void createPartitions(SandboxVector& sandboxes);
+      Partition& getPartition(ValueContextPairList& worklist) { return static_cast<Partition&>(worklist); }
+      Partition& getOwner(Context* C) { return *partitions[contextToPartition.lookup(C)]; }
+      void solveInParallel(SandboxVector& sandboxes, Module& M);
+      void runPartition(Partition& P, SandboxVector& sandboxes, Module& M);
+      void postMessage(Partition& P, Context* C, const Message& msg);
+      void flushOutbox(Partition& P, unsigned dest);
       virtual void propagateToCallees(CallInst* CI, const Value* V, Context* C, bool propagateAllArgs, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M);
       virtual void propagateToCallers(ReturnInst* RI, const Value* V, Context* C, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M);
+      bool useSummaries() const {
+        return !mustAnalysis && !CmdLineOpts::InfoFlowNoSummaries && std::is_same<Lattice,UnionLatticeTraits<FactType> >::value;
+      }
+      // pushes Param's fact in C through its function's body, having
+      // changed; falls back to the worklist if the summary does not apply
+      void applySummary(const Value* Param, Context* C, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M);
       virtual Value* propagateForExternCall(CallInst* CI, const Value* V);
       virtual void postDataFlowAnalysis(Module& M, SandboxVector& sandboxes) = 0;
+      // queues (V, C) on the partition owning C
       virtual void addToWorklist(const Value* V, Context* C, ValueContextPairList& worklist);
       virtual FactType bottomValue() = 0;
-      virtual string stringifyFact(FactType f) = 0;
+      virtual string stringifyFact(const FactType& f) = 0;
       virtual string stringifyValue(const Value* V);
       virtual void stateChangedForFunctionPointer(CallInst* CI, const Value* FP, Context* C, FactType& newState);
       virtual CallInstSet getCallersInContext(Function* callee, Context* C, SandboxVector& sandboxes, Module& M);
-      virtual void propagateToAggregate(const Value* V, Context* C, Value* Agg, ValueSet& visited, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M);
+      // propagates V's fact in C to the locations owning the object Ptr points into
+      virtual void propagateToAggregate(const Value* V, Context* C, const Value* Ptr, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M);
   };
 
-  template <class FactType>
-  void InfoFlowAnalysis<FactType>::doAnalysis(Module& M, SandboxVector& sandboxes) {
-    ValueContextPairList worklist;
+  template <class FactType, class Lattice>
+  void InfoFlowAnalysis<FactType,Lattice>::doAnalysis(Module& M, SandboxVector& sandboxes) {
+    // alias classes for propagating stores to the objects they write into.
+    // These are shared with the other analyses and only recomputed if an
+    // indirect call has gained a callee since they were last computed.
+    aliases.update(M);
+    if (!CmdLineOpts::InfoFlowFIFOWorklist) {
+      // visit values in def-use SCC order. The order is computed against the
+      // call graph as it stands now; edges added during the analysis (e.g.
+      // by fp-target inference) only affect visiting order, not results.
+      order.compute(M);
+    }
+    createPartitions(sandboxes);
+    ValueContextPairList& worklist = *partitions[0];
     initialise(worklist, M, sandboxes);
+    chrono::steady_clock::time_point solveStart = chrono::steady_clock::now();
     performDataFlowAnalysis(worklist, sandboxes, M);
+    solveTime = chrono::duration<double,milli>(chrono::steady_clock::now() - solveStart).count();
+    worklistPops = worklistRepops = summaryApplications = summaryHits = messagesPosted = 0;
+    for (unique_ptr<Partition>& P : partitions) {
+      worklistPops += P->getNumPops();
+      worklistRepops += P->getNumRepops();
+      summaryApplications += P->summaryApplications;
+      summaryHits += P->summaryHits;
+      messagesPosted += P->messagesPosted;
+    }
+    SDEBUG("soaap.analysis.infoflow", 1, dbgs() << INDENT_1 << "Worklist pops: " << worklistPops
+                                                << ", re-pops: " << worklistRepops << "\n");
+    SDEBUG("soaap.analysis.infoflow", 1, dbgs() << INDENT_1 << "Facts: " << getNumFacts()
+                                                << " (" << state.getInterner().size() << " distinct)"
+                                                << ", fact memory: " << getFactMemoryUsage() << " bytes"
+                                                << ", solve time: " << solveTime << " ms\n");
+    SDEBUG("soaap.analysis.infoflow", 1, dbgs() << INDENT_1 << "Joins/meets: " << state.getInterner().getNumCombines()
+                                                << ", memoised: " << state.getInterner().getNumCombineHits() << "\n");
+    SDEBUG("soaap.analysis.infoflow", 1, dbgs() << INDENT_1 << "Summary applications: " << summaryApplications
+                                                << ", memoised: " << summaryHits << "\n");
     postDataFlowAnalysis(M, sandboxes);
   }
 
-  template <typename FactType>
-  void InfoFlowAnalysis<FactType>::performDataFlowAnalysis(ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M) {
+  template <typename FactType, typename Lattice>
+  uint64_t InfoFlowAnalysis<FactType,Lattice>::getNumFacts() {
+    uint64_t numFacts = 0;
+    for (Context* C : state.getContexts()) {
+      numFacts += state[C].size();
+    }
+    return numFacts;
+  }
+
+  template <typename FactType, typename Lattice>
+  uint64_t InfoFlowAnalysis<FactType,Lattice>::getFactMemoryUsage() {
+    // a fact id per (value, context) pair, plus each distinct fact once
+    return getNumFacts() * sizeof(FactId) + state.getInterner().getMemoryUsage();
+  }
+
+  template <typename FactType, typename Lattice>
+  void InfoFlowAnalysis<FactType,Lattice>::createPartitions(SandboxVector& sandboxes) {
+    // Must analyses meet the facts of other contexts (e.g. of all of a
+    // callee's return values) and context-insensitive ones have a single
+    // context, so both are solved by one partition. As are all analyses when
+    // debugging, as the debug output is not thread-safe.
+    ContextVector Cs = ContextUtils::getAllContexts(sandboxes);
+    unsigned numPartitions = 1;
+    if (CmdLineOpts::InfoFlowThreads > 1 && !mustAnalysis && !contextInsensitive && CmdLineOpts::DebugModule.empty()) {
+      numPartitions = min((unsigned)CmdLineOpts::InfoFlowThreads, (unsigned)Cs.size());
+    }
+    partitions.clear();
+    contextToPartition.clear();
+    for (unsigned i=0; i<numPartitions; i++) {
+      Partition* P = new Partition;
+      partitions.push_back(unique_ptr<Partition>(P));
+      P->outboxes.resize(numPartitions);
+      // re-pops are only reported when debugging
+      P->setCountRepops(!CmdLineOpts::DebugModule.empty());
+      if (!CmdLineOpts::InfoFlowFIFOWorklist) {
+        P->setPriorityFunction([this](const ValueContextPair& VC) {
+          return order.getPriority(VC.first);
+        });
+      }
+    }
+    // contexts not dealt out (i.e. the single context) belong to the first
+    for (unsigned i=0; i<Cs.size(); i++) {
+      contextToPartition[Cs[i]] = i % numPartitions;
+    }
+  }
+
+  template <typename FactType, typename Lattice>
+  void InfoFlowAnalysis<FactType,Lattice>::performDataFlowAnalysis(ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M) {
 
     // merge contexts if this is a context-insensitive analysis
     if (contextInsensitive) {
       SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_1 << "Merging contexts\n")
       worklist.clear();
-      for (typename map<Context*,DataflowFacts>::iterator I=state.begin(), E=state.end(); I != E; I++) {
-        Context* C = I->first;
-        DataflowFacts F = I->second;
-        for (typename DataflowFacts::iterator DI=F.begin(), DE=F.end(); DI != DE; DI++) {
-          const Value* V = DI->first;
-          FactType T = DI->second;
-          state[ContextUtils::SINGLE_CONTEXT][V] = T; // TODO: what if same V appears in multiple contexts?
+      DataflowFacts& singleFacts = state[ContextUtils::SINGLE_CONTEXT];
+      for (Context* C : state.getContexts()) {
+        DataflowFacts& F = state[C];
+        for (typename DataflowFacts::iterator DI=F.begin(), DE=F.end(); DI != DE; ++DI) {
+          const Value* V = DI.getValue();
+          singleFacts[V] = DI.getFact(); // TODO: what if same V appears in multiple contexts?
           addToWorklist(V, ContextUtils::SINGLE_CONTEXT, worklist);
         }
       }
     }
 
-    // calculate class -> this param mappings by iterating through all methods
-    SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_1 << "Calculating class->this mappings\n");
-    for (Function& F : M.functions()) {
-      if (F.isDeclaration()) { continue; }
-      else {
-        if (F.arg_size() > 0) {
-          Argument* A = &*(F.arg_begin());
-          SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_1 << "First arg: " << *A << "\n");
-          if (A->getName() == "this") {
-            StructType* ST = cast<StructType>(cast<PointerType>(A->getType())->getElementType());
-            SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_1 << "Struct type: " << ST->getName() << "\n");
-            classToThisParams[ST].insert(A);
+    // perform propagation until fixed point is reached
+    if (partitions.size() > 1) {
+      solveInParallel(sandboxes, M);
+    }
+    else {
+      while (!worklist.empty()) {
+        ValueContextPair P = worklist.dequeue();
+        propagateFromValue(P.first, P.second, worklist, sandboxes, M);
+      }
+    }
+
+    // unmerge contexts if this is a context-insensitive analysis
+    if (contextInsensitive) {
+      SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_1 << "Unmerging contexts\n");
+      ContextVector Cs = ContextUtils::getAllContexts(sandboxes);
+      DataflowFacts& F = state[ContextUtils::SINGLE_CONTEXT];
+      for (typename DataflowFacts::iterator I=F.begin(), E=F.end(); I != E; ++I) {
+        const Value* V = I.getValue();
+        for (Context* C : Cs) {
+          state[C][V] = I.getFact();
+        }
+      }
+    }
+
+  }
+
+  template <typename FactType, typename Lattice>
+  void InfoFlowAnalysis<FactType,Lattice>::solveInParallel(SandboxVector& sandboxes, Module& M) {
+    // every context's table is created up front, so that the threads only
+    // ever look tables up
+    for (Context* C : ContextUtils::getAllContexts(sandboxes)) {
+      state[C];
+    }
+    state.setConcurrent(true);
+    while (true) {
+      // the threads only read the context tables, the call graph and the
+      // sandboxes, none of which change until they have stopped
+      ContextUtils::precomputeContextTables(sandboxes, M);
+      outstanding = partitions.size();
+      vector<thread> threads;
+      for (unsigned i=1; i<partitions.size(); i++) {
+        Partition* P = partitions[i].get();
+        threads.push_back(thread([this, P, &sandboxes, &M] {
+          runPartition(*P, sandboxes, M);
+        }));
+      }
+      runPartition(*partitions[0], sandboxes, M);
+      for (thread& T : threads) {
+        T.join();
+      }
+      if (deferredFPCalls.empty()) {
+        break;
+      }
+      // run the function-pointer callbacks, which may add callees, and
+      // propagate to the callees. Anything this propagates to another
+      // partition is posted in the next round.
+      vector<pair<CallInst*,ValueContextPair> > calls = deferredFPCalls.takeVector();
+      for (const pair<CallInst*,ValueContextPair>& FPCall : calls) {
+        CallInst* CI = FPCall.first;
+        const Value* V = FPCall.second.first;
+        Context* C = FPCall.second.second;
+        FactType newState = state.lookupOrDefault(C, V);
+        stateChangedForFunctionPointer(CI, V, C, newState);
+        state.set(C, V, newState);
+        propagateToCallees(CI, V, C, true, getOwner(C), sandboxes, M);
+      }
+    }
+    state.setConcurrent(false);
+  }
+
+  template <typename FactType, typename Lattice>
+  void InfoFlowAnalysis<FactType,Lattice>::runPartition(Partition& P, SandboxVector& sandboxes, Module& M) {
+    // P counts towards outstanding while it is working, as does each
+    // message from when it is posted until it has been received. P stops
+    // working once its worklist and inbox are empty and it has posted all
+    // of its messages, but resumes if it receives any more.
+    bool working = true;
+    while (true) {
+      if (!working) {
+        if (P.inbox.empty()) {
+          if (outstanding == 0) {
+            break;
           }
+          this_thread::yield();
+          continue;
+        }
+        outstanding++;
+        working = true;
+      }
+      unsigned received = P.inbox.consume([&](Message& msg) {
+        bool changed = mergeFact(msg.fact, msg.V, msg.C, msg.additive);
+        followUp(msg.V, msg.C, changed, msg.followUp, P, sandboxes, M);
+      });
+      if (received > 0) {
+        outstanding -= received;
+      }
+      for (unsigned i=0; i<PopsPerInboxCheck && !P.empty(); i++) {
+        ValueContextPair VC = P.dequeue();
+        propagateFromValue(VC.first, VC.second, P, sandboxes, M);
+      }
+      if (P.empty()) {
+        for (unsigned dest=0; dest<partitions.size(); dest++) {
+          flushOutbox(P, dest);
+        }
+        if (P.inbox.empty()) {
+          outstanding--;
+          working = false;
         }
       }
     }
-    
+  }
 
+  template <typename FactType, typename Lattice>
+  void InfoFlowAnalysis<FactType,Lattice>::postMessage(Partition& P, Context* C, const Message& msg) {
+    unsigned dest = contextToPartition.lookup(C);
+    P.outboxes[dest].push_back(msg);
+    P.messagesPosted++;
+    if (P.outboxes[dest].size() >= MessageBatchSize) {
+      flushOutbox(P, dest);
+    }
+  }
 
-    // perform propagation until fixed point is reached
-    while (!worklist.empty()) {
-      ValueContextPair P = worklist.dequeue();
-      const Value* V = P.first;
-      Context* C = P.second;
-
-      SDEBUG("soaap.analysis.infoflow", 3,
-            dbgs() << "\n" << INDENT_1 << "Popped (" << stringifyValue(V) << ", "
-                   << ContextUtils::stringifyContext(C) << ")\n"); 
-      SDEBUG("soaap.analysis.infoflow", 3,
-            dbgs() << INDENT_1 << "state[C][V]: " << stringifyFact(state[C][V]) << "\n" 
-                   << INDENT_2 << "Finding uses (" << V->getNumUses() << ")\n");
-      for (User* U : ((Value*)V)->users()) {
-        SDEBUG("soaap.analysis.infoflow" ,4, dbgs() << INDENT_3 << "Use: " << stringifyValue(U) << "\n")
-        const Value* V2 = NULL;
-        if (Constant* CS = dyn_cast<Constant>(U)) {
-          V2 = CS;
-          if (propagateToValue(V, V2, C, C, M, true)) { // propagate taint from (V,C) to (V2,C)
-            SDEBUG("soaap.analysis.infoflow" , 3,
-                  dbgs() << INDENT_4 << "Propagating (" << stringifyValue(V)
-                    << ", " << ContextUtils::stringifyContext(C) << ") to (" << stringifyValue(V2) 
-                    << ", " << ContextUtils::stringifyContext(C) << ")\n");
-            addToWorklist(V2, C, worklist);
+  template <typename FactType, typename Lattice>
+  void InfoFlowAnalysis<FactType,Lattice>::flushOutbox(Partition& P, unsigned dest) {
+    vector<Message>& outbox = P.outboxes[dest];
+    if (!outbox.empty()) {
+      // counted before it can be received
+      outstanding += outbox.size();
+      partitions[dest]->inbox.push(outbox);
+    }
+  }
+
+  template <typename FactType, typename Lattice>
+  void InfoFlowAnalysis<FactType,Lattice>::propagateFromValue(const Value* V, Context* C, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M) {
+
+    SDEBUG("soaap.analysis.infoflow", 3,
+          dbgs() << "\n" << INDENT_1 << "Popped (" << stringifyValue(V) << ", "
+                 << ContextUtils::stringifyContext(C) << ")\n"); 
+    SDEBUG("soaap.analysis.infoflow", 3,
+          dbgs() << INDENT_1 << "state[C][V]: " << stringifyFact(state.lookupOrDefault(C, V)) << "\n" 
+                 << INDENT_2 << "Finding uses (" << V->getNumUses() << ")\n");
+    for (User* U : ((Value*)V)->users()) {
+      SDEBUG("soaap.analysis.infoflow" ,4, dbgs() << INDENT_3 << "Use: " << stringifyValue(U) << "\n")
+      const Value* V2 = NULL;
+      if (Constant* CS = dyn_cast<Constant>(U)) {
+        V2 = CS;
+        if (propagateToValue(V, V2, C, C, M, true)) { // propagate taint from (V,C) to (V2,C)
+          SDEBUG("soaap.analysis.infoflow" , 3,
+                dbgs() << INDENT_4 << "Propagating (" << stringifyValue(V)
+                  << ", " << ContextUtils::stringifyContext(C) << ") to (" << stringifyValue(V2) 
+                  << ", " << ContextUtils::stringifyContext(C) << ")\n");
+          addToWorklist(V2, C, worklist);
+        }
+      }
+      else if (Instruction* I = dyn_cast<Instruction>(U)) {
+        SDEBUG("soaap.analysis.infoflow", 5, dbgs() << "Instruction\n");
+        if (C == ContextUtils::NO_CONTEXT) {
+          // update the taint value for the correct context and put the new pair on the worklist
+          const ContextVector& C2s = ContextUtils::getContextsForInstruction(I, contextInsensitive, sandboxes, M);
+          for (Context* C2 : C2s) {
+            SDEBUG("soaap.analysis.infoflow", 3,
+                dbgs() << INDENT_4 << "Propagating (" << stringifyValue(V)
+                  << ", " << ContextUtils::stringifyContext(C) << ") to (" << stringifyValue(V)
+                  << ", " << ContextUtils::stringifyContext(C2) << ")\n");
+            propagateToContext(V, V, C, C2, true, EnqueueAlways, worklist, sandboxes, M);
           }
         }
-        else if (Instruction* I = dyn_cast<Instruction>(U)) {
-          SDEBUG("soaap.analysis.infoflow", 5, dbgs() << "Instruction\n");
-          if (C == ContextUtils::NO_CONTEXT) {
-            // update the taint value for the correct context and put the new pair on the worklist
-            ContextVector C2s = ContextUtils::getContextsForInstruction(I, contextInsensitive, sandboxes, M);
-            for (Context* C2 : C2s) {
-              SDEBUG("soaap.analysis.infoflow", 3,
-                  dbgs() << INDENT_4 << "Propagating (" << stringifyValue(V)
-                    << ", " << ContextUtils::stringifyContext(C) << ") to (" << stringifyValue(V)
-                    << ", " << ContextUtils::stringifyContext(C2) << ")\n");
-              propagateToValue(V, V, C, C2, M, true); 
-              addToWorklist(V, C2, worklist);
+        else if (ContextUtils::isInContext(I, C, contextInsensitive, sandboxes, M)) { // check if using instruction is in context C
+          SDEBUG("soaap.analysis.infoflow", 5, dbgs() << "in context\n");
+          if (StoreInst* SI = dyn_cast<StoreInst>(I)) {
+            SDEBUG("soaap.analysis.infoflow", 5, dbgs() << "store\n");
+            if (V == SI->getPointerOperand()) { // to avoid infinite looping
+              // TODO: Are we clobbering V's dataflow state?
+              continue;
             }
+            V2 = SI->getPointerOperand();
+            SDEBUG("soaap.analysis.infoflow", 5, dbgs() << "obtained store pointer operand\n");
           }
-          else if (ContextUtils::isInContext(I, C, contextInsensitive, sandboxes, M)) { // check if using instruction is in context C
-            SDEBUG("soaap.analysis.infoflow", 5, dbgs() << "in context\n");
-            if (StoreInst* SI = dyn_cast<StoreInst>(I)) {
-              SDEBUG("soaap.analysis.infoflow", 5, dbgs() << "store\n");
-              if (V == SI->getPointerOperand()) { // to avoid infinite looping
-                // TODO: Are we clobbering V's dataflow state?
-                continue;
-              }
-              V2 = SI->getPointerOperand();
-              SDEBUG("soaap.analysis.infoflow", 5, dbgs() << "obtained store pointer operand\n");
+          else if (IntrinsicInst* II = dyn_cast<IntrinsicInst>(I)) {
+            if (II->getIntrinsicID() == Intrinsic::ptr_annotation) { // covers llvm.ptr.annotation.p0i8
+              SDEBUG("soaap.analysis.infoflow", 4, II->dump());
+              V2 = II;
             }
-            else if (IntrinsicInst* II = dyn_cast<IntrinsicInst>(I)) {
-              if (II->getIntrinsicID() == Intrinsic::ptr_annotation) { // covers llvm.ptr.annotation.p0i8
-                SDEBUG("soaap.analysis.infoflow", 4, II->dump());
-                V2 = II;
-              }
+            else if (ExternModels::getModel(II->getCalledFunction())) { // e.g. llvm.memcpy
+              V2 = propagateForExternCall(II, V);
             }
-            else if (CallInst* CI = dyn_cast<CallInst>(I)) {
-              // propagate to the callee(s)
-              SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_4 << "Call instruction; propagating to callees\n");
-              if (CallGraphUtils::isExternCall(CI)) { // no function body, so we approximate effects of known funcs
-                V2 = propagateForExternCall(CI, V);
-              }
-              else {
-                bool propagateAllArgs = false;
-                if (CI->getCalledValue() == V) {
-                  // subclasses might want to be informed when
-                  // the state of a function pointer changed
-                  SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_5 << "state changed for function pointer\n");
-                  stateChangedForFunctionPointer(CI, V, C, state[C][V]);
-                  
-                  // if callee information has changed, we should propagate all
-                  // args to callees in case this is the first time for some
-                  propagateAllArgs = true;
-                }
-                propagateToCallees(CI, V, C, propagateAllArgs, worklist, sandboxes, M);
-                continue;
-              }
+          }
+          else if (CallInst* CI = dyn_cast<CallInst>(I)) {
+            // propagate to the callee(s)
+            SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_4 << "Call instruction; propagating to callees\n");
+            if (CallGraphUtils::isExternCall(CI)) { // no function body, so we approximate effects of known funcs
+              V2 = propagateForExternCall(CI, V);
             }
-            else if (ReturnInst* RI = dyn_cast<ReturnInst>(I)) {
-              if (Value* RetVal = RI->getReturnValue()) {
-                SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_4 << "Return instruction; propagating to callers\n");
-                propagateToCallers(RI, RetVal, C, worklist, sandboxes, M);
+            else {
+              bool propagateAllArgs = false;
+              if (CI->getCalledValue() == V) {
+                if (partitions.size() > 1) {
+                  // the callback may change the call graph, which the other
+                  // partitions' threads are reading, so it waits until they
+                  // have stopped (see solveInParallel)
+                  lock_guard<mutex> guard(deferredFPCallsMutex);
+                  deferredFPCalls.insert(make_pair(CI, make_pair(V, C)));
+                  continue;
+                }
+                // subclasses might want to be informed when
+                // the state of a function pointer changed
+                SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_5 << "state changed for function pointer\n");
+                FactType newState = state.lookupOrDefault(C, V);
+                stateChangedForFunctionPointer(CI, V, C, newState);
+                state.set(C, V, newState);
+                
+                // if callee information has changed, we should propagate all
+                // args to callees in case this is the first time for some
+                propagateAllArgs = true;
               }
+              propagateToCallees(CI, V, C, propagateAllArgs, worklist, sandboxes, M);
               continue;
             }
-            else if (I->isBinaryOp()) {
-              // The resulting value is a combination of its operands and we do not combine
-              // dataflow facts in this way. So we do not propagate the dataflow-value of V
-              // but actually set it to the bottom value.
-              SDEBUG("soaap.analysis.infoflow", 4, dbgs() << INDENT_4 << "Binary operator, propagating bottom to " << *I << "\n");
-              state[C][I] = bottomValue();
-              addToWorklist(I, C, worklist);
-              continue;
+          }
+          else if (ReturnInst* RI = dyn_cast<ReturnInst>(I)) {
+            if (Value* RetVal = RI->getReturnValue()) {
+              SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_4 << "Return instruction; propagating to callers\n");
+              propagateToCallers(RI, RetVal, C, worklist, sandboxes, M);
             }
-            else if (PHINode* PHI = dyn_cast<PHINode>(I)) {
-              // take the meet of all incoming values
-              if (mustAnalysis) {
-                FactType meet;
-                bool first = true;
-                for (int i=0; i<PHI->getNumIncomingValues(); i++) {
-                  Value* IV = PHI->getIncomingValue(i);
-                  if (first) {
-                    meet = state[C][IV];
-                    first = false;
-                  }
-                  else {
-                    performMeet(state[C][IV], meet);
-                  }
+            continue;
+          }
+          else if (I->isBinaryOp()) {
+            // The resulting value is a combination of its operands and we do not combine
+            // dataflow facts in this way. So we do not propagate the dataflow-value of V
+            // but actually set it to the bottom value.
+            SDEBUG("soaap.analysis.infoflow", 4, dbgs() << INDENT_4 << "Binary operator, propagating bottom to " << *I << "\n");
+            state.set(C, I, bottomValue());
+            addToWorklist(I, C, worklist);
+            continue;
+          }
+          else if (PHINode* PHI = dyn_cast<PHINode>(I)) {
+            // take the meet of all incoming values
+            if (mustAnalysis) {
+              FactId meet = FactInterner<FactType,Lattice>::DefaultId;
+              bool first = true;
+              for (int i=0; i<PHI->getNumIncomingValues(); i++) {
+                Value* IV = PHI->getIncomingValue(i);
+                if (first) {
+                  meet = state.lookupId(C, IV);
+                  first = false;
                 }
-                if (propagateToValue(meet, PHI, C, M)) {
-                  addToWorklist(PHI, C, worklist);
+                else {
+                  meet = state.meetIds(meet, state.lookupId(C, IV));
                 }
               }
-              else {
-                V2 = PHI;
+              if (updateFact(meet, PHI, C)) {
+                addToWorklist(PHI, C, worklist);
               }
             }
-            else if (SelectInst* SI = dyn_cast<SelectInst>(I)) {
-              if (mustAnalysis) {
-                Value* SV1 = SI->getTrueValue();
-                Value* SV2 = SI->getFalseValue();
-                FactType meet = state[C][SV1];
-                performMeet(state[C][SV2], meet);
-                if (propagateToValue(meet, SI, C, M)) {
-                  addToWorklist(SI, C, worklist);
-                }
-              }
-              else {
-                V2 = SI;
+            else {
+              V2 = PHI;
+            }
+          }
+          else if (SelectInst* SI = dyn_cast<SelectInst>(I)) {
+            if (mustAnalysis) {
+              Value* SV1 = SI->getTrueValue();
+              Value* SV2 = SI->getFalseValue();
+              FactId meet = state.meetIds(state.lookupId(C, SV1), state.lookupId(C, SV2));
+              if (updateFact(meet, SI, C)) {
+                addToWorklist(SI, C, worklist);
               }
             }
             else {
-              //debugs() << "Unaccounted-for instruction: " << *I << "\n";
-              V2 = I; // this covers gep instructions
+              V2 = SI;
             }
-            if (V2 != NULL) {
-              SDEBUG("soaap.analysis.infoflow", 4, dbgs() << "V2: " << *V2 << "\n");
+          }
+          else {
+            //debugs() << "Unaccounted-for instruction: " << *I << "\n";
+            V2 = I; // this covers gep instructions
+          }
+          if (V2 != NULL) {
+            SDEBUG("soaap.analysis.infoflow", 4, dbgs() << "V2: " << *V2 << "\n");
+          }
+          if (V2 != NULL && propagateToValue(V, V2, C, C, M, false)) { // propagate taint from (V,C) to (V2,C)
+            SDEBUG("soaap.analysis.infoflow", 3,
+                  dbgs() << INDENT_4 << "Propagating (" << stringifyValue(V)
+                     << ", " << ContextUtils::stringifyContext(C) << ") to (" << stringifyValue(V2)
+                     << ", " << ContextUtils::stringifyContext(C) << ")\n");
+            addToWorklist(V2, C, worklist);
+
+            // special case for GEP (propagate to the aggregate, if we stored to it)
+            if (isa<StoreInst>(U) && isa<GetElementPtrInst>(V2)) {
+              SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_2 << "storing to GEP\n");
+              // propagate to the aggregate
+              propagateToAggregate(V2, C, V2, worklist, sandboxes, M);
             }
-            if (V2 != NULL && propagateToValue(V, V2, C, C, M, false)) { // propagate taint from (V,C) to (V2,C)
-              SDEBUG("soaap.analysis.infoflow", 3,
-                    dbgs() << INDENT_4 << "Propagating (" << stringifyValue(V)
-                       << ", " << ContextUtils::stringifyContext(C) << ") to (" << stringifyValue(V2)
-                       << ", " << ContextUtils::stringifyContext(C) << ")\n");
-              addToWorklist(V2, C, worklist);
-
-              // special case for GEP (propagate to the aggregate, if we stored to it)
-              if (isa<StoreInst>(U) && isa<GetElementPtrInst>(V2)) {
-                SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_2 << "storing to GEP\n");
-                // rewind to the aggregate and propagate
-                ValueSet visited;
-                propagateToAggregate(V2, C, (Value*)V2, visited, worklist, sandboxes, M);
-              }
-              else if (CallInst* CI = dyn_cast<CallInst>(I)) {
-                if (CallGraphUtils::isExternCall(CI) && V2 != CI) {
-                  // propagating to one of the args, and not the return value. we propagate back
-                  // as much as possible
-                  ValueSet visited;
-                  propagateToAggregate(V2, C, (Value*)V2, visited, worklist, sandboxes, M);
-                }
+            else if (CallInst* CI = dyn_cast<CallInst>(I)) {
+              if (CallGraphUtils::isExternCall(CI) && V2 != CI) {
+                // propagating to one of the args, and not the return value. we propagate back
+                // to the objects it points into
+                propagateToAggregate(V2, C, V2, worklist, sandboxes, M);
               }
             }
           }
         }
       }
     }
-
-    // unmerge contexts if this is a context-insensitive analysis
-    if (contextInsensitive) {
-      SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_1 << "Unmerging contexts\n");
-      ContextVector Cs = ContextUtils::getAllContexts(sandboxes);
-      DataflowFacts F = state[ContextUtils::SINGLE_CONTEXT];
-      for (typename DataflowFacts::iterator I=F.begin(), E=F.end(); I != E; I++) {
-        const Value* V = I->first;
-        FactType T = I->second;
-        for (Context* C : Cs) {
-          state[C][V] = T;
-        }
-      }
-    }
-
   }
 
-  template<typename FactType>
-  void InfoFlowAnalysis<FactType>::propagateToAggregate(const Value* V, Context* C, Value* Agg, ValueSet& visited, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M) {
-    SDEBUG("soaap.analysis.infoflow", 4, dbgs() << "Agg: " << *Agg << "\n");
-    Agg = Agg->stripInBoundsOffsets();
-    if (visited.count(Agg) == 0) {
-      visited.insert(Agg);
-      if (isa<AllocaInst>(Agg) || isa<GlobalVariable>(Agg) || isa<Argument>(Agg)) {
-        if (propagateToValue(V, Agg, C, C, M, true)) { 
-          SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_3 << "propagating to aggregate\n");
-          addToWorklist(Agg, C, worklist);
-        }
-        // are we propagating to a "this" pointer?
-        if (AllocaInst* AI = dyn_cast<AllocaInst>(Agg)) {
-          SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_3 << "alloca inst\n");
-          if (PointerType* PT = dyn_cast<PointerType>(AI->getAllocatedType())) {
-            if (StructType* ST = dyn_cast<StructType>(PT->getElementType())) {
-              if (ST->getName().startswith("class.")) {
-                SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_3 << "class type: " << ST->getName() << "\n");
-                // this is an object allocation, treat as "this" pointer
-                // propagate to all other "this" pointers of this type
-                for (Argument* A : classToThisParams[ST]) {
-                  Function* F = A->getParent();
-                  ContextVector Cs = ContextUtils::getContextsForMethod(F, contextInsensitive, sandboxes, M);
-                  for (Context* C2 : Cs) {
-                    if (propagateToValue(V, A, C, C2, M, true)) { 
-                      SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_3 << "propagating to this arg in " << F->getName() << "\n");
-                      addToWorklist(A, C2, worklist);
-                    }
-                  }
-                }
-              }
-            }
-          }
-        }
+  template <typename FactType, typename Lattice>
+  void InfoFlowAnalysis<FactType,Lattice>::propagateToAggregate(const Value* V, Context* C, const Value* Ptr, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M) {
+    // propagate to the locations owning the object that Ptr points into.
+    // Those in other functions are only propagated to in C, and only if
+    // their function can call enclosingFunc in C (i.e. they belong to a
+    // transitive caller). The exception is "this" params of other methods,
+    // which share the object across all of their method's contexts.
+    Function* enclosingFunc = NULL;
+    if (const Instruction* I = dyn_cast<Instruction>(V)) {
+      enclosingFunc = (Function*)I->getParent()->getParent();
+    }
+    else if (const Argument* A = dyn_cast<Argument>(V)) {
+      enclosingFunc = (Function*)A->getParent();
+    }
+    for (const Value* Agg : aliases.getAggregates(Ptr)) {
+      Function* aggFunc = NULL;
+      if (const Instruction* I = dyn_cast<Instruction>(Agg)) {
+        aggFunc = (Function*)I->getParent()->getParent();
       }
-      else {
-        if (GetElementPtrInst* gep = dyn_cast<GetElementPtrInst>(Agg)) {
-          propagateToAggregate(V, C, gep->getPointerOperand(), visited, worklist, sandboxes, M);
-        }
-        else if (LoadInst* load = dyn_cast<LoadInst>(Agg)) {
-          propagateToAggregate(V, C, load->getPointerOperand(), visited, worklist, sandboxes, M);
-        }
-        else if (IntrinsicInst* intrins = dyn_cast<IntrinsicInst>(Agg)) {
-          if (intrins->getIntrinsicID() == Intrinsic::ptr_annotation) { // covers llvm.ptr.annotation.p0i8
-            propagateToAggregate(V, C, intrins->getArgOperand(0), visited, worklist, sandboxes, M);
-          }
-          else {
-            SDEBUG("soaap.analysis.infoflow", 4, dbgs() << "WARNING: unexpected intrinsic instruction: " << *Agg << "\n");
-          }
-        }
-        else if (CallInst* call = dyn_cast<CallInst>(Agg)) {
-          // in this case, we need to rewind back to the local/global Value*
-          // that flows to the return value of call's callee. This would
-          // involve doing more information flow analysis. However, for now
-          // we hardcode the specific cases:
-          //TODO: replace!
-          if (Function* F = call->getCalledFunction()) {
-            if (F->getName() == "buffer_ptr") {
-              propagateToAggregate(V, C, call->getArgOperand(0), visited, worklist, sandboxes, M);
-            }
-          }
-          else {
-            SDEBUG("soaap.analysis.infoflow", 4, dbgs() << "WARNING: unexpected call instruction: " << *Agg << "\n");
-          }
-        }
-        else if (SelectInst* select = dyn_cast<SelectInst>(Agg)) {
-          propagateToAggregate(V, C, select->getTrueValue(), visited, worklist, sandboxes, M);
-          propagateToAggregate(V, C, select->getFalseValue(), visited, worklist, sandboxes, M);
-        }
-        else if (PHINode* phi = dyn_cast<PHINode>(Agg)) {
-          for (int i=0; i<phi->getNumIncomingValues(); i++) {
-            propagateToAggregate(V, C, phi->getIncomingValue(i), visited, worklist, sandboxes, M);
-          }
-        }
-        else {
-          SDEBUG("soaap.analysis.infoflow", 4,
-                dbgs() << "WARNING: unexpected value: " << *Agg << "\n"
-                       << "Value type: " << Agg->getValueID() << "\n");
-        }
-        // propagate to this Value*
-        if (propagateToValue(V, Agg, C, C, M, true)) { 
-          addToWorklist(Agg, C, worklist);
-        }
+      else if (const Argument* A = dyn_cast<Argument>(Agg)) {
+        aggFunc = (Function*)A->getParent();
       }
-      
-      // if Agg is a struct parameter, then it probably outlives this function and
-      // so we should propagate the targets of function pointers it contains to the 
-      // calling context (i.e. to the corresponding caller's arg value)
-      //TODO: how do we know A is specifically a struct parameter?
-      Argument* A = dyn_cast<Argument>(Agg);
-      Function* enclosingFunc = (A == NULL) ? NULL : A->getParent();
-      if (A == NULL) { // if Agg is an AllocaInst then obtain the corresponding 
-        if (AllocaInst* AI = dyn_cast<AllocaInst>(Agg)) {
-          if (DbgDeclareInst* dbgDecl = FindAllocaDbgDeclare(AI)) {
-            enclosingFunc = AI->getParent()->getParent();
-            DILocalVariable* varDbg = dbgDecl->getVariable();
-            int argNum = varDbg->getArg(); // arg nums start from 1
-            if (argNum > 0) {
-              // Agg is a param 
-              string argName = varDbg->getName().str();
-              for (Argument &arg : enclosingFunc->args()) {
-                if (arg.getName().str() == argName) {
-                  A = &arg;
-                  break;
-                }
-              }
-            }
-          }
+      if (AliasClasses::isClassThisParam(Agg) && aggFunc != enclosingFunc && C != ContextUtils::NO_CONTEXT) {
+        for (Context* C2 : ContextUtils::getContextsForMethod(aggFunc, contextInsensitive, sandboxes, M)) {
+          SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_3 << "propagating to aggregate " << stringifyValue(Agg) << " in " << aggFunc->getName() << "\n");
+          propagateToContext(V, Agg, C, C2, true, EnqueueIfChanged, worklist, sandboxes, M);
         }
+        continue;
       }
-      if (A != NULL) {
-        // we found the param index, propagate back to all caller args
-        int argIdx = A->getArgNo();
-        for (CallInst* caller : CallGraphUtils::getCallers(enclosingFunc, C, M)) {
-          ContextVector callerContexts = ContextUtils::getContextsForInstruction(caller, contextInsensitive, sandboxes, M);
-          Value* arg = caller->getArgOperand(argIdx);
-          Function* callerFunc = caller->getParent()->getParent();
-          //debugs() << "Propagating arg " << *A << " to caller " << callerFunc->getName() << "\n";
-          SDEBUG("soaap.analysis.infoflow", 4, dbgs() << INDENT_2 << "Adding arg " << *arg << " to worklist\n");
-          for (Context* C2 : callerContexts) {
-            //TODO:
-            if (propagateToValue(V, arg, C, C2, M, true)) {
-              addToWorklist(arg, C2, worklist);
-            }
-            propagateToAggregate(arg, C2, arg, visited, worklist, sandboxes, M);
-          }
+      if (C != ContextUtils::NO_CONTEXT && aggFunc != NULL && aggFunc != enclosingFunc) {
+        // the single context's call graph is the context-merged one
+        Context* graphC = C == ContextUtils::SINGLE_CONTEXT ? NULL : C;
+        if (enclosingFunc == NULL || !CallGraphUtils::isReachableFrom(aggFunc, enclosingFunc, graphC, M)) {
+          continue;
         }
       }
+      if (propagateToValue(V, Agg, C, C, M, true)) {
+        SDEBUG("soaap.analysis.infoflow", 3, dbgs() << INDENT_3 << "propagating to aggregate " << stringifyValue(Agg) << "\n");
+        addToWorklist(Agg, C, worklist);
+      }
     }
   }
 
-  template <typename FactType>
-  void InfoFlowAnalysis<FactType>::addToWorklist(const Value* V, Context* C, ValueContextPairList& worklist) {
+  template <typename FactType, typename Lattice>
+  void InfoFlowAnalysis<FactType,Lattice>::addToWorklist(const Value* V, Context* C, ValueContextPairList& worklist) {
+    // While the threads run, they only queue pairs of their own contexts;
+    // initialise() and deferred callbacks queue pairs of any context.
     ValueContextPair P = make_pair(V, C);
-    worklist.enqueue(P);
+    getOwner(C).enqueue(P);
   }
 
-  template <typename FactType>
-  bool InfoFlowAnalysis<FactType>::propagateToValue(const Value* from, const Value* to, Context* cFrom, Context* cTo, Module& M, bool additive) {
+  template <typename FactType, typename Lattice>
+  bool InfoFlowAnalysis<FactType,Lattice>::propagateToValue(const Value* from, const Value* to, Context* cFrom, Context* cTo, Module& M, bool additive) {
+    bool result = mergeFact(state.lookupId(cFrom, from), to, cTo, additive);
+    if (result) {
+      SDEBUG("soaap.analysis.infoflow", 4, dbgs() << INDENT_1
+                                                  << *from << " " << stringifyFact(state.lookupOrDefault(cFrom, from)) << "\n"
+                                                  << INDENT_2 << " -> "
+                                                  << *to << " " << stringifyFact(state.lookupOrDefault(cTo, to)) << "\n");
+    }
+    return result;
+  }
+
+  template <typename FactType, typename Lattice>
+  bool InfoFlowAnalysis<FactType,Lattice>::mergeFact(FactId fromFact, const Value* to, Context* cTo, bool additive) {
 
     bool result = false;
-    FactType toState;
 
-    if (state[cTo].find(to) == state[cTo].end()) {
-      state[cTo][to] = state[cFrom][from];
-      SDEBUG("soaap.analysis.infoflow", 4, dbgs() << "fromVal: " << stringifyFact(state[cFrom][from]) << ", old toVal: [], new toVal: " << stringifyFact(state[cTo][to]) << "\n");
+    // fact storage is stable, so toFact survives inserting to into cTo
+    DataflowFacts& toFacts = state[cTo];
+    FactId* toFact = toFacts.lookup(to);
+
+    if (toFact == NULL) {
+      toFact = &toFacts[to];
+      *toFact = fromFact;
+      SDEBUG("soaap.analysis.infoflow", 4, dbgs() << "fromVal: " << stringifyFact(state.getFact(fromFact)) << ", old toVal: [], new toVal: " << stringifyFact(state.getFact(*toFact)) << "\n");
       result = true; // return true to allow state to propagate through
                    // regardless of whether the value was non-bottom
     }
     else {
-      //FactType old = state[cTo][to];
-      //state[cTo][to] = performMeet(state[cFrom][from], old);
-      toState = state[cTo][to];
-      if (additive) {
-        result = performUnion(state[cFrom][from], state[cTo][to]);
+      FactId newFact = additive ? state.joinIds(*toFact, fromFact) : state.meetIds(*toFact, fromFact);
+      result = newFact != *toFact;
+      *toFact = newFact;
+    }
+    return result;
+  }
+
+  template <typename FactType, typename Lattice>
+  void InfoFlowAnalysis<FactType,Lattice>::propagateToContext(const Value* from, const Value* to, Context* cFrom, Context* cTo, bool additive, FollowUp F, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M) {
+    Partition& P = getPartition(worklist);
+    if (&getOwner(cTo) != &P) {
+      Message msg = { to, cTo, state.lookupId(cFrom, from), additive, F };
+      postMessage(P, cTo, msg);
+      return;
+    }
+    bool changed = propagateToValue(from, to, cFrom, cTo, M, additive);
+    followUp(to, cTo, changed, F, worklist, sandboxes, M);
+  }
+
+  template <typename FactType, typename Lattice>
+  void InfoFlowAnalysis<FactType,Lattice>::followUp(const Value* V, Context* C, bool changed, FollowUp F, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M) {
+    if (F == EnqueueAlways || (changed && F == EnqueueIfChanged)) {
+      addToWorklist(V, C, worklist);
+    }
+    else if (changed && F == SummaryIfChanged) {
+      SDEBUG("soaap.analysis.infoflow", 4, dbgs() << "Adding (V2,C2) to worklist\n"
+                << "state[C2][V2]: " << stringifyFact(state.lookupOrDefault(C, V)) << "\n");
+      if (useSummaries()) {
+        applySummary(V, C, worklist, sandboxes, M);
       }
       else {
-        result = performMeet(state[cFrom][from], state[cTo][to]);
+        addToWorklist(V, C, worklist);
       }
     }
-    if (result) {
-      SDEBUG("soaap.analysis.infoflow", 4, dbgs() << INDENT_1
-                                                  << *from << " " << stringifyFact(state[cFrom][from]) << "\n"
-                                                  << INDENT_2 << " -> "
-                                                  << *to << " " << stringifyFact(toState) << ", " << stringifyFact(state[cTo][to]) << "\n");
-    }
-    return result;
   }
 
-  template <typename FactType>
-  bool InfoFlowAnalysis<FactType>::propagateToValue(FactType fact, const Value* to, Context* C, Module& M) {
-    FactType oldFact = state[C][to];
-    state[C][to] = fact;
-    return !checkEqual(oldFact, fact);
+  template <typename FactType, typename Lattice>
+  bool InfoFlowAnalysis<FactType,Lattice>::propagateToValue(const FactType& fact, const Value* to, Context* C, Module& M) {
+    return updateFact(state.intern(fact), to, C);
+  }
+
+  template <typename FactType, typename Lattice>
+  bool InfoFlowAnalysis<FactType,Lattice>::updateFact(FactId fact, const Value* to, Context* C) {
+    FactId& toFact = state[C][to];
+    if (toFact == fact) {
+      return false;
+    }
+    toFact = fact;
+    return true;
   }
 
-  template <typename FactType>
-  void InfoFlowAnalysis<FactType>::propagateToCallees(CallInst* CI, const Value* V, Context* C, bool propagateAllArgs, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M) {
+  template <typename FactType, typename Lattice>
+  void InfoFlowAnalysis<FactType,Lattice>::propagateToCallees(CallInst* CI, const Value* V, Context* C, bool propagateAllArgs, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M) {
 
     SDEBUG("soaap.analysis.infoflow", 4, dbgs() << "Call instruction: " << *CI << "\n"
               << "Calling-context C: " << ContextUtils::stringifyContext(C) << "\n");
 
-    FunctionSet callees = CallGraphUtils::getCallees(CI, C, M);
+    FunctionRange callees = CallGraphUtils::getCallees(CI, C, M);
     SDEBUG("soaap.analysis.infoflow", 4, dbgs() << INDENT_5 << "callees: " << CallGraphUtils::stringifyFunctionSet(callees) << "\n");
     
     DataflowFacts& contextFacts = state[C];
@@ -529,36 +777,11 @@ namespace soaap {
           Context* C2 = ContextUtils::calleeContext(C, contextInsensitive, callee, sandboxes, M);
           SDEBUG("soaap.analysis.infoflow", 4, dbgs() << INDENT_5 << "Propagating to callee " << callee->getName() << "\n"
                     << INDENT_6 << "Callee-context C2: " << ContextUtils::stringifyContext(C2) << "\n");
-          const Value* V2 = NULL;
-          bool isVarArg = argIdx >= callee->arg_size();
-          
           // Obtain Value* to propagate to.
           // Note: in the case of a var arg, propagate to va_list var
-          if (isVarArg) { // var arg
-            BasicBlock& EntryBB = callee->getEntryBlock();
-            
-            // find va_list var, it will have type [1 x %struct.__va_list_tag]*
-            for (BasicBlock::iterator I = EntryBB.begin(), E = EntryBB.end(); I != E; I++) {
-              if (AllocaInst* Alloca = dyn_cast<AllocaInst>(I)) {
-                if (ArrayType* AT = dyn_cast<ArrayType>(Alloca->getAllocatedType())) {
-                  if (StructType* ST = dyn_cast<StructType>(AT->getElementType())) {
-                    SDEBUG("soaap.analysis.infoflow", 4, dbgs() << "Struct type has name: " << ST->getName() << "\n");
-                    if (ST->getName() == "struct.__va_list_tag") {
-                      V2 = Alloca;
-                      break;
-                    }
-                  }
-                }
-              }
-            }
-          }
-          else {
-            // NOTE: no way to index a function's list of parameters
-            Function::const_arg_iterator AI = callee->arg_begin();
-            int i = 0;
-            while (i++ < argIdx) { AI++; }
-            V2 = AI;
-          }
+          const CallInterface& iface = getPartition(worklist).interfaces.get(callee);
+          const Value* V2 = iface.getParamFor(argIdx);
+          bool isVarArg = argIdx >= iface.params.size();
 
           if (V2 != NULL) {
             SDEBUG("soaap.analysis.infoflow", 4, dbgs() << INDENT_6 << "Propagating to " << stringifyValue(V2));
@@ -566,9 +789,8 @@ namespace soaap {
             // if this is a must analysis, take meet of all argument values
             // passed in at argIdx by all callers in context C. This makes our 
             // analysis sound when our meet operator is intersection
-            bool change = false;
             if (mustAnalysis) {
-              FactType meet;
+              FactId meet = FactInterner<FactType,Lattice>::DefaultId;
               bool first = true;
               // To be sound, we need to take the meet of all values passed in
               // for each parameter that we are propagating to (i.e. from all
@@ -591,36 +813,31 @@ namespace soaap {
                     for (int varArgIdx=callee->arg_size(); varArgIdx<caller->getNumArgOperands(); varArgIdx++) {
                       Value* V3 = caller->getArgOperand(varArgIdx);
                       if (first) {
-                        meet = contextFacts[V3];
+                        meet = contextFacts.lookupOrDefault(V3);
                         first = false;
                       }
                       else {
-                        performMeet(contextFacts[V3], meet);
+                        meet = state.meetIds(meet, contextFacts.lookupOrDefault(V3));
                       }
                     }
                   }
                   else {
                     Value* V3 = caller->getArgOperand(argIdx);
                     if (first) {
-                      meet = contextFacts[V3];
+                      meet = contextFacts.lookupOrDefault(V3);
                       first = false;
                     }
                     else {
-                      performMeet(contextFacts[V3], meet);
+                      meet = state.meetIds(meet, contextFacts.lookupOrDefault(V3));
                     }
                   }
                 //}
               }
               //state[C2][V2] = meet;
-              change = propagateToValue(meet, V2, C2, M);
+              followUp(V2, C2, updateFact(meet, V2, C2), SummaryIfChanged, worklist, sandboxes, M);
             }
             else {
-              change = propagateToValue(V, V2, C, C2, M, false);
-            }
-            if (change) {
-              SDEBUG("soaap.analysis.infoflow", 4, dbgs() << "Adding (V2,C2) to worklist\n"
-                        << "state[C2][V2]: " << stringifyFact(state[C2][V2]) << "\n");
-              addToWorklist(V2, C2, worklist);
+              propagateToContext(V, V2, C, C2, false, SummaryIfChanged, worklist, sandboxes, M);
             }
           }
         }
@@ -631,93 +848,109 @@ namespace soaap {
     }
   }
 
-  template <typename FactType>
-  void InfoFlowAnalysis<FactType>::propagateToCallers(ReturnInst* RI, const Value* V, Context* C, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M) {
+  template <typename FactType, typename Lattice>
+  void InfoFlowAnalysis<FactType,Lattice>::applySummary(const Value* Param, Context* C, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M) {
+    Function* F = isa<Argument>(Param) ? (Function*)cast<Argument>(Param)->getParent()
+                                       : (Function*)cast<Instruction>(Param)->getParent()->getParent();
+    if (C == ContextUtils::NO_CONTEXT || !ContextUtils::isFunctionInContext(F, C, contextInsensitive, sandboxes, M)) {
+      addToWorklist(Param, C, worklist);
+      return;
+    }
+    // facts only grow, so the values of the summary already hold any fact
+    // that the summary has been applied with before
+    Partition& P = getPartition(worklist);
+    FactId in = state.lookupId(C, Param);
+    pair<const Value*,Context*> key = make_pair(Param, C);
+    typename DenseMap<pair<const Value*,Context*>,FactId>::iterator I = P.summaryInputs.find(key);
+    if (I != P.summaryInputs.end() && state.joinIds(I->second, in) == I->second) {
+      P.summaryHits++;
+      return;
+    }
+    P.summaryInputs[key] = in;
+    P.summaryApplications++;
+
+    const FlowSummary& S = P.summaries.get(Param);
+    ValueNumbering& numbering = state.getValueNumbering();
+    DataflowFacts& facts = state[C];
+    // Param itself has already changed
+    if (S.values[0].exit) {
+      addToWorklist(Param, C, worklist);
+    }
+    for (unsigned i=1; i<S.values.size(); i++) {
+      const FlowSummary::Entry& E = S.values[i];
+      FactId* fact = facts.lookup(E.id);
+      bool changed = true;
+      if (fact == NULL) {
+        facts.getOrInsert(E.id) = in;
+      }
+      else {
+        FactId newFact = state.joinIds(*fact, in);
+        changed = newFact != *fact;
+        *fact = newFact;
+      }
+      if (changed && E.exit) {
+        addToWorklist(numbering.getValue(E.id), C, worklist);
+      }
+    }
+    SDEBUG("soaap.analysis.infoflow", 4, dbgs() << INDENT_5 << "Applied summary of " << stringifyValue(Param)
+                                                << " (" << S.values.size() << " values) in "
+                                                << ContextUtils::stringifyContext(C) << "\n");
+  }
+
+  template <typename FactType, typename Lattice>
+  void InfoFlowAnalysis<FactType,Lattice>::propagateToCallers(ReturnInst* RI, const Value* V, Context* C, ValueContextPairList& worklist, SandboxVector& sandboxes, Module& M) {
     Function* F = RI->getParent()->getParent();
     for (CallInst* CI : CallGraphUtils::getCallers(F, C, M)) {
       SDEBUG("soaap.analysis.infoflow", 4, dbgs() << INDENT_5 << "Propagating to caller " << stringifyValue(CI));
-      ContextVector C2s = ContextUtils::callerContexts(RI, CI, C, contextInsensitive, sandboxes, M);
+      const ContextVector& C2s = ContextUtils::callerContexts(RI, CI, C, contextInsensitive, sandboxes, M);
       for (Context* C2 : C2s) {
-        FunctionSet callees = CallGraphUtils::getCallees(CI, C2, M);
+        FunctionRange callees = CallGraphUtils::getCallees(CI, C2, M);
         // if this is a must analysis, then take the meet of all possible return values of all callees
         if (mustAnalysis) {
-          FactType meet;
+          FactId meet = FactInterner<FactType,Lattice>::DefaultId;
           bool first = true;
           for (Function* callee : callees) {
             Context* C3 = ContextUtils::calleeContext(C2, contextInsensitive, callee, sandboxes, M);
-            for (BasicBlock& B : callee->getBasicBlockList()) {
-              if (ReturnInst* RI2 = dyn_cast<ReturnInst>(B.getTerminator())) {
-                Value* V2 = RI2->getReturnValue();
-                if (first) {
-                  meet = state[C3][V2];
-                  first = false;
-                }
-                else {
-                  performMeet(state[C3][V2], meet);
-                }
+            for (const Value* V2 : getPartition(worklist).interfaces.get(callee).returnValues) {
+              if (first) {
+                meet = state.lookupId(C3, V2);
+                first = false;
+              }
+              else {
+                meet = state.meetIds(meet, state.lookupId(C3, V2));
               }
             }
           }
-          if (propagateToValue(meet, CI, C2, M)) {
+          if (updateFact(meet, CI, C2)) {
             addToWorklist(CI, C2, worklist);
           }
         }
         else {
-          if (propagateToValue(V, CI, C, C2, M)) {
-            addToWorklist(CI, C2, worklist);
-          }
+          propagateToContext(V, CI, C, C2, false, EnqueueIfChanged, worklist, sandboxes, M);
         }
       }
     }
   }
 
-  template <typename FactType>
-  Value* InfoFlowAnalysis<FactType>::propagateForExternCall(CallInst* CI, const Value* V) {
+  template <typename FactType, typename Lattice>
+  Value* InfoFlowAnalysis<FactType,Lattice>::propagateForExternCall(CallInst* CI, const Value* V) {
     // propagate dataflow value of relevant arg(s) (if happen to be V) to
-    // the return value of the call CI
+    // the arg or return value given by F's model (see ExternModels.def)
     if (Function* F = CallGraphUtils::getDirectCallee(CI)) {
-      string funcName = F->getName();
-      SDEBUG("soaap.analysis.infoflow", 1, dbgs() << "Extern call, f=" << funcName << "\n");
-      if (funcName == "strdup") {
-        return CI;
-      }
-      else if (funcName == "asprintf" || funcName == "vasprintf") { 
-        // if V is not the format string or the out param, then propagate to out param
-        if (CI->getArgOperand(0) != V && CI->getArgOperand(1) != V) {
-          return CI->getArgOperand(0);
-        }
-      }
-      else if (funcName == "strcpy") {
-        if (CI->getArgOperand(0) != V) { // V is not dst, so it must be src
-          return CI->getArgOperand(0);
-        }
-      }
-      else if (funcName == "g_ptr_array_add") {
-        if (CI->getArgOperand(1) == V) {
-          return CI->getArgOperand(0);
-        }
-      }
-      else if (funcName == "g_hash_table_insert") {
-        if (CI->getArgOperand(2) == V) {
-          SDEBUG("soaap.analysis.infoflow", 4, 
-                dbgs() << "g_hash_table_insert and 2nd arg op\n" << *CI << "\n"
-                  << "fact for V: " << stringifyFact(state[ContextUtils::SINGLE_CONTEXT][V]) << "\n");
-          return CI->getArgOperand(0);
-        }
-      }
-      else if (funcName == "g_hash_table_lookup") {
-        if (CI->getArgOperand(0) == V) {
-          SDEBUG("soaap.analysis.infoflow", 4,
-                dbgs() << "g_hash_table_lookup and first arg op\n"
-                       << "fact for V: " << stringifyFact(state[ContextUtils::SINGLE_CONTEXT][V]) << "\n");
-          return CI;
-        }
+      SDEBUG("soaap.analysis.infoflow", 1, dbgs() << "Extern call, f=" << F->getName() << "\n");
+      if (const ExternModel* model = ExternModels::getModel(F)) {
+        Value* V2 = ExternModels::getFlowTarget(CI, V, *model);
+        SDEBUG("soaap.analysis.infoflow", 4,
+              dbgs() << "fact for V: " << stringifyFact(state.lookupOrDefault(ContextUtils::SINGLE_CONTEXT, V)) << "\n");
+        return V2;
       }
       else {
         static FunctionSet unknownExterns;
+        static mutex unknownExternsMutex;
+        lock_guard<mutex> guard(unknownExternsMutex);
         if (unknownExterns.count(F) == 0) {
           unknownExterns.insert(F);
-          SDEBUG("soaap.analysis.infoflow", 4, dbgs() << "SOAAP ERROR: Propagation has reached unknown extern function call to " << funcName << "\n");
+          SDEBUG("soaap.analysis.infoflow", 4, dbgs() << "SOAAP ERROR: Propagation has reached unknown extern function call to " << F->getName() << "\n");
         }
       }
     }
@@ -725,8 +958,8 @@ namespace soaap {
     return NULL;
   }
 
-  template <typename FactType>
-  string InfoFlowAnalysis<FactType>::stringifyValue(const Value* V) {
+  template <typename FactType, typename Lattice>
+  string InfoFlowAnalysis<FactType,Lattice>::stringifyValue(const Value* V) {
     string result;
     raw_string_ostream ss(result);
     if (isa<Function>(V)) {
@@ -740,16 +973,16 @@ namespace soaap {
   }
 
   // default behaviour is to do nothing
-  template<typename FactType>
-  void InfoFlowAnalysis<FactType>::stateChangedForFunctionPointer(CallInst* CI, const Value* FP, Context* C, FactType& newState) {
+  template <typename FactType, typename Lattice>
+  void InfoFlowAnalysis<FactType,Lattice>::stateChangedForFunctionPointer(CallInst* CI, const Value* FP, Context* C, FactType& newState) {
   }
 
-  template<typename FactType>
-  CallInstSet InfoFlowAnalysis<FactType>::getCallersInContext(Function* callee, Context* C, SandboxVector& sandboxes, Module& M) {
+  template <typename FactType, typename Lattice>
+  CallInstSet InfoFlowAnalysis<FactType,Lattice>::getCallersInContext(Function* callee, Context* C, SandboxVector& sandboxes, Module& M) {
     if (inContextCallers.count(callee) == 0) {
-      CallInstSet callers = CallGraphUtils::getCallers(callee, C, M);
+      CallInstRange callers = CallGraphUtils::getCallers(callee, C, M);
       for (CallInst* call : callers) {
-        ContextVector contexts = ContextUtils::getContextsForInstruction(call, contextInsensitive, sandboxes, M);
+        const ContextVector& contexts = ContextUtils::getContextsForInstruction(call, contextInsensitive, sandboxes, M);
         for (Context* C2 : contexts) {
           inContextCallers[callee][C2].insert(call);
         }
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_ANALYSIS_INFOFLOW_LATTICETRAITS_H
+#define SOAAP_ANALYSIS_INFOFLOW_LATTICETRAITS_H
+
+#include "ADT/BitSetTraits.h"
+#include "ADT/IndexSet.h"
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SparseBitVector.h"
+
+using namespace llvm;
+
+namespace soaap {
+  // Lattice operations used by InfoFlowAnalysis. join and meet merge from
+  // into to in place and return true iff to changed. A fact type is given a
+  // lattice by specialising LatticeTraits; analyses pick one as the second
+  // template argument of InfoFlowAnalysis. getHash must agree with equal, as
+  // facts are interned by it (see FactInterner.h). getMemoryUsage is only
+  // used for statistics.
+  template<class FactType>
+  struct LatticeTraits;
+
+  // bit sets: join is union, meet is intersection
+  template<>
+  struct LatticeTraits<BitVector> {
+    static bool join(const BitVector& from, BitVector& to) {
+      // from.test(to) <-> from has a bit not already in to
+      if (!from.test(to)) {
+        return false;
+      }
+      to |= from;
+      return true;
+    }
+    static bool meet(const BitVector& from, BitVector& to) {
+      if (!to.test(from)) {
+        return false;
+      }
+      to &= from;
+      return true;
+    }
+    static bool equal(const BitVector& f1, const BitVector& f2) { return f1 == f2; }
+    static unsigned getHash(const BitVector& f) { return hash_combine_range(f.set_bits_begin(), f.set_bits_end()); }
+    static size_t getMemoryUsage(const BitVector& f) { return BitSetTraits<BitVector>::getMemoryUsage(f); }
+  };
+
+  // IndexSet reports changes from a single pass over the words
+  template<>
+  struct LatticeTraits<IndexSet> {
+    static bool join(const IndexSet& from, IndexSet& to) { return to.unionWith(from); }
+    static bool meet(const IndexSet& from, IndexSet& to) { return to.intersectWith(from); }
+    static bool equal(const IndexSet& f1, const IndexSet& f2) { return f1 == f2; }
+    static unsigned getHash(const IndexSet& f) { return f.getHash(); }
+    static size_t getMemoryUsage(const IndexSet& f) { return BitSetTraits<IndexSet>::getMemoryUsage(f); }
+  };
+
+  // sparse bit sets: SparseBitVector's |= and &= already report changes
+  template<unsigned ElementSize>
+  struct LatticeTraits<SparseBitVector<ElementSize> > {
+    typedef SparseBitVector<ElementSize> FactType;
+    static bool join(const FactType& from, FactType& to) { return to |= from; }
+    static bool meet(const FactType& from, FactType& to) { return to &= from; }
+    static bool equal(const FactType& f1, const FactType& f2) { return f1 == f2; }
+    static unsigned getHash(const FactType& f) { return hash_combine_range(f.begin(), f.end()); }
+    static size_t getMemoryUsage(const FactType& f) { return BitSetTraits<FactType>::getMemoryUsage(f); }
+  };
+
+  // bit masks: join is bitwise or, meet is bitwise and
+  template<>
+  struct LatticeTraits<int> {
+    static bool join(int from, int& to) {
+      int oldTo = to;
+      to |= from;
+      return to != oldTo;
+    }
+    static bool meet(int from, int& to) {
+      int oldTo = to;
+      to &= from;
+      return to != oldTo;
+    }
+    static bool equal(int f1, int f2) { return f1 == f2; }
+    static unsigned getHash(int f) { return hash_value(f); }
+    static size_t getMemoryUsage(int f) { return sizeof(f); }
+  };
+
+  template<>
+  struct LatticeTraits<bool> {
+    static bool join(bool from, bool& to) {
+      bool oldTo = to;
+      to = to || from;
+      return to != oldTo;
+    }
+    static bool meet(bool from, bool& to) {
+      bool oldTo = to;
+      to = to && from;
+      return to != oldTo;
+    }
+    static bool equal(bool f1, bool f2) { return f1 == f2; }
+    static unsigned getHash(bool f) { return f; }
+    static size_t getMemoryUsage(bool f) { return sizeof(f); }
+  };
+
+  // For may analyses that merge with join at confluence points as well
+  template<class FactType>
+  struct UnionLatticeTraits : public LatticeTraits<FactType> {
+    static bool meet(const FactType& from, FactType& to) { return LatticeTraits<FactType>::join(from, to); }
+  };
+}
+
+#endif
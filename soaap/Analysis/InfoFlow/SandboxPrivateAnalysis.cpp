@@ -56,33 +56,29 @@ void SandboxPrivateAnalysis::initialise(ValueContextPairList& worklist, Module&
 
   declassifierAnalysis.doAnalysis(M, sandboxes);
 
-  int nextFreeIdx = -1;
- 
   for (Sandbox* S : sandboxes) {
     int bitIdx = S->getNameIdx();
-    ValueSet privateData = S->getPrivateData();
+    const ValueSet& privateData = S->getPrivateData();
     for (Value* V : privateData) {
       if (IntrinsicInst* annotateCall = dyn_cast<IntrinsicInst>(V)) {
         if (annotateCall->getIntrinsicID() == Intrinsic::var_annotation) {
           // llvm.var.annotation
           Value* annotatedVar = dyn_cast<Value>(annotateCall->getOperand(0)->stripPointerCasts());
           //varToAnnotateCall[annotatedVar] = annotateCall;
-          bitIdxToSource[++nextFreeIdx] = annotateCall;
-          bitIdxToPrivSandboxIdxs[nextFreeIdx] |= (1 << bitIdx);
-          ContextVector Cs = ContextUtils::getContextsForMethod(annotateCall->getParent()->getParent(), contextInsensitive, sandboxes, M); 
+          IndexSet source = addSource(annotateCall, bitIdx);
+          const ContextVector& Cs = ContextUtils::getContextsForMethod(annotateCall->getParent()->getParent(), contextInsensitive, sandboxes, M); 
           for (Context* C : Cs) {
-            state[C][annotatedVar] |= (1 << nextFreeIdx);
+            state.join(C, annotatedVar, source);
             addToWorklist(annotatedVar, C, worklist);
           }
         }
         else if (annotateCall->getIntrinsicID() == Intrinsic::ptr_annotation) {
           // llvm.ptr.annotation.p0i8
-          bitIdxToSource[++nextFreeIdx] = annotateCall;
-          bitIdxToPrivSandboxIdxs[nextFreeIdx] |= (1 << bitIdx);
-          ContextVector Cs = ContextUtils::getContextsForMethod(annotateCall->getParent()->getParent(), contextInsensitive, sandboxes, M);
+          IndexSet source = addSource(annotateCall, bitIdx);
+          const ContextVector& Cs = ContextUtils::getContextsForMethod(annotateCall->getParent()->getParent(), contextInsensitive, sandboxes, M);
           for (Context* C : Cs) {
             addToWorklist(annotateCall, C, worklist);
-            state[C][annotateCall] |= (1 << nextFreeIdx);
+            state.join(C, annotateCall, source);
           }
         }
       }
@@ -90,12 +86,11 @@ void SandboxPrivateAnalysis::initialise(ValueContextPairList& worklist, Module&
         // find all loads of G and add them as sources
         for (User* U : G->users()) {
           if (LoadInst* L = dyn_cast<LoadInst>(U)) {
-            bitIdxToSource[++nextFreeIdx] = L;
-            bitIdxToPrivSandboxIdxs[nextFreeIdx] |= (1 << bitIdx);
-            ContextVector Cs = ContextUtils::getContextsForMethod(L->getParent()->getParent(), contextInsensitive, sandboxes, M); 
+            IndexSet source = addSource(L, bitIdx);
+            const ContextVector& Cs = ContextUtils::getContextsForMethod(L->getParent()->getParent(), contextInsensitive, sandboxes, M); 
             for (Context* C : Cs) {
-              state[C][G] |= (1 << nextFreeIdx);
-              state[C][L] |= (1 << nextFreeIdx);
+              state.join(C, G, source);
+              state.join(C, L, source);
               addToWorklist(L, C, worklist);
             }
           }
@@ -105,10 +100,20 @@ void SandboxPrivateAnalysis::initialise(ValueContextPairList& worklist, Module&
     }
   }
 
-  if (nextFreeIdx >= 32) {
-    errs() << "WARNING: we have exceeded 32 sandbox-private sources, number of sources is " << nextFreeIdx << "\n";
-  }
+  SDEBUG("soaap.analysis.infoflow.private", 3, dbgs() << INDENT_1 << "Sandbox-private sources: " << bitIdxToSource.size() << "\n");
+
+}
 
+// Records I as a sandbox-private source of the sandbox with the given name
+// index and returns the fact holding just that source
+IndexSet SandboxPrivateAnalysis::addSource(Instruction* I, int sandboxNameIdx) {
+  unsigned idx = bitIdxToSource.size();
+  bitIdxToSource.push_back(I);
+  bitIdxToPrivSandboxIdxs.push_back(SandboxSet());
+  bitIdxToPrivSandboxIdxs.back().set(sandboxNameIdx);
+  IndexSet source;
+  source.set(idx);
+  return source;
 }
 
 void SandboxPrivateAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sandboxes) {
@@ -124,11 +129,11 @@ void SandboxPrivateAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sand
           LoadInst* load2 = dyn_cast<LoadInst>(&I);
           if (LoadInst* load = dyn_cast<LoadInst>(&I)) {
             Value* v = load->getPointerOperand()->stripPointerCasts();
-            int privSandboxIdxs = convertStateToBitIdxs(state[ContextUtils::PRIV_CONTEXT][v]);
+            SandboxSet privSandboxIdxs = convertStateToBitIdxs(state.lookupOrDefault(ContextUtils::PRIV_CONTEXT, v));
             SDEBUG("soaap.analysis.infoflow.private", 3, dbgs() << "      Value:\n");
             SDEBUG("soaap.analysis.infoflow.private", 3, v->dump());
             SDEBUG("soaap.analysis.infoflow.private", 3, dbgs() << "      Value names: " << SandboxUtils::stringifySandboxNames(privSandboxIdxs) << "\n");
-            if (privSandboxIdxs != 0 and keepAccess()) {
+            if (!privSandboxIdxs.empty() and keepAccess()) {
               XO::Instance privateAccessInstance(privateAccessList);
               XO::emit(" *** Privileged method \"{:function/%s}\" read data "
                        "value belonging to sandboxes: {d:sandboxes_private/%s}\n",
@@ -155,8 +160,8 @@ void SandboxPrivateAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sand
 
   // check sandboxes
   for (Sandbox* S : sandboxes) {
-    FunctionVector sandboxedFuncs = S->getFunctions();
-    int name = 1 << S->getNameIdx();
+    FunctionRange sandboxedFuncs = S->getFunctions();
+    const SandboxSet& name = S->getNameSet();
     for (Function* F : sandboxedFuncs) {
       if (shouldOutputWarningFor(F)) {
         SDEBUG("soaap.analysis.infoflow.private", 3, dbgs() << INDENT_1 << "Function: " << F->getName() << "\n");
@@ -166,10 +171,10 @@ void SandboxPrivateAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sand
             LoadInst* load2 = dyn_cast<LoadInst>(&I);
             if (LoadInst* load = dyn_cast<LoadInst>(&I)) {
               Value* v = load->getPointerOperand()->stripPointerCasts();
-              int privSandboxIdxs = convertStateToBitIdxs(state[S][v]);
+              SandboxSet privSandboxIdxs = convertStateToBitIdxs(state.lookupOrDefault(S, v));
               SDEBUG("soaap.analysis.infoflow.private", 3, dbgs() << INDENT_3 << "Value: "; v->dump(););
               SDEBUG("soaap.analysis.infoflow.private", 3, dbgs() << INDENT_3 << "Private to sandboxes: " << SandboxUtils::stringifySandboxNames(privSandboxIdxs) << "\n");
-              if (((privSandboxIdxs & ~name) != 0) && keepAccess()) {
+              if (!privSandboxIdxs.isSubsetOf(name) && keepAccess()) {
                 XO::Instance privateAccessInstance(privateAccessList);
                 XO::emit(" *** Sandboxed method \"{:function/%s}\" read data "
                          "value belonging to sandboxes: {d:sandboxes_private/%s} "
@@ -216,9 +221,9 @@ void SandboxPrivateAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sand
   //   7) Return from the sandbox entrypoint.
   XO::List privateLeakList("private_leak");
   for (Sandbox* S : sandboxes) {
-    FunctionVector sandboxedFuncs = S->getFunctions();
-    FunctionVector callgates = S->getCallgates();
-    int name = 1 << S->getNameIdx();
+    FunctionRange sandboxedFuncs = S->getFunctions();
+    FunctionRange callgates = S->getCallgates();
+    const SandboxSet& name = S->getNameSet();
     for (Function* F : sandboxedFuncs) {
       if (shouldOutputWarningFor(F)) {
         SDEBUG("soaap.analysis.infoflow.private", 3, dbgs() << INDENT_1 << "Function: " << F->getName());
@@ -233,7 +238,7 @@ void SandboxPrivateAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sand
               if (GlobalVariable* gv = dyn_cast<GlobalVariable>(lhs)) {
                 Value* rhs = store->getValueOperand();
                 // if the rhs is private to the current sandbox, then flag an error
-                if (convertStateToBitIdxs(state[S][rhs]) & name) {
+                if (convertStateToBitIdxs(state.lookupOrDefault(S, rhs)).intersects(name)) {
                   XO::Instance privateLeakInstance(privateLeakList);
                   XO::emit("{e:type/%s}", "global_var");
                   XO::emit(" *** Sandboxed method \"{:function/%s}\" executing "
@@ -264,7 +269,7 @@ void SandboxPrivateAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sand
                 if (Callee->isIntrinsic()) continue;
                 if (Callee->getName() == "setenv") {
                   Value* arg = call->getArgOperand(1);
-                  if (convertStateToBitIdxs(state[S][arg]) & name) {
+                  if (convertStateToBitIdxs(state.lookupOrDefault(S, arg)).intersects(name)) {
                     XO::Instance privateLeakInstance(privateLeakList);
                     XO::emit("{e:type/%s}", "env_var");
                     XO::emit(" *** Sandboxed method \"{:function}\" executing "
@@ -297,7 +302,7 @@ void SandboxPrivateAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sand
                   SDEBUG("soaap.analysis.infoflow.private", 3, dbgs() << "Extern callee: " << Callee->getName() << "\n");
                   for (User::op_iterator AI=call->op_begin(), AE=call->op_end(); AI!=AE; AI++) {
                     Value* arg = dyn_cast<Value>(AI->get());
-                    if (convertStateToBitIdxs(state[S][arg]) & name) {
+                    if (convertStateToBitIdxs(state.lookupOrDefault(S, arg)).intersects(name)) {
                       XO::Instance privateLeakInstance(privateLeakList);
                       XO::emit("{e:type/%s}", "extern");
                       XO::emit(" *** Sandboxed method \"{:function}\" executing "
@@ -325,7 +330,7 @@ void SandboxPrivateAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sand
                   // cross-domain call to callgate
                   for (User::op_iterator AI=call->op_begin(), AE=call->op_end(); AI!=AE; AI++) {
                     Value* arg = dyn_cast<Value>(AI->get());
-                    if (convertStateToBitIdxs(state[S][arg]) & name) {
+                    if (convertStateToBitIdxs(state.lookupOrDefault(S, arg)).intersects(name)) {
                       XO::Instance privateLeakInstance(privateLeakList);
                       XO::emit("{e:type/%s}", "callgate");
                       XO::emit(" *** Sandboxed method \"{:function}\" executing "
@@ -350,7 +355,7 @@ void SandboxPrivateAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sand
                     Value* privateArg = nullptr;
                     for (int i=0; i<call->getNumArgOperands(); i++) {
                       Value* arg = call->getArgOperand(i);
-                      if (convertStateToBitIdxs(state[S][arg]) & name) {
+                      if (convertStateToBitIdxs(state.lookupOrDefault(S, arg)).intersects(name)) {
                         privateArg = arg;
                         break;
                       }
@@ -387,7 +392,7 @@ void SandboxPrivateAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sand
               // we are returning from the sandbox entrypoint function
               if (S->isEntryPoint(F)) {
                 if (Value* retVal = ret->getReturnValue()) {
-                  if (convertStateToBitIdxs(state[S][retVal]) & name) {
+                  if (convertStateToBitIdxs(state.lookupOrDefault(S, retVal)).intersects(name)) {
                     XO::Instance privateLeakInstance(privateLeakList);
                     XO::emit("{e:type/%s}", "return_from_entrypoint");
                     XO::emit(" *** Sandbox \"{:sandbox/%s}\" "
@@ -414,77 +419,52 @@ void SandboxPrivateAnalysis::postDataFlowAnalysis(Module& M, SandboxVector& sand
 
 bool SandboxPrivateAnalysis::propagateToValue(const Value* from, const Value* to, Context* cFrom, Context* cTo, Module& M) {
   if (!declassifierAnalysis.isDeclassified(from)) {
-    return InfoFlowAnalysis<int>::propagateToValue(from, to, cFrom, cTo, M);
+    return InfoFlowAnalysis<IndexSet,UnionLatticeTraits<IndexSet> >::propagateToValue(from, to, cFrom, cTo, M);
   }
   return false;
 }
 
-bool SandboxPrivateAnalysis::performMeet(int from, int& to) {
-  return performUnion(from, to);
+string SandboxPrivateAnalysis::stringifyFact(const IndexSet& fact) {
+  return SandboxUtils::stringifySandboxNames(convertStateToBitIdxs(fact));
 }
 
-bool SandboxPrivateAnalysis::performUnion(int from, int& to) {
-  int oldTo = to;
-  to = from | to;
-  return to != oldTo;
-}
-
-string SandboxPrivateAnalysis::stringifyFact(int fact) {
-  int privSandboxIdxs = 0;
-  int currIdx = 0;
-  for (currIdx=0; currIdx<=31; currIdx++) {
-    if (fact & (1 << currIdx)) {
-      privSandboxIdxs |= bitIdxToPrivSandboxIdxs[currIdx];
-    }
-  }
-  return SandboxUtils::stringifySandboxNames(privSandboxIdxs);
-}
-
-bool SandboxPrivateAnalysis::checkEqual(int f1, int f2) {
-  return f1 == f2;
-}
-
-int SandboxPrivateAnalysis::convertStateToBitIdxs(int& vs) {
-  int privSandboxIdxs = 0;
-  int currIdx = 0;
-  for (currIdx=0; currIdx<=31; currIdx++) {
-    if (vs & (1 << currIdx)) {
-      privSandboxIdxs |= bitIdxToPrivSandboxIdxs[currIdx];
-    }
+SandboxSet SandboxPrivateAnalysis::convertStateToBitIdxs(const IndexSet& vs) {
+  SandboxSet privSandboxIdxs;
+  for (unsigned idx : vs) {
+    privSandboxIdxs |= bitIdxToPrivSandboxIdxs[idx];
   }
   return privSandboxIdxs;
 }
 
 void SandboxPrivateAnalysis::outputSources(Context* C, Value* V, Function* F) {
   XO::List sourcesList("sources");
-  int currIdx = 0;
-  for (currIdx=0; currIdx<=31; currIdx++) {
-    if ((state[C][V] & (1 << currIdx)) != 0) {
-      XO::Instance sourcesInstance(sourcesList);
-      Instruction* I = bitIdxToSource[currIdx];
-      Function* sourceFunc = I->getParent()->getParent();
-      PrettyPrinters::ppInstruction(I, false);
-      // output trace from source to access
-      if (funcToShortestCallPaths.find(sourceFunc) == funcToShortestCallPaths.end()) {
-        calculateShortestCallPathsFromFunc(sourceFunc, C, (1 << currIdx));
-      }
-      InstTrace& callStack = funcToShortestCallPaths[sourceFunc][F];
-      CallGraphUtils::emitCallTrace(callStack);
+  for (unsigned idx : state.lookupOrDefault(C, V)) {
+    XO::Instance sourcesInstance(sourcesList);
+    Instruction* I = bitIdxToSource[idx];
+    Function* sourceFunc = I->getParent()->getParent();
+    PrettyPrinters::ppInstruction(I, false);
+    // output trace from source to access
+    if (funcToShortestCallPaths.find(sourceFunc) == funcToShortestCallPaths.end()) {
+      IndexSet taint;
+      taint.set(idx);
+      calculateShortestCallPathsFromFunc(sourceFunc, C, taint);
     }
+    InstTrace& callStack = funcToShortestCallPaths[sourceFunc][F];
+    CallGraphUtils::emitCallTrace(callStack);
   }
 }
 
-bool SandboxPrivateAnalysis::doesCallPropagateTaint(CallInst* C, int taint, Context* Ctx) {
+bool SandboxPrivateAnalysis::doesCallPropagateTaint(CallInst* C, const IndexSet& taint, Context* Ctx) {
   for (int argIdx=0; argIdx<C->getNumArgOperands(); argIdx++) {
     Value* arg = C->getArgOperand(argIdx);
-    if ((state[Ctx][arg] & taint) != 0) {
+    if (state.lookupOrDefault(Ctx, arg).intersects(taint)) {
       return true;
     }
   }
   return false;
 }
 
-void SandboxPrivateAnalysis::calculateShortestCallPathsFromFunc(Function* F, Context* Ctx, int taint) {
+void SandboxPrivateAnalysis::calculateShortestCallPathsFromFunc(Function* F, Context* Ctx, const IndexSet& taint) {
   // we use Dijkstra's algorithm
   SDEBUG("soaap.util.callgraph", 3, dbgs() << INDENT_1 << "calculating shortest paths from " << F->getName() << " cache");
 
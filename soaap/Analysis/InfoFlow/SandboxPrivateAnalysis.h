@@ -42,35 +42,36 @@ using namespace llvm;
 
 namespace soaap {
 
-  class SandboxPrivateAnalysis : public InfoFlowAnalysis<int> {
+  // Each sandbox-private source (annotated variable, or load of an annotated
+  // global) is given an index, and facts are the sets of sources whose data
+  // may flow to a value.
+  class SandboxPrivateAnalysis : public InfoFlowAnalysis<IndexSet,UnionLatticeTraits<IndexSet> > {
     public:
-      SandboxPrivateAnalysis(bool contextInsensitive, FunctionSet& privMethods, SandboxVector& sboxes) : InfoFlowAnalysis<int>(contextInsensitive), privilegedMethods(privMethods), sandboxes(sboxes) { }
+      SandboxPrivateAnalysis(bool contextInsensitive, FunctionSet& privMethods, SandboxVector& sboxes) : InfoFlowAnalysis<IndexSet,UnionLatticeTraits<IndexSet> >(contextInsensitive), privilegedMethods(privMethods), sandboxes(sboxes) { }
     
     protected:
       virtual void initialise(ValueContextPairList& worklist, Module& M, SandboxVector& sandboxes);
       virtual void postDataFlowAnalysis(Module& M, SandboxVector& sandboxes);
       virtual bool propagateToValue(const Value* from, const Value* to, Context* cFrom, Context* cTo, Module& M);
-      virtual bool performMeet(int from, int& to);
-      virtual bool performUnion(int from, int& to);
-      virtual int bottomValue() { return int(); }
-      virtual bool checkEqual(int f1, int f2);
-      virtual string stringifyFact(int fact);
+      virtual IndexSet bottomValue() { return IndexSet(); }
+      virtual string stringifyFact(const IndexSet& fact);
 
     private:
       FunctionSet privilegedMethods;
       SandboxVector sandboxes;
       DeclassifierAnalysis declassifierAnalysis;
-      map<int, Instruction*> bitIdxToSource;
-      map<int, int> bitIdxToPrivSandboxIdxs;
+      vector<Instruction*> bitIdxToSource;
+      vector<SandboxSet> bitIdxToPrivSandboxIdxs;
       map<Value*, IntrinsicInst*> varToAnnotateCall;
       map<Function*, map<Function*,InstTrace> > funcToShortestCallPaths;
 
-      int convertStateToBitIdxs(int& vs);
+      IndexSet addSource(Instruction* I, int sandboxNameIdx);
+      SandboxSet convertStateToBitIdxs(const IndexSet& vs);
       void outputSources(Context* C, Value* V, Function* F);
       //InstTrace findPrivilegedPathToFunction(Function* Target, int taint);
       //InstTrace findSandboxedPathToFunction(Function* Target, Sandbox* S, int taint);
-      void calculateShortestCallPathsFromFunc(Function* F, Context* C, int taint);
-      bool doesCallPropagateTaint(CallInst* C, int taint, Context* Ctx);
+      void calculateShortestCallPathsFromFunc(Function* F, Context* C, const IndexSet& taint);
+      bool doesCallPropagateTaint(CallInst* C, const IndexSet& taint, Context* Ctx);
   };
 }
 #endif 
@@ -34,6 +34,7 @@
 #include "Analysis/PrivilegedCallAnalysis.h"
 
 #include "soaap.h"
+#include "Common/AnnotationIndex.h"
 #include "Common/XO.h"
 #include "Common/CmdLineOpts.h"
 #include "Util/CallGraphUtils.h"
@@ -47,26 +48,12 @@ using namespace soaap;
 
 void PrivilegedCallAnalysis::doAnalysis(Module& M, SandboxVector& sandboxes) {
   // first find all methods annotated as being privileged and then check calls within sandboxes
-  if (GlobalVariable* lga = M.getNamedGlobal("llvm.global.annotations")) {
-    ConstantArray* lgaArray = dyn_cast<ConstantArray>(lga->getInitializer()->stripPointerCasts());
-    for (User::op_iterator i=lgaArray->op_begin(), e = lgaArray->op_end(); e!=i; i++) {
-      ConstantStruct* lgaArrayElement = dyn_cast<ConstantStruct>(i->get());
-
-      // get the annotation value first
-      GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(lgaArrayElement->getOperand(1)->stripPointerCasts());
-      ConstantDataArray* annotationStrArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-      StringRef annotationStrArrayCString = annotationStrArray->getAsCString();
-
-      GlobalValue* annotatedVal = dyn_cast<GlobalValue>(lgaArrayElement->getOperand(0)->stripPointerCasts());
-      if (isa<Function>(annotatedVal)) {
-        Function* annotatedFunc = dyn_cast<Function>(annotatedVal);
-        if (annotationStrArrayCString == SOAAP_PRIVILEGED) {
-          outs() << "   Found function: " << annotatedFunc->getName() << "\n";
-          privAnnotFuncs.push_back(annotatedFunc);
-        }
-      }
+  for (const Annotation* A : AnnotationIndex::getAnnotations(SOAAP_PRIVILEGED, M)) {
+    if (A->origin == Annotation::GlobalAnnotation && A->func != NULL && A->payload.empty()) {
+      outs() << "   Found function: " << A->func->getName() << "\n";
+      privAnnotFuncs.push_back(A->func);
     }
-  }          
+  }
 
   // now check calls within sandboxes
   XO::List privilegedCallList("privileged_call");
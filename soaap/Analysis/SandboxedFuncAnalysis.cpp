@@ -34,6 +34,7 @@
 #include "Analysis/SandboxedFuncAnalysis.h"
 
 #include "soaap.h"
+#include "Common/AnnotationIndex.h"
 #include "Common/Debug.h"
 #include "Common/XO.h"
 #include "Util/CallGraphUtils.h"
@@ -45,46 +46,24 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 
-#include <sstream>
-
 using namespace soaap;
 
 void SandboxedFuncAnalysis::doAnalysis(Module& M, SandboxVector& sandboxes) {
   // first find all methods annotated as being sandboxed and then check calls within sandboxes
-  if (GlobalVariable* lga = M.getNamedGlobal("llvm.global.annotations")) {
-    ConstantArray* lgaArray = dyn_cast<ConstantArray>(lga->getInitializer()->stripPointerCasts());
-    for (User::op_iterator i=lgaArray->op_begin(), e = lgaArray->op_end(); e!=i; i++) {
-      ConstantStruct* lgaArrayElement = dyn_cast<ConstantStruct>(i->get());
-
-      // get the annotation value first
-      GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(lgaArrayElement->getOperand(1)->stripPointerCasts());
-      ConstantDataArray* annotationStrArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-      StringRef annotationStrArrayCString = annotationStrArray->getAsCString();
-
-      GlobalValue* annotatedVal = dyn_cast<GlobalValue>(lgaArrayElement->getOperand(0)->stripPointerCasts());
-      if (isa<Function>(annotatedVal)) {
-        Function* annotatedFunc = dyn_cast<Function>(annotatedVal);
-        if (annotationStrArrayCString.startswith(SOAAP_SANDBOXED)) {
-          SandboxVector annotatedSandboxes;
-          string sandboxListCsv = annotationStrArrayCString.substr(strlen(SOAAP_SANDBOXED)+1); //+1 because of _
-          SDEBUG("soaap.analysis.sandboxed", 3, dbgs() << INDENT_1 << "sandboxed annotation " << annotationStrArrayCString << " found: " << annotatedFunc->getName() << ", sandboxList: " << sandboxListCsv << "\n");
-          istringstream ss(sandboxListCsv);
-          string sandbox;
-          while(getline(ss, sandbox, ',')) {
-            // trim leading and trailing spaces and quotes ("")
-            size_t start = sandbox.find_first_not_of(" \"");
-            size_t end = sandbox.find_last_not_of(" \"");
-            sandbox = sandbox.substr(start, end-start+1);
-            SDEBUG("soaap.analysis.sandboxed", 3, dbgs() << INDENT_2 << "Sandbox: " << sandbox << "\n");
-            if (Sandbox* S = SandboxUtils::getSandboxWithName(sandbox, sandboxes)) {
-              SDEBUG("soaap.analysis.sandboxed", 3, dbgs() << INDENT_3 << "Adding sandbox\n");
-              annotatedSandboxes.push_back(S);
-            }
-          }
-
-          funcToSandboxes[annotatedFunc] = annotatedSandboxes;
+  for (const Annotation* A : AnnotationIndex::getAnnotations(SOAAP_SANDBOXED, M)) {
+    if (A->origin == Annotation::GlobalAnnotation && A->func != NULL) {
+      Function* annotatedFunc = A->func;
+      SandboxVector annotatedSandboxes;
+      SDEBUG("soaap.analysis.sandboxed", 3, dbgs() << INDENT_1 << "sandboxed annotation " << A->str << " found: " << annotatedFunc->getName() << ", sandboxList: " << A->payload << "\n");
+      for (const string& sandbox : A->items) {
+        SDEBUG("soaap.analysis.sandboxed", 3, dbgs() << INDENT_2 << "Sandbox: " << sandbox << "\n");
+        if (Sandbox* S = SandboxUtils::getSandboxWithName(sandbox, sandboxes)) {
+          SDEBUG("soaap.analysis.sandboxed", 3, dbgs() << INDENT_3 << "Adding sandbox\n");
+          annotatedSandboxes.push_back(S);
         }
       }
+
+      funcToSandboxes[annotatedFunc] = annotatedSandboxes;
     }
   }
 
@@ -32,6 +32,7 @@
  */
 
 #include "Analysis/VulnerabilityAnalysis.h"
+#include "Common/AnnotationIndex.h"
 #include "Common/CmdLineOpts.h"
 #include "Common/Debug.h"
 #include "Common/XO.h"
@@ -85,31 +86,17 @@ void VulnerabilityAnalysis::findPastVulnerabilityAnnotations(Module& M) {
   }
 
   // Find all annotated functions
-  GlobalVariable* lga = M.getNamedGlobal("llvm.global.annotations");
-  if (lga != NULL) {
-    ConstantArray* lgaArray = dyn_cast<ConstantArray>(lga->getInitializer()->stripPointerCasts());
-    for (User::op_iterator i=lgaArray->op_begin(), e = lgaArray->op_end(); e!=i; i++) {
-      ConstantStruct* lgaArrayElement = dyn_cast<ConstantStruct>(i->get());
-
-      // get the annotation value first
-      GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(lgaArrayElement->getOperand(1)->stripPointerCasts());
-      ConstantDataArray* annotationStrArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-      StringRef annotationStrArrayCString = annotationStrArray->getAsCString();
-
-      GlobalValue* annotatedVal = dyn_cast<GlobalValue>(lgaArrayElement->getOperand(0)->stripPointerCasts());
-      if (isa<Function>(annotatedVal)) {
-        Function* annotatedFunc = dyn_cast<Function>(annotatedVal);
-        if (annotationStrArrayCString.startswith(PAST_VULNERABILITY)) {
-          if (shouldOutputWarningFor(annotatedFunc)) {
-            int status = -4;
-            char* demangled = abi::__cxa_demangle(annotatedFunc->getName().str().c_str(), 0, 0, &status);
-            dbgs() << "   Found annotated function " << (status ? annotatedFunc->getName() : demangled) << "\n";
-            pastVulnAnnotatedFuncs.push_back(annotatedFunc);
-            StringRef CVE = annotationStrArrayCString.substr(strlen(PAST_VULNERABILITY)+1);
-            funcToCVEs[annotatedFunc].insert(CVE);
-            vulnerableFuncs.insert(annotatedFunc);
-          }
-        }
+  for (const Annotation* A : AnnotationIndex::getAnnotations(PAST_VULNERABILITY, M)) {
+    if (A->origin == Annotation::GlobalAnnotation && A->func != NULL) {
+      Function* annotatedFunc = A->func;
+      if (shouldOutputWarningFor(annotatedFunc)) {
+        int status = -4;
+        char* demangled = abi::__cxa_demangle(annotatedFunc->getName().str().c_str(), 0, 0, &status);
+        dbgs() << "   Found annotated function " << (status ? annotatedFunc->getName() : demangled) << "\n";
+        pastVulnAnnotatedFuncs.push_back(annotatedFunc);
+        StringRef CVE = A->payload;
+        funcToCVEs[annotatedFunc].insert(CVE);
+        vulnerableFuncs.insert(annotatedFunc);
       }
     }
   }
@@ -306,7 +293,7 @@ void VulnerabilityAnalysis::checkLeakedRights(Module& M, SandboxVector& sandboxe
           // F may run in a sandbox
           // find out what was passed into the sandbox (shared global variables, file descriptors)
           SDEBUG("soaap.analysis.vulnerability", 3, dbgs() << "Checking leaking of global variables\n");
-          GlobalVariableIntMap varToPerms = S->getGlobalVarPerms();
+          const GlobalVariableIntMap& varToPerms = S->getGlobalVarPerms();
           if (!varToPerms.empty()) {
             XO::List globalList("global");
             XO::emit(" Global variables:\n");
@@ -342,11 +329,11 @@ void VulnerabilityAnalysis::checkLeakedRights(Module& M, SandboxVector& sandboxe
           }
           
           SDEBUG("soaap.analysis.vulnerability", 3, dbgs() << "Checking leaking of capabilities\n");
-          ValueFunctionSetMap caps = S->getCapabilities();
+          const ValueFunctionSetMap& caps = S->getCapabilities();
           if (!caps.empty()) {
             XO::List capRightList("cap_right");
             XO::emit(" File descriptors:\n");
-            for (pair<const Value*,FunctionSet> cap : caps) {
+            for (const pair<const Value* const,FunctionSet>& cap : caps) {
               const Argument* capArg = dyn_cast<const Argument>(cap.first);
               FunctionSet capPerms = cap.second;
               if (!capPerms.empty()) {
@@ -367,7 +354,7 @@ void VulnerabilityAnalysis::checkLeakedRights(Module& M, SandboxVector& sandboxe
           }
 
           SDEBUG("soaap.analysis.vulnerability", 3, dbgs() << "Checking callgates\n");
-          FunctionVector callgates = S->getCallgates();
+          FunctionRange callgates = S->getCallgates();
           if (!callgates.empty()) {
             XO::List callgateList("callgate");
             XO::emit(" Call gates:\n");
@@ -379,7 +366,7 @@ void VulnerabilityAnalysis::checkLeakedRights(Module& M, SandboxVector& sandboxe
           }
 
           SDEBUG("soaap.analysis.vulnerability", 3, outs() << "Checking sandbox-private data\n");
-          ValueSet privateData = S->getPrivateData();
+          const ValueSet& privateData = S->getPrivateData();
           if (!privateData.empty()) {
             XO::List privateList("private");
             XO::emit(" Private data:\n");
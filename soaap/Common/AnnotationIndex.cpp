@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "Common/AnnotationIndex.h"
+#include "Common/Debug.h"
+#include "Util/DebugUtils.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "soaap.h"
+
+using namespace soaap;
+
+Module* AnnotationIndex::indexedModule = NULL;
+deque<Annotation> AnnotationIndex::annotations;
+AnnotationList AnnotationIndex::allAnnotations;
+StringMap<AnnotationList> AnnotationIndex::keywordToAnnotations;
+DenseMap<const Function*,AnnotationList> AnnotationIndex::funcToAnnotations;
+StringMap<AnnotationList> AnnotationIndex::sandboxToAnnotations;
+const AnnotationList AnnotationIndex::emptyList;
+
+static const char* const keywords[] = {
+  SANDBOX_PERSISTENT, SANDBOX_EPHEMERAL, VAR_READ, VAR_WRITE, SOAAP_FD,
+  CLASSIFY, CLEARANCE, SANDBOX_PRIVATE, PAST_VULNERABILITY,
+  SOAAP_EPHEMERAL_SANDBOX_CREATE, SOAAP_EPHEMERAL_SANDBOX_KILL,
+  SOAAP_PERSISTENT_SANDBOX_CREATE, SOAAP_PERSISTENT_SANDBOX_KILL,
+  SOAAP_SANDBOX_REGION_START, SOAAP_SANDBOX_REGION_END, SOAAP_PRIVILEGED,
+  SOAAP_SANDBOXED, SOAAP_FP, SOAAP_DANGEROUS, SOAAP_SYSCALLS,
+  SOAAP_FD_SYSCALLS, SOAAP_FD_KEY_SYSCALLS, SOAAP_FD_GETTER, SOAAP_FD_SETTER
+};
+
+// keywords whose payload is the name of a sandbox
+static const char* const sandboxKeywords[] = {
+  SANDBOX_PERSISTENT, SANDBOX_EPHEMERAL, VAR_READ, VAR_WRITE,
+  SANDBOX_PRIVATE, SOAAP_EPHEMERAL_SANDBOX_CREATE,
+  SOAAP_EPHEMERAL_SANDBOX_KILL, SOAAP_PERSISTENT_SANDBOX_CREATE,
+  SOAAP_PERSISTENT_SANDBOX_KILL, SOAAP_SANDBOX_REGION_START,
+  SOAAP_SANDBOX_REGION_END
+};
+
+// keywords whose payload is a list of system calls
+static const char* const sysCallListKeywords[] = {
+  SOAAP_SYSCALLS, SOAAP_FD, SOAAP_FD_SYSCALLS, SOAAP_FD_KEY_SYSCALLS
+};
+
+template<size_t N>
+static bool isOneOf(StringRef K, const char* const (&Ks)[N]) {
+  for (const char* C : Ks) {
+    if (K == C) {
+      return true;
+    }
+  }
+  return false;
+}
+
+const AnnotationList& AnnotationIndex::getAnnotations(Module& M) {
+  build(M);
+  return allAnnotations;
+}
+
+const AnnotationList& AnnotationIndex::getAnnotations(StringRef keyword, Module& M) {
+  build(M);
+  StringMap<AnnotationList>::const_iterator I = keywordToAnnotations.find(keyword);
+  return I == keywordToAnnotations.end() ? emptyList : I->second;
+}
+
+const AnnotationList& AnnotationIndex::getAnnotationsIn(const Function* F, Module& M) {
+  build(M);
+  DenseMap<const Function*,AnnotationList>::const_iterator I = funcToAnnotations.find(F);
+  return I == funcToAnnotations.end() ? emptyList : I->second;
+}
+
+const AnnotationList& AnnotationIndex::getAnnotationsForSandbox(StringRef name, Module& M) {
+  build(M);
+  StringMap<AnnotationList>::const_iterator I = sandboxToAnnotations.find(name);
+  return I == sandboxToAnnotations.end() ? emptyList : I->second;
+}
+
+void AnnotationIndex::clear() {
+  indexedModule = NULL;
+  annotations.clear();
+  allAnnotations.clear();
+  keywordToAnnotations.clear();
+  funcToAnnotations.clear();
+  sandboxToAnnotations.clear();
+}
+
+void AnnotationIndex::build(Module& M) {
+  if (indexedModule == &M) {
+    return;
+  }
+  clear();
+  indexedModule = &M;
+
+  // intrinsic annotations have the form
+  //   call @llvm.*.annotation(annotated value, annotation string, file, line)
+  const char* const intrinsics[] = {
+    "llvm.ptr.annotation.p0i8", "llvm.var.annotation"
+  };
+  Annotation::Origin intrinsicOrigins[] = {
+    Annotation::PtrAnnotation, Annotation::VarAnnotation
+  };
+  for (int i=0; i<2; i++) {
+    if (Function* F = M.getFunction(intrinsics[i])) {
+      for (User* U : F->users()) {
+        if (IntrinsicInst* annotateCall = dyn_cast<IntrinsicInst>(U)) {
+          addAnnotation(intrinsicOrigins[i], annotateCall->getOperand(0)->stripPointerCasts(), annotateCall->getOperand(1), annotateCall, annotateCall->getParent()->getParent());
+        }
+      }
+    }
+  }
+
+  /*
+   * Annotations on functions and global variables are collected in the
+   * llvm.global.annotations array, each element of which is:
+   *   { annotated value, annotation string, file, line }
+   */
+  if (GlobalVariable* lga = M.getNamedGlobal("llvm.global.annotations")) {
+    ConstantArray* lgaArray = dyn_cast<ConstantArray>(lga->getInitializer()->stripPointerCasts());
+    for (User::op_iterator i=lgaArray->op_begin(), e = lgaArray->op_end(); e!=i; i++) {
+      ConstantStruct* lgaArrayElement = dyn_cast<ConstantStruct>(i->get());
+      Value* annotatedVal = lgaArrayElement->getOperand(0)->stripPointerCasts();
+      addAnnotation(Annotation::GlobalAnnotation, annotatedVal, lgaArrayElement->getOperand(1), NULL, dyn_cast<Function>(annotatedVal));
+    }
+  }
+
+  if (Function* F = M.getFunction("llvm.annotation.i32")) {
+    for (User* U : F->users()) {
+      if (IntrinsicInst* annotateCall = dyn_cast<IntrinsicInst>(U)) {
+        addAnnotation(Annotation::CodeAnnotation, annotateCall->getOperand(0)->stripPointerCasts(), annotateCall->getOperand(1), annotateCall, annotateCall->getParent()->getParent());
+      }
+    }
+  }
+
+  for (const Annotation& A : annotations) {
+    allAnnotations.push_back(&A);
+    if (!A.keyword.empty()) {
+      keywordToAnnotations[A.keyword].push_back(&A);
+    }
+    if (A.func) {
+      funcToAnnotations[A.func].push_back(&A);
+    }
+    if (!A.sandbox.empty()) {
+      sandboxToAnnotations[A.sandbox].push_back(&A);
+    }
+    else if (A.is(SOAAP_SANDBOXED)) {
+      for (const string& S : A.items) {
+        sandboxToAnnotations[S].push_back(&A);
+      }
+    }
+  }
+
+  SDEBUG("soaap.annotations", 3, dbgs() << "Indexed " << annotations.size() << " annotations\n");
+}
+
+void AnnotationIndex::addAnnotation(Annotation::Origin origin, Value* annotated, Value* str, IntrinsicInst* call, Function* func) {
+  GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(str->stripPointerCasts());
+  if (annotationStrVar == NULL || !annotationStrVar->hasInitializer()) {
+    return;
+  }
+  ConstantDataArray* annotationStrArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
+  if (annotationStrArray == NULL) {
+    return;
+  }
+  annotations.push_back(Annotation());
+  Annotation& A = annotations.back();
+  A.origin = origin;
+  A.str = annotationStrArray->getAsCString();
+  A.annotated = annotated;
+  A.call = call;
+  A.func = func;
+  decode(A);
+}
+
+void AnnotationIndex::decode(Annotation& A) {
+  // find the longest keyword that is the whole string or is followed by _
+  for (const char* K : keywords) {
+    StringRef KS(K);
+    if (KS.size() > A.keyword.size() && A.str.startswith(KS)
+        && (A.str.size() == KS.size() || A.str[KS.size()] == '_')) {
+      A.keyword = KS;
+    }
+  }
+  if (A.keyword.empty()) {
+    return;
+  }
+  A.payload = A.str.size() > A.keyword.size() ? A.str.substr(A.keyword.size()+1) : StringRef(); //+1 because of _
+
+  StringRef listCsv;
+  if (isOneOf(A.keyword, sandboxKeywords)) {
+    A.sandbox = A.payload;
+  }
+  else if (A.is(SOAAP_FD) && A.origin == Annotation::PtrAnnotation) {
+    // struct members name the sandbox: "<sandbox>" <syscalls>
+    size_t quotePos = A.payload.find('"');
+    size_t quote2Pos = quotePos == StringRef::npos ? StringRef::npos : A.payload.find('"', quotePos+1);
+    if (quote2Pos != StringRef::npos) {
+      A.sandbox = A.payload.slice(quotePos+1, quote2Pos);
+      listCsv = A.payload.substr(quote2Pos+1);
+    }
+  }
+  else if (isOneOf(A.keyword, sysCallListKeywords) || A.is(SOAAP_SANDBOXED) || A.is(SOAAP_FP)) {
+    listCsv = A.payload;
+  }
+
+  while (!listCsv.empty()) {
+    pair<StringRef,StringRef> split = listCsv.split(',');
+    // trim leading and trailing spaces and quotes ("")
+    StringRef item = split.first.trim(" \"");
+    if (!item.empty()) {
+      A.items.push_back(item.str());
+    }
+    listCsv = split.second;
+  }
+  if (isOneOf(A.keyword, sysCallListKeywords)) {
+    for (const string& item : A.items) {
+      if (item == SOAAP_NO_SYSCALLS_ALLOWED) {
+        // Defensive: ideally no other system calls should have been listed
+        // but we play it safe and remove any that may have been annotated
+        A.items.clear();
+        break;
+      }
+    }
+  }
+}
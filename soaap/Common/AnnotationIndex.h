@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_COMMON_ANNOTATIONINDEX_H
+#define SOAAP_COMMON_ANNOTATIONINDEX_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+using namespace std;
+
+namespace soaap {
+  /*
+   * A SOAAP annotation found in the module, decoded once.
+   *
+   * For example, __soaap_limit_syscalls(read, write) yields a Code
+   * annotation with keyword SOAAP_SYSCALLS, payload "read, write" and
+   * items {"read", "write"}.
+   */
+  class Annotation {
+    public:
+      enum Origin {
+        PtrAnnotation,    // llvm.ptr.annotation (struct fields)
+        VarAnnotation,    // llvm.var.annotation (locals and parameters)
+        GlobalAnnotation, // llvm.global.annotations (functions and globals)
+        CodeAnnotation    // llvm.annotation (__builtin_annotation)
+      };
+
+      Origin origin;
+      StringRef str;      // the whole annotation string
+      StringRef keyword;  // the SOAAP keyword it starts with, if any
+      StringRef payload;  // what follows "<keyword>_"
+      StringRef sandbox;  // the sandbox it names, if any
+      // comma-separated payload items (system calls, sandbox or function
+      // names). System call lists that contain SOAAP_NO_SYSCALLS_ALLOWED
+      // are decoded as empty.
+      vector<string> items;
+      Value* annotated;   // annotated value, with pointer casts stripped
+      IntrinsicInst* call; // annotating call, NULL for global annotations
+      Function* func;     // annotated function, or the one containing call
+
+      bool is(StringRef K) const { return keyword == K; }
+  };
+
+  typedef vector<const Annotation*> AnnotationList;
+
+  /*
+   * Every SOAAP annotation in the module, collected in a single pass over
+   * llvm.global.annotations and the users of the annotation intrinsics.
+   * Annotations are listed in the order ptr, var, global, code and, within
+   * each, in the order the module presents them.
+   */
+  class AnnotationIndex {
+    public:
+      static const AnnotationList& getAnnotations(Module& M);
+      static const AnnotationList& getAnnotations(StringRef keyword, Module& M);
+      // annotations on F, or made by calls within it
+      static const AnnotationList& getAnnotationsIn(const Function* F, Module& M);
+      static const AnnotationList& getAnnotationsForSandbox(StringRef name, Module& M);
+      // drops the index. The index is keyed on the Module's address, so this
+      // must be called before analysing another module (which may have been
+      // allocated where a previous one was).
+      static void clear();
+
+    private:
+      static Module* indexedModule;
+      static deque<Annotation> annotations;
+      static AnnotationList allAnnotations;
+      static StringMap<AnnotationList> keywordToAnnotations;
+      static DenseMap<const Function*,AnnotationList> funcToAnnotations;
+      static StringMap<AnnotationList> sandboxToAnnotations;
+      static const AnnotationList emptyList;
+      static void build(Module& M);
+      static void addAnnotation(Annotation::Origin origin, Value* annotated, Value* str, IntrinsicInst* call, Function* func);
+      static void decode(Annotation& A);
+  };
+}
+
+#endif
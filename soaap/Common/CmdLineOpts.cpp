@@ -67,6 +67,42 @@ static cl::opt<bool, true> ClContextInsens("soaap-context-insens",
        cl::desc("Don't use context-sensitive analysis"),
        cl::location(CmdLineOpts::ContextInsens));
 
+bool CmdLineOpts::InfoFlowFIFOWorklist;
+static cl::opt<bool, true> ClInfoFlowFIFOWorklist("soaap-infoflow-fifo-worklist",
+       cl::cat(CmdLineOpts::SoaapCategory),
+       cl::desc("Process the information-flow worklist in FIFO order rather "
+                "than in def-use SCC order"),
+       cl::location(CmdLineOpts::InfoFlowFIFOWorklist));
+
+bool CmdLineOpts::InfoFlowSparseFacts;
+static cl::opt<bool, true> ClInfoFlowSparseFacts("soaap-infoflow-sparse-facts",
+       cl::cat(CmdLineOpts::SoaapCategory),
+       cl::desc("Represent function-pointer target and fd system-call facts "
+                "as sparse bit sets rather than dense ones"),
+       cl::location(CmdLineOpts::InfoFlowSparseFacts));
+
+bool CmdLineOpts::InfoFlowNoSummaries;
+static cl::opt<bool, true> ClInfoFlowNoSummaries("soaap-infoflow-no-summaries",
+       cl::cat(CmdLineOpts::SoaapCategory),
+       cl::desc("Propagate facts through callee bodies from the worklist "
+                "rather than by applying per-param flow summaries"),
+       cl::location(CmdLineOpts::InfoFlowNoSummaries));
+
+int CmdLineOpts::InfoFlowThreads;
+static cl::opt<int, true> ClInfoFlowThreads("soaap-infoflow-threads",
+       cl::cat(CmdLineOpts::SoaapCategory),
+       cl::desc("Number of threads to solve context-sensitive may analyses "
+                "with, each owning a share of the contexts (1 = sequential)"),
+       cl::location(CmdLineOpts::InfoFlowThreads), cl::init(1));
+
+string CmdLineOpts::ExternModelsFile;
+static cl::opt<string, true> ClExternModelsFile("soaap-extern-models",
+       cl::cat(CmdLineOpts::SoaapCategory),
+       cl::desc("File of additional extern-function propagation models "
+                "(one \"name from -> to\" rule per line)"),
+       cl::value_desc("filename"),
+       cl::location(CmdLineOpts::ExternModelsFile));
+
 bool CmdLineOpts::ListSandboxedFuncs;
 static cl::opt<bool, true> ClListSandboxedFuncs("soaap-list-sandboxed-funcs",
        cl::cat(CmdLineOpts::SoaapCategory),
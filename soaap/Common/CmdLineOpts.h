@@ -63,6 +63,11 @@ namespace soaap {
       static list<string> VulnerableVendors;
       static list<string> VulnerableLibs;
       static bool ContextInsens;
+      static bool InfoFlowFIFOWorklist;
+      static bool InfoFlowSparseFacts;
+      static bool InfoFlowNoSummaries;
+      static int InfoFlowThreads;
+      static string ExternModelsFile;
       static bool ListSandboxedFuncs;
       static bool ListPrivilegedFuncs;
       static bool ListFPCalls;
@@ -31,6 +31,7 @@
  * SUCH DAMAGE.
  */
 
+#include "Common/AnnotationIndex.h"
 #include "Common/Debug.h"
 #include "Common/Sandbox.h"
 #include "Util/CallGraphUtils.h"
@@ -49,16 +50,46 @@
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/Transforms/Utils/Local.h"
 
-#include <sstream>
 
 using namespace soaap;
 
-Sandbox::Sandbox(string n, int i, FunctionSet entries, bool p, Module& m, int o, int c) 
+Sandbox::Sandbox(string n, int i, FunctionSet entries, bool p, Module& m, int o, const ClassSet& c) 
   : Context(CK_SANDBOX), name(n), nameIdx(i), entryPoints(entries), persistent(p), module(m), overhead(o), clearances(c) {
+  nameSet.set(nameIdx);
 }
 
 Sandbox::Sandbox(string n, int i, InstVector& r, bool p, Module& m) 
-  : Context(CK_SANDBOX), name(n), nameIdx(i), region(r), persistent(p), module(m), overhead(0), clearances(0) {
+  : Context(CK_SANDBOX), name(n), nameIdx(i), region(r), persistent(p), module(m), overhead(0) {
+  nameSet.set(nameIdx);
+  buildRegionIndex();
+}
+
+void Sandbox::buildRegionIndex() {
+  // The region is collected one basic block at a time, and each block
+  // contributes a single contiguous run of instructions.
+  InstVector::iterator I = region.begin(), E = region.end();
+  while (I != E) {
+    BasicBlock* BB = (*I)->getParent();
+    Instruction* firstI = *I;
+    Instruction* lastI = *I;
+    unsigned count = 0;
+    for (; I != E && (*I)->getParent() == BB; I++) {
+      lastI = *I;
+      count++;
+    }
+    RegionBlock& RB = regionBlocks[BB];
+    RB.partial = count != BB->size();
+    RB.first = RB.last = 0;
+    if (RB.partial) {
+      unsigned ordinal = 0;
+      for (Instruction& BI : *BB) {
+        partialBlockOrdinals[&BI] = ordinal;
+        if (&BI == firstI) RB.first = ordinal;
+        if (&BI == lastI) RB.last = ordinal;
+        ordinal++;
+      }
+    }
+  }
 }
 
 void Sandbox::init() {
@@ -94,11 +125,60 @@ void Sandbox::reinit() {
   sharedVarToPerms.clear();
   caps.clear();
   privateData.clear();
+  ContextUtils::invalidateContextTables();
 
   init();
 }
 
-FunctionSet Sandbox::getEntryPoints() {
+/*
+ * Extend the sandbox with the call-graph edges C -> callees that were
+ * added in this sandbox's context. Unlike reinit(), only the functions
+ * that become reachable are visited: their calls and syscall-limit
+ * annotations are added to the sandbox. Everything else is derived from
+ * annotations alone and is unaffected by new edges.
+ */
+void Sandbox::addCallees(CallInst* C, FunctionSet& callees) {
+  if (!containsInstruction(C)) {
+    return;
+  }
+  // mirror findSandboxedFunctions: top-level calls of a region skip
+  // declarations, nested calls skip other sandboxes' entrypoints
+  bool topLevel = isInRegion(C);
+  FunctionSet fringe;
+  for (Function* F : callees) {
+    if (functionsSet.count(F) > 0) {
+      continue;
+    }
+    else if (topLevel ? F->isDeclaration() : (SandboxUtils::isSandboxEntryPoint(module, F) && !isEntryPoint(F))) {
+      continue;
+    }
+    fringe.insert(F);
+  }
+  if (fringe.empty()) {
+    return;
+  }
+
+  unsigned firstNew = functionsVec.size();
+  findSandboxedFunctionsHelper(fringe);
+  SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_2 << "Added " << (functionsVec.size() - firstNew) << " functions to sandbox " << name << "\n");
+
+  for (unsigned i=firstNew; i<functionsVec.size(); i++) {
+    Function* F = functionsVec[i];
+    ContextUtils::invalidateContextsFor(F);
+    for (inst_iterator I=inst_begin(F), E=inst_end(F); I!=E; I++) {
+      if (CallInst* CI = dyn_cast<CallInst>(&*I)) {
+        callInsts.push_back(CI);
+      }
+    }
+    for (const Annotation* A : AnnotationIndex::getAnnotationsIn(F, module)) {
+      if (A->origin == Annotation::CodeAnnotation && A->is(SOAAP_SYSCALLS)) {
+        addSysCallLimitPoint(A);
+      }
+    }
+  }
+}
+
+const FunctionSet& Sandbox::getEntryPoints() {
   return entryPoints;
 }
 
@@ -129,31 +209,41 @@ int Sandbox::getNameIdx() {
   return nameIdx;
 }
 
-FunctionVector Sandbox::getFunctions() {
+const SandboxSet& Sandbox::getNameSet() {
+  return nameSet;
+}
+
+FunctionRange Sandbox::getFunctions() {
   return functionsVec;
 }
 
-CallInstVector Sandbox::getTopLevelCalls() {
+CallInstRange Sandbox::getTopLevelCalls() {
   return tlCallInsts;
 }
 
-CallInstVector Sandbox::getCalls() {
+CallInstRange Sandbox::getCalls() {
   return callInsts;
 }
 
-GlobalVariableIntMap Sandbox::getGlobalVarPerms() {
+const GlobalVariableIntMap& Sandbox::getGlobalVarPerms() {
   return sharedVarToPerms;
 }
 
-ValueFunctionSetMap Sandbox::getCapabilities() {
+const ValueFunctionSetMap& Sandbox::getCapabilities() {
   return caps;
 }
 
 bool Sandbox::isAllowedToReadGlobalVar(GlobalVariable* gv) {
-  return sharedVarToPerms.find(gv) != sharedVarToPerms.end() && sharedVarToPerms[gv] & VAR_READ_MASK;
+  GlobalVariableIntMap::const_iterator I = sharedVarToPerms.find(gv);
+  return I != sharedVarToPerms.end() && I->second & VAR_READ_MASK;
 }
 
-FunctionVector Sandbox::getCallgates() {
+bool Sandbox::isAllowedToWriteGlobalVar(GlobalVariable* gv) {
+  GlobalVariableIntMap::const_iterator I = sharedVarToPerms.find(gv);
+  return I != sharedVarToPerms.end() && I->second & VAR_WRITE_MASK;
+}
+
+FunctionRange Sandbox::getCallgates() {
   return callgates;
 }
 
@@ -161,7 +251,7 @@ bool Sandbox::isCallgate(Function* F) {
   return find(callgates.begin(), callgates.end(), F) != callgates.end();
 }
 
-int Sandbox::getClearances() {
+const ClassSet& Sandbox::getClearances() {
   return clearances;
 }
 
@@ -173,16 +263,18 @@ bool Sandbox::isPersistent() {
   return persistent;
 }
 
-CallInstVector Sandbox::getCreationPoints() {
+CallInstRange Sandbox::getCreationPoints() {
   return creationPoints;
 }
 
-CallInstVector Sandbox::getSysCallLimitPoints() {
+CallInstRange Sandbox::getSysCallLimitPoints() {
   return sysCallLimitPoints;
 }
 
-FunctionSet Sandbox::getAllowedSysCalls(CallInst* sysCallLimitPoint) {
-  return sysCallLimitPointToAllowedSysCalls[sysCallLimitPoint];
+const FunctionSet& Sandbox::getAllowedSysCalls(CallInst* sysCallLimitPoint) {
+  static const FunctionSet none;
+  map<CallInst*,FunctionSet>::const_iterator I = sysCallLimitPointToAllowedSysCalls.find(sysCallLimitPoint);
+  return I == sysCallLimitPointToAllowedSysCalls.end() ? none : I->second;
 }
 
 bool Sandbox::containsFunction(Function* F) {
@@ -193,7 +285,7 @@ bool Sandbox::containsInstruction(Instruction* I) {
   if (entryPoints.empty()) {
     // This is a sandboxed region; first search the top-level
     // instructions in it.
-    if (find(region.begin(), region.end(), I) != region.end()) {
+    if (isInRegion(I)) {
       return true;
     }
   }
@@ -202,6 +294,19 @@ bool Sandbox::containsInstruction(Instruction* I) {
   return containsFunction(F);
 }
 
+bool Sandbox::isInRegion(Instruction* I) {
+  DenseMap<const BasicBlock*,RegionBlock>::const_iterator BI = regionBlocks.find(I->getParent());
+  if (BI == regionBlocks.end()) {
+    return false;
+  }
+  const RegionBlock& RB = BI->second;
+  if (!RB.partial) {
+    return true;
+  }
+  DenseMap<const Instruction*,unsigned>::const_iterator OI = partialBlockOrdinals.find(I);
+  return OI != partialBlockOrdinals.end() && OI->second >= RB.first && OI->second <= RB.last;
+}
+
 bool Sandbox::hasCallgate(Function* F) {
   return find(callgates.begin(), callgates.end(), F) != callgates.end();
 }
@@ -309,32 +414,15 @@ void Sandbox::findSharedGlobalVariables() {
    *       i8* getelementptr inbounds ([7 x i8]* @.str1, i32 0, i32 0), // file name
    *       i32 1 }] // line number
    */
-  GlobalVariable* lga = module.getNamedGlobal("llvm.global.annotations");
-  if (lga != NULL) {
-    ConstantArray* lgaArray = dyn_cast<ConstantArray>(lga->getInitializer()->stripPointerCasts());
-    for (User::op_iterator i=lgaArray->op_begin(), e = lgaArray->op_end(); e!=i; i++) {
-      ConstantStruct* lgaArrayElement = dyn_cast<ConstantStruct>(i->get());
-
-      // get the annotation value first
-      GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(lgaArrayElement->getOperand(1)->stripPointerCasts());
-      ConstantDataArray* annotationStrArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-      StringRef annotationStrArrayCString = annotationStrArray->getAsCString();
-
-      GlobalValue* annotatedVal = dyn_cast<GlobalValue>(lgaArrayElement->getOperand(0)->stripPointerCasts());
-      if (isa<GlobalVariable>(annotatedVal)) {
-        GlobalVariable* annotatedVar = dyn_cast<GlobalVariable>(annotatedVal);
-        if (annotationStrArrayCString.startswith(VAR_READ)) {
-          StringRef sandboxName = annotationStrArrayCString.substr(strlen(VAR_READ)+1);
-          if (sandboxName == name) {
-            sharedVarToPerms[annotatedVar] |= VAR_READ_MASK;
-          }
+  for (const Annotation* A : AnnotationIndex::getAnnotationsForSandbox(name, module)) {
+    if (A->origin == Annotation::GlobalAnnotation) {
+      if (GlobalVariable* annotatedVar = dyn_cast<GlobalVariable>(A->annotated)) {
+        if (A->is(VAR_READ)) {
+          sharedVarToPerms[annotatedVar] |= VAR_READ_MASK;
           SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Found annotated global var " << annotatedVar->getName() << "\n");
         }
-        else if (annotationStrArrayCString.startswith(VAR_WRITE)) {
-          StringRef sandboxName = annotationStrArrayCString.substr(strlen(VAR_WRITE)+1);
-          if (sandboxName == name) {
-            sharedVarToPerms[annotatedVar] |= VAR_WRITE_MASK;
-          }
+        else if (A->is(VAR_WRITE)) {
+          sharedVarToPerms[annotatedVar] |= VAR_WRITE_MASK;
           SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Found annotated global var " << annotatedVar->getName() << "\n");
         }
       }
@@ -413,218 +501,123 @@ void Sandbox::findCapabilities() {
    */
    
   for (Function* entryPoint : entryPoints) {
-    for (BasicBlock& BB : entryPoint->getBasicBlockList()) {
-      for (Instruction& I : BB.getInstList()) {
-        if (CallInst* call = dyn_cast<CallInst>(&I)) {
-          if (IntrinsicInst* II = dyn_cast<IntrinsicInst>(call)) {
-            switch (II->getIntrinsicID()) {
-              case Intrinsic::var_annotation: {
-                Value* annotatedVar = dyn_cast<Value>(call->getOperand(0)->stripPointerCasts());
-
-                GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(call->getOperand(1)->stripPointerCasts());
-                ConstantDataArray* annotationStrValArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-                StringRef annotationStrValStr = annotationStrValArray->getAsCString();
-
-                SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Annotation: " << annotationStrValStr << "\n");
-
-                /*
-                 * Find out the enclosing function and record which
-                 * param was annotated. We have to do this because
-                 * llvm creates a local var for the param by appending
-                 * '.addr1' and associates the annotation with the newly
-                 * created local var i.e. see ifd and ifd.addr1 above
-                 */
-                SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Looking for AllocaDbgDeclare\n");
-                if (DbgDeclareInst* dbgDecl = FindAllocaDbgDeclare(annotatedVar)) {
-                  DILocalVariable* varDbg  = dbgDecl->getVariable();
-                  string annotatedVarName = varDbg->getName().str();
-                  SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Found DbgDeclareInst, annotated var: " << annotatedVarName << "\n");
-
-                  // find the annotated parameter
-                  Argument* annotatedArg = NULL;
-                  for (Argument& arg : entryPoint->args()) {
-                    if (arg.getName().str() == annotatedVarName) {
-                      annotatedArg = &arg;
-                    }
-                  }
-
-                  if (annotatedArg != NULL) {
-                    if (annotationStrValStr.startswith(SOAAP_FD)) {
-                      FunctionSet sysCalls;
-                      int subStrStartIdx = strlen(SOAAP_FD) + 1; //+1 because of _
-                      string sysCallListCsv = annotationStrValStr.substr(subStrStartIdx);
-                      SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_1 << " " << annotationStrValStr << " found: " << *annotatedVar << ", sysCallList: " << sysCallListCsv << "\n");
-                      istringstream ss(sysCallListCsv);
-                      string sysCallName;
-                      while(getline(ss, sysCallName, ',')) {
-                        // trim leading and trailing spaces
-                        size_t start = sysCallName.find_first_not_of(" ");
-                        size_t end = sysCallName.find_last_not_of(" ");
-                        sysCallName = sysCallName.substr(start, end-start+1);
-                        SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_2 << "Syscall: " << sysCallName << "\n");
-                        if (sysCallName == SOAAP_NO_SYSCALLS_ALLOWED) {
-                          // Defensive: ideally no other system calls should have been listed
-                          // but we play it safe and remove any that may have been annotated 
-                          sysCalls.clear();
-                          break;
-                        }
-                        if (Function* sysCallFn = module.getFunction(sysCallName)) {
-                          SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Adding " << sysCallFn->getName() << "\n");
-                          sysCalls.insert(sysCallFn);
-                        }
-                      }
-                      caps[annotatedArg] = sysCalls;
-                    }
-                    SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Found annotated file descriptor " << annotatedArg->getName() << "\n");
-                  }
-                }
-                break;
-              }
-              case Intrinsic::ptr_annotation: {
-                // annotation on struct member
-                Value* annotatedVar = dyn_cast<Value>(II->getOperand(0)->stripPointerCasts());
-
-                GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(II->getOperand(1)->stripPointerCasts());
-                ConstantDataArray* annotationStrValArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-                StringRef annotationStrValStr = annotationStrValArray->getAsCString();
-                
-                if (annotationStrValStr.startswith(SOAAP_FD)) {
-                  int subStrStartIdx = strlen(SOAAP_FD) + 1; //+1 because of _
-                  string sandboxNameAndSysCallListCsv = annotationStrValStr.substr(subStrStartIdx);
-                  size_t quotePos = sandboxNameAndSysCallListCsv.find("\"");
-                  if (quotePos != string::npos) {
-                    size_t quote2Pos = sandboxNameAndSysCallListCsv.find("\"", quotePos+1);
-                    if (quote2Pos != string::npos) {
-                      string sandboxName = sandboxNameAndSysCallListCsv.substr(quotePos+1, quote2Pos-(quotePos+1));
-                      if (sandboxName == name) {
-                        outs() << "sandbox name: \"" << sandboxName << "\"\n";
-                        string sysCallListCsv = sandboxNameAndSysCallListCsv.substr(quote2Pos+1);
-                        outs() << "sysCallList: " << sysCallListCsv << "\n";
-                        FunctionSet sysCalls;
-                        SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_1 << " " << annotationStrValStr << " found: " << *annotatedVar << ", sysCallList: " << sysCallListCsv << "\n");
-                        istringstream ss(sysCallListCsv);
-                        string sysCallName;
-                        while(getline(ss, sysCallName, ',')) {
-                          outs() << "syscall: " << sysCallName << "\n";
-                          // trim leading and trailing spaces
-                          size_t start = sysCallName.find_first_not_of(" ");
-                          size_t end = sysCallName.find_last_not_of(" ");
-                          if (start != string::npos && end != string::npos) {
-                            sysCallName = sysCallName.substr(start, end-start+1);
-                            SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_2 << "Syscall: " << sysCallName << "\n");
-                            if (Function* sysCallFn = module.getFunction(sysCallName)) {
-                              SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Adding " << sysCallFn->getName() << "\n");
-                              sysCalls.insert(sysCallFn);
-                            }
-                          }
-                        }
-                        caps[II] = sysCalls;
-                      }
-                    }
-                  }
-                }
-                break;
+    for (const Annotation* A : AnnotationIndex::getAnnotationsIn(entryPoint, module)) {
+      if (!A->is(SOAAP_FD)) {
+        continue;
+      }
+      switch (A->origin) {
+        case Annotation::VarAnnotation: {
+          Value* annotatedVar = A->annotated;
+          SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Annotation: " << A->str << "\n");
+
+          /*
+           * Find out the enclosing function and record which
+           * param was annotated. We have to do this because
+           * llvm creates a local var for the param by appending
+           * '.addr1' and associates the annotation with the newly
+           * created local var i.e. see ifd and ifd.addr1 above
+           */
+          SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Looking for AllocaDbgDeclare\n");
+          if (DbgDeclareInst* dbgDecl = FindAllocaDbgDeclare(annotatedVar)) {
+            DILocalVariable* varDbg  = dbgDecl->getVariable();
+            string annotatedVarName = varDbg->getName().str();
+            SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Found DbgDeclareInst, annotated var: " << annotatedVarName << "\n");
+
+            // find the annotated parameter
+            Argument* annotatedArg = NULL;
+            for (Argument& arg : entryPoint->args()) {
+              if (arg.getName().str() == annotatedVarName) {
+                annotatedArg = &arg;
               }
-              default: { }
             }
+
+            if (annotatedArg != NULL) {
+              SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_1 << " " << A->str << " found: " << *annotatedVar << "\n");
+              caps[annotatedArg] = resolveSysCalls(A->items);
+              SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Found annotated file descriptor " << annotatedArg->getName() << "\n");
+            }
+          }
+          break;
+        }
+        case Annotation::PtrAnnotation: {
+          // annotation on struct member
+          if (A->sandbox == name) {
+            SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_1 << " " << A->str << " found: " << *A->annotated
+                                                    << ", sandbox name: \"" << A->sandbox << "\""
+                                                    << ", sysCallList: " << A->payload << "\n");
+            caps[A->call] = resolveSysCalls(A->items);
           }
+          break;
         }
+        default: { }
       }
     }
   }
 }
 
+// looks up the named system calls, ignoring those the module never calls
+FunctionSet Sandbox::resolveSysCalls(const vector<string>& sysCallNames) {
+  FunctionSet sysCalls;
+  for (const string& sysCallName : sysCallNames) {
+    SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_2 << "Syscall: " << sysCallName << "\n");
+    if (Function* sysCallFn = module.getFunction(sysCallName)) {
+      SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Adding " << sysCallFn->getName() << "\n");
+      sysCalls.insert(sysCallFn);
+    }
+    else {
+      SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Module doesn't call this syscall, so ignoring\n")
+    }
+  }
+  return sysCalls;
+}
+
 void Sandbox::findCreationPoints() {
   // look for calls to __builtin_annotation(SOAAP_PERSISTENT_SANDBOX_CREATE_<NAME_OF_SANDBOX>)
-  if (Function* AnnotFunc = module.getFunction("llvm.annotation.i32")) {
-    for (User* U : AnnotFunc->users()) {
-      if (IntrinsicInst* annotateCall = dyn_cast<IntrinsicInst>(U)) {
-        GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(annotateCall->getOperand(1)->stripPointerCasts());
-        ConstantDataArray* annotationStrValArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-        StringRef annotationStrValCString = annotationStrValArray->getAsCString();
-        
-        if (annotationStrValCString.startswith(SOAAP_PERSISTENT_SANDBOX_CREATE)) {
-          StringRef sandboxName = annotationStrValCString.substr(strlen(SOAAP_PERSISTENT_SANDBOX_CREATE)+1); //+1 because of _
-          if (sandboxName == name) {
-            SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Found persistent creation point: "; annotateCall->dump(););
-            creationPoints.push_back(annotateCall);
-            persistent = true;
-          }
-        }
-        else if (annotationStrValCString.startswith(SOAAP_EPHEMERAL_SANDBOX_CREATE)) {
-          StringRef sandboxName = annotationStrValCString.substr(strlen(SOAAP_EPHEMERAL_SANDBOX_CREATE)+1); //+1 because of _
-          if (sandboxName == name) {
-            SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Found ephemeral creation point: "; annotateCall->dump(););
-            creationPoints.push_back(annotateCall);
-            persistent = false;
-          }
-        }
-      }
+  for (const Annotation* A : AnnotationIndex::getAnnotationsForSandbox(name, module)) {
+    if (A->origin != Annotation::CodeAnnotation) {
+      continue;
+    }
+    if (A->is(SOAAP_PERSISTENT_SANDBOX_CREATE)) {
+      SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Found persistent creation point: "; A->call->dump(););
+      creationPoints.push_back(A->call);
+      persistent = true;
+    }
+    else if (A->is(SOAAP_EPHEMERAL_SANDBOX_CREATE)) {
+      SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Found ephemeral creation point: "; A->call->dump(););
+      creationPoints.push_back(A->call);
+      persistent = false;
     }
   }
 }
 
 void Sandbox::findAllowedSysCalls() {
   // look for calls to __builtin_annotation(SOAAP_SYSCALLS_<LIST OF ALLOWED SYSCALLS>)
-  if (Function* AnnotFunc = module.getFunction("llvm.annotation.i32")) {
-    for (User* U : AnnotFunc->users()) {
-      if (IntrinsicInst* annotateCall = dyn_cast<IntrinsicInst>(U)) {
-        GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(annotateCall->getOperand(1)->stripPointerCasts());
-        ConstantDataArray* annotationStrValArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-        StringRef annotationStrValCString = annotationStrValArray->getAsCString();
-        
-        if (annotationStrValCString.startswith(SOAAP_SYSCALLS)) {
-          // is this annotate call within this sandbox?
-          bool inThisSandbox = false;
-          if (entryPoints.empty()) {
-            // first scan the code region for annotateCall
-            for (Instruction* I : region) {
-              if (I == annotateCall) {
-                inThisSandbox = true;
-                break;
-              }
-            }
-          }
-          if (!inThisSandbox) {
-            // check called functions
-            Function* enclosingFunc = annotateCall->getParent()->getParent();
-            inThisSandbox = functionsSet.count(enclosingFunc) > 0;
-          }
+  for (const Annotation* A : AnnotationIndex::getAnnotations(SOAAP_SYSCALLS, module)) {
+    if (A->origin != Annotation::CodeAnnotation) {
+      continue;
+    }
+    // is this annotate call within this sandbox?
+    bool inThisSandbox = false;
+    if (entryPoints.empty()) {
+      // first scan the code region for annotateCall
+      inThisSandbox = isInRegion(A->call);
+    }
+    if (!inThisSandbox) {
+      // check called functions
+      inThisSandbox = functionsSet.count(A->func) > 0;
+    }
 
-          if (inThisSandbox) {
-            sysCallLimitPoints.push_back(annotateCall);
-            FunctionSet allowedSysCalls;
-            StringRef sysCallsListCsv = annotationStrValCString.substr(strlen(SOAAP_SYSCALLS)+1); //+1 because of _
-            istringstream ss(sysCallsListCsv);
-            string sysCall;
-            while(getline(ss, sysCall, ',')) {
-              // trim leading and trailing spaces
-              size_t start = sysCall.find_first_not_of(" ");
-              size_t end = sysCall.find_last_not_of(" ");
-              sysCall = sysCall.substr(start, end-start+1);
-              SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_2 << "SysCall: " << sysCall << "\n");
-              if (sysCall == SOAAP_NO_SYSCALLS_ALLOWED) {
-                // Defensive: ideally no other system calls should have been listed
-                // but we play it safe and remove any that may have been annotated 
-                allowedSysCalls.clear();
-                break;
-              }
-              if (Function* sysCallFn = module.getFunction(sysCall)) {
-                SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Adding Function* " << sysCallFn->getName() << "\n");
-                allowedSysCalls.insert(sysCallFn);
-              }
-              else {
-                SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Module doesn't call this syscall, so ignoring\n")
-              }
-            }
-            sysCallLimitPointToAllowedSysCalls[annotateCall] = allowedSysCalls;
-          }
-        }
-      }
+    if (inThisSandbox) {
+      addSysCallLimitPoint(A);
     }
   }
 }
 
+void Sandbox::addSysCallLimitPoint(const Annotation* A) {
+  sysCallLimitPoints.push_back(A->call);
+  sysCallLimitPointToAllowedSysCalls[A->call] = resolveSysCalls(A->items);
+}
+
 
 // check that all entrypoint calls are dominated by a creation call
 void Sandbox::validateCreationPoints() {
@@ -657,7 +650,7 @@ bool Sandbox::validateCreationPointsHelper(BasicBlock* BB, BasicBlockVector& vis
       }
       else if (CallInst* CI = dyn_cast<CallInst>(&I)) {
         trace.push_front(CI);
-        FunctionSet callees = CallGraphUtils::getCallees(CI, ContextUtils::PRIV_CONTEXT, module);
+        FunctionRange callees = CallGraphUtils::getCallees(CI, ContextUtils::PRIV_CONTEXT, module);
         for (Function* callee : callees) {
           if (callee->isDeclaration()) continue;
           if (isEntryPoint(callee)) {
@@ -694,85 +687,43 @@ bool Sandbox::validateCreationPointsHelper(BasicBlock* BB, BasicBlockVector& vis
 }
 
 void Sandbox::findPrivateData() {
-  
-  // initialise with pointers to annotated fields and uses of annotated global variables
-  if (Function* F = module.getFunction("llvm.ptr.annotation.p0i8")) {
-    for (User* U : F->users()) {
-      if (IntrinsicInst* annotateCall = dyn_cast<IntrinsicInst>(U)) {
-        Value* annotatedVar = dyn_cast<Value>(annotateCall->getOperand(0)->stripPointerCasts());
-
-        GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(annotateCall->getOperand(1)->stripPointerCasts());
-        ConstantDataArray* annotationStrValArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-        StringRef annotationStrValCString = annotationStrValArray->getAsCString();
-        
-        if (annotationStrValCString.startswith(SANDBOX_PRIVATE)) {
-          StringRef sandboxName = annotationStrValCString.substr(strlen(SANDBOX_PRIVATE)+1); //+1 because of _
-          if (sandboxName == name) {
-            SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_1 
-                                                   << "Found private data annotation for "
-                                                   << "sandbox \"" << name << "\" for variable "
-                                                   << "\"" << annotatedVar->getName() << "\"");
-            privateData.insert(annotateCall);
-          }
-        }
-        
-        SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_1 << "Sandbox-private struct field: "; annotatedVar->dump(););
-      }
+  // pointers to annotated fields, annotated local variables and annotated
+  // global variables
+  for (const Annotation* A : AnnotationIndex::getAnnotationsForSandbox(name, module)) {
+    if (!A->is(SANDBOX_PRIVATE)) {
+      continue;
     }
-  }
-  
-  if (Function* F = module.getFunction("llvm.var.annotation")) {
-    for (User* U : F->users()) {
-      if (IntrinsicInst* annotateCall = dyn_cast<IntrinsicInst>(U)) {
-        Value* annotatedVar = dyn_cast<Value>(annotateCall->getOperand(0)->stripPointerCasts());
-
-        GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(annotateCall->getOperand(1)->stripPointerCasts());
-        ConstantDataArray* annotationStrValArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-        StringRef annotationStrValCString = annotationStrValArray->getAsCString();
-        if (annotationStrValCString.startswith(SANDBOX_PRIVATE)) {
-          StringRef sandboxName = annotationStrValCString.substr(strlen(SANDBOX_PRIVATE)+1); //+1 because of _
-          if (sandboxName == name) {
-            privateData.insert(annotateCall);
-          }
-        
-          SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_1 << "Sandbox-private local variable: "; annotatedVar->dump(););
-        }
+    switch (A->origin) {
+      case Annotation::PtrAnnotation: {
+        SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_1
+                                               << "Found private data annotation for "
+                                               << "sandbox \"" << name << "\" for variable "
+                                               << "\"" << A->annotated->getName() << "\"");
+        privateData.insert(A->call);
+        break;
       }
-    }
-  }
-
-  // annotations on variables are stored in the llvm.global.annotations global
-  // array
-  if (GlobalVariable* lga = module.getNamedGlobal("llvm.global.annotations")) {
-    ConstantArray* lgaArray = dyn_cast<ConstantArray>(lga->getInitializer()->stripPointerCasts());
-    for (User::op_iterator i=lgaArray->op_begin(), e = lgaArray->op_end(); e!=i; i++) {
-      ConstantStruct* lgaArrayElement = dyn_cast<ConstantStruct>(i->get());
-
-      // get the annotation value first
-      GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(lgaArrayElement->getOperand(1)->stripPointerCasts());
-      ConstantDataArray* annotationStrArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-      StringRef annotationStrArrayCString = annotationStrArray->getAsCString();
-      if (annotationStrArrayCString.startswith(SANDBOX_PRIVATE)) {
-        StringRef sandboxName = annotationStrArrayCString.substr(strlen(SANDBOX_PRIVATE)+1);
-        if (sandboxName == name) {
-          GlobalValue* annotatedVal = dyn_cast<GlobalValue>(lgaArrayElement->getOperand(0)->stripPointerCasts());
-          if (isa<GlobalVariable>(annotatedVal)) {
-            privateData.insert(annotatedVal);
-
-            SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_1 << "Found sandbox-private global variable \"" << annotatedVal->getName() << "\"\n";)
-          }
+      case Annotation::VarAnnotation: {
+        privateData.insert(A->call);
+        SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_1 << "Sandbox-private local variable: "; A->annotated->dump(););
+        break;
+      }
+      case Annotation::GlobalAnnotation: {
+        if (GlobalVariable* G = dyn_cast<GlobalVariable>(A->annotated)) {
+          privateData.insert(G);
+          SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_1 << "Found sandbox-private global variable \"" << G->getName() << "\"\n";)
         }
+        break;
       }
+      default: { }
     }
   }
-
 }
 
-ValueSet Sandbox::getPrivateData() {
+const ValueSet& Sandbox::getPrivateData() {
   return privateData;
 }
 
-InstVector Sandbox::getRegion() {
+const InstVector& Sandbox::getRegion() {
   return region;
 }
 
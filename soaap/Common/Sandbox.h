@@ -36,54 +36,71 @@
 
 #include "Analysis/InfoFlow/Context.h"
 #include "Common/Typedefs.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/Analysis/CallGraph.h"
 
 using namespace llvm;
 
 namespace soaap {
+  class Annotation;
   typedef map<GlobalVariable*,int> GlobalVariableIntMap;
   class Sandbox : public Context {
     public:
-      Sandbox(string n, int i, FunctionSet entries, bool p, Module& m, int o, int c);
+      Sandbox(string n, int i, FunctionSet entries, bool p, Module& m, int o, const ClassSet& c);
       Sandbox(string n, int i, InstVector& region, bool p, Module& m);
       string getName();
       int getNameIdx();
-      FunctionSet getEntryPoints();
+      const SandboxSet& getNameSet();
+      const FunctionSet& getEntryPoints();
       Function* getEnclosingFunc();
       bool isRegionWithin(Function* F);
-      FunctionVector getFunctions();
-      CallInstVector getCalls();
-      CallInstVector getTopLevelCalls();
-      InstVector getRegion();
-      GlobalVariableIntMap getGlobalVarPerms();
-      ValueFunctionSetMap getCapabilities();
+      FunctionRange getFunctions();
+      CallInstRange getCalls();
+      CallInstRange getTopLevelCalls();
+      const InstVector& getRegion();
+      const GlobalVariableIntMap& getGlobalVarPerms();
+      const ValueFunctionSetMap& getCapabilities();
       bool isAllowedToReadGlobalVar(GlobalVariable* gv);
-      FunctionVector getCallgates();
+      bool isAllowedToWriteGlobalVar(GlobalVariable* gv);
+      FunctionRange getCallgates();
       bool isCallgate(Function* F);
       bool isEntryPoint(Function* F);
-      int getClearances();
+      const ClassSet& getClearances();
       int getOverhead();
       bool isPersistent();
-      CallInstVector getCreationPoints();
-      CallInstVector getSysCallLimitPoints();
-      FunctionSet getAllowedSysCalls(CallInst* sysCallLimitPoint);
-      ValueSet getPrivateData();
+      CallInstRange getCreationPoints();
+      CallInstRange getSysCallLimitPoints();
+      const FunctionSet& getAllowedSysCalls(CallInst* sysCallLimitPoint);
+      const ValueSet& getPrivateData();
       bool containsFunction(Function* F);
       bool containsInstruction(Instruction* I);
+      bool isInRegion(Instruction* I);
       bool hasCallgate(Function* F);
       void validateCreationPoints();
       void reinit();
+      void addCallees(CallInst* C, FunctionSet& callees);
       static bool classof(const Context* C) { return C->getKind() == CK_SANDBOX; }
 
     private:
       Module& module;
       string name;
       int nameIdx;
+      SandboxSet nameSet;
       FunctionSet entryPoints;
       InstVector region;
+      // Index over region: each basic block the region touches, and for
+      // blocks only partly inside it, the ordinals (positions within the
+      // block) of the first and last region instruction.
+      struct RegionBlock {
+        bool partial;
+        unsigned first;
+        unsigned last;
+      };
+      DenseMap<const BasicBlock*,RegionBlock> regionBlocks;
+      DenseMap<const Instruction*,unsigned> partialBlockOrdinals;
       bool persistent;
-      int clearances;
+      ClassSet clearances;
       FunctionVector callgates;
       FunctionVector functionsVec;
       DenseSet<Function*> functionsSet;
@@ -98,6 +115,7 @@ namespace soaap {
       ValueSet privateData;
       
       void init();
+      void buildRegionIndex();
       void findSandboxedFunctions();
       void findSandboxedFunctionsHelper(FunctionSet funcs);
       void findSandboxedCalls();
@@ -105,6 +123,8 @@ namespace soaap {
       void findCallgates();
       void findCapabilities();
       void findAllowedSysCalls();
+      void addSysCallLimitPoint(const Annotation* A);
+      FunctionSet resolveSysCalls(const vector<string>& sysCallNames);
       void findCreationPoints();
       void findPrivateData();
       bool validateCreationPointsHelper(BasicBlock* BB, BasicBlockVector& visited, InstTrace& trace);
@@ -34,6 +34,7 @@
 #ifndef SOAAP_COMMON_TYPEDEFS_H
 #define SOAAP_COMMON_TYPEDEFS_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallSet.h"
@@ -49,6 +50,7 @@
 #include <unordered_map>
 #include <utility>
 
+#include "ADT/IndexSet.h"
 #include "Analysis/InfoFlow/Context.h"
 
 using namespace std;
@@ -72,6 +74,11 @@ namespace soaap {
   typedef SmallSet<Value*,16> ValueSet;
   typedef SmallSet<Argument*,16> ArgumentSet;
   typedef pair<CallInst*,Function*> CallGraphEdge;
+  typedef ArrayRef<Function*> FunctionRange;
+  typedef ArrayRef<CallInst*> CallInstRange;
+  typedef ArrayRef<CallGraphEdge> CallGraphEdgeRange;
+  typedef IndexSet SandboxSet;  // set of sandbox name indices
+  typedef IndexSet ClassSet;    // set of classification name indices
 }
 
 #endif
@@ -36,6 +36,7 @@
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include "Common/AnnotationIndex.h"
 #include "Common/Debug.h"
 #include "Util/DebugUtils.h"
 #include "llvm/IR/DebugInfo.h"
@@ -50,12 +51,6 @@ void PerformanceEmulationInstrumenter::instrument(Module& M, SandboxVector& sand
   /* Get LLVM context */
   LLVMContext &C = M.getContext();
 
-  /*
-   * Get the var.annotation intrinsic function from the current
-   * module.
-   */
-  Function* FVA = M.getFunction("llvm.var.annotation");
-
   /* Insert instrumentation for emulating performance */
   Function* enterPersistentSandboxFn
     = M.getFunction("soaap_perf_enter_persistent_sbox");
@@ -80,83 +75,57 @@ void PerformanceEmulationInstrumenter::instrument(Module& M, SandboxVector& sand
        * Check if there are annotated parameters to sandboxed
        * functions.
        */
-      if (FVA) {
-        for (User* U : FVA->users()) {
-          if (IntrinsicInst* annotateCall
-              = dyn_cast<IntrinsicInst>(U)) {
-
-            /* Get the enclosing function */
-            Function* enclosingFunc
-              = annotateCall->getParent()->getParent();
-
-            /*
-             * If the enclosing function does not match the
-             * current sandbox entry point in the outer loop
-             * continue.
-             */
-            if (enclosingFunc != F)
-              continue;
-
-            /* Get the annotated variable as LLVM::Value */
-            Value* annotatedVar
-              = dyn_cast<Value>
-              (annotateCall->getOperand(0)->stripPointerCasts());
-
-            /* Get the annotation as string */
-            GlobalVariable* annotationStrVar
-              = dyn_cast<GlobalVariable>
-              (annotateCall->getOperand(1)->stripPointerCasts());
-            ConstantDataArray* annotationStrValArray
-              = dyn_cast<ConstantDataArray>
-              (annotationStrVar->getInitializer());
-            StringRef annotationStrValCString
-              = annotationStrValArray->getAsCString();
-
-            /*
-             * Record which param was annotated. We have to do
-             * this because llvm creates a local var for the
-             * param by appending .addrN to the end of the param
-             * name and associates the annotation with the newly
-             * created local var i.e. see ifd and ifd.addr1
-             * above
-             */
-            if (DbgDeclareInst* dbgDecl = FindAllocaDbgDeclare(annotatedVar)) {
-              DILocalVariable* varDbg = dbgDecl->getVariable();
-              string annotatedVarName = varDbg->getName().str();
-              Argument* annotatedArg = NULL;
+      for (const Annotation* A : AnnotationIndex::getAnnotationsIn(F, M)) {
+        if (A->origin != Annotation::VarAnnotation)
+          continue;
+
+        Function* enclosingFunc = A->func;
+        Value* annotatedVar = A->annotated;
+        StringRef annotationStrValCString = A->str;
+
+        /*
+         * Record which param was annotated. We have to do
+         * this because llvm creates a local var for the
+         * param by appending .addrN to the end of the param
+         * name and associates the annotation with the newly
+         * created local var i.e. see ifd and ifd.addr1
+         * above
+         */
+        if (DbgDeclareInst* dbgDecl = FindAllocaDbgDeclare(annotatedVar)) {
+          DILocalVariable* varDbg = dbgDecl->getVariable();
+          string annotatedVarName = varDbg->getName().str();
+          Argument* annotatedArg = NULL;
+
+          for (Argument &arg : enclosingFunc->args()) {
+            if (arg.getName().str() == annotatedVarName) {
+              annotatedArg = &arg;
+            }
+          }
 
-              for (Argument &arg : enclosingFunc->args()) {
-                if (arg.getName().str() == annotatedVarName) {
-                  annotatedArg = &arg;
-                }
+          if (annotatedArg != NULL) {
+            if (annotationStrValCString == DATA_IN) {
+              outs() << "__DATA_IN annotated parameter"
+                " found!\n";
+              if (data_in) {
+                errs() << "[XXX] Only one parameter "
+                  "should be annotated with __data_in"
+                  " attribute";
+                return;
               }
-
-              if (annotatedArg != NULL) {
-                if (annotationStrValCString == DATA_IN) {
-                  outs() << "__DATA_IN annotated parameter"
-                    " found!\n";
-                  if (data_in) {
-                    errs() << "[XXX] Only one parameter "
-                      "should be annotated with __data_in"
-                      " attribute";
-                    return;
-                  }
-                  /* Get the data_in param */
-                  data_in = annotatedArg;
-                }
-                else if (annotationStrValCString == DATA_OUT) {
-                  outs() << "__DATA_OUT annotated parameter"
-                    " found!\n";
-                  if (data_out) {
-                    errs() << "[XXX] Only one parameter "
-                      "should be annotated with __data_out"
-                      " attribute";
-                    return;
-                  }
-                  /* Get the data_in param */
-                  data_out = annotatedArg;
-                }
+              /* Get the data_in param */
+              data_in = annotatedArg;
+            }
+            else if (annotationStrValCString == DATA_OUT) {
+              outs() << "__DATA_OUT annotated parameter"
+                " found!\n";
+              if (data_out) {
+                errs() << "[XXX] Only one parameter "
+                  "should be annotated with __data_out"
+                  " attribute";
+                return;
               }
+              /* Get the data_in param */
+              data_out = annotatedArg;
             }
           }
         }
@@ -35,11 +35,19 @@
 
 using namespace soaap;
 
-bool NoSandboxPlatform::isSysCallPermitted(string name) {
+bool NoSandboxPlatform::isSysCallPermitted(const string& name) {
   return true;
 }
 
-bool NoSandboxPlatform::doesSysCallRequireFDRights(string name) {
+bool NoSandboxPlatform::doesSysCallRequireFDRights(const string& name) {
+  return false;
+}
+
+bool NoSandboxPlatform::isSysCallPermitted(SysCallId) {
+  return true;
+}
+
+bool NoSandboxPlatform::doesSysCallRequireFDRights(SysCallId) {
   return false;
 }
 
@@ -39,8 +39,10 @@
 namespace soaap {
   class NoSandboxPlatform : public SandboxPlatform {
     public:
-      virtual bool isSysCallPermitted(string name);
-      virtual bool doesSysCallRequireFDRights(string name);
+      virtual bool isSysCallPermitted(const string& name);
+      virtual bool doesSysCallRequireFDRights(const string& name);
+      virtual bool isSysCallPermitted(SysCallId id);
+      virtual bool doesSysCallRequireFDRights(SysCallId id);
       virtual bool doesProvideProtection();
   };
 }
@@ -35,14 +35,38 @@
 
 using namespace soaap;
 
-bool SandboxPlatform::isSysCallPermitted(string name) {
+bool SandboxPlatform::isSysCallPermitted(const string& name) {
   return permittedSysCalls.count(name) != 0;
 }
 
-bool SandboxPlatform::doesSysCallRequireFDRights(string name) {
+bool SandboxPlatform::doesSysCallRequireFDRights(const string& name) {
   return sysCallsReqFDRights.count(name) != 0;
 }
 
+void SandboxPlatform::bindSysCalls(SysCallProvider& os) {
+  permittedSysCallIds.clear();
+  permittedSysCallIds.resize(os.getNumSysCalls());
+  sysCallIdsReqFDRights.clear();
+  sysCallIdsReqFDRights.resize(os.getNumSysCalls());
+  for (const string& name : permittedSysCalls) {
+    SysCallId id = os.getIdx(name);
+    if (id != SysCallProvider::NoSysCall) {
+      permittedSysCallIds.set(id);
+      if (sysCallsReqFDRights.count(name)) {
+        sysCallIdsReqFDRights.set(id);
+      }
+    }
+  }
+}
+
+bool SandboxPlatform::isSysCallPermitted(SysCallId id) {
+  return id >= 0 && id < (int)permittedSysCallIds.size() && permittedSysCallIds.test(id);
+}
+
+bool SandboxPlatform::doesSysCallRequireFDRights(SysCallId id) {
+  return id >= 0 && id < (int)sysCallIdsReqFDRights.size() && sysCallIdsReqFDRights.test(id);
+}
+
 bool SandboxPlatform::doesProvideProtection() {
   return true;
 }
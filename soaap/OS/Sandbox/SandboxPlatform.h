@@ -34,6 +34,10 @@
 #ifndef SOAAP_OS_SANDBOX_SANDBOXPLATFORM_H
 #define SOAAP_OS_SANDBOX_SANDBOXPLATFORM_H
 
+#include "OS/SysCallProvider.h"
+
+#include "llvm/ADT/BitVector.h"
+
 #include <string>
 #include <unordered_set>
 
@@ -47,12 +51,18 @@ namespace soaap {
       // file descriptor argument, then it may require additional rights
       // to be able to complete. This can be determined by calling
       // doesSysCallRequireFDRights(name).
-      virtual bool isSysCallPermitted(string name);
+      virtual bool isSysCallPermitted(const string& name);
 
       // Sandbox requires rights permitting it to perform system call "name"
       // on its file descriptor argument. The return value only makes sense
       // if isSysCallPermitted(name) returns true.
-      virtual bool doesSysCallRequireFDRights(string name);
+      virtual bool doesSysCallRequireFDRights(const string& name);
+
+      // Translates the permission tables into bitsets indexed by os's
+      // system call ids, for use by the SysCallId overloads below.
+      void bindSysCalls(SysCallProvider& os);
+      virtual bool isSysCallPermitted(SysCallId id);
+      virtual bool doesSysCallRequireFDRights(SysCallId id);
 
       // Does this sandbox platform provide any protection?
       virtual bool doesProvideProtection();
@@ -61,6 +71,8 @@ namespace soaap {
       SandboxPlatform() { } // this is an abstract class
       unordered_set<string> permittedSysCalls;
       unordered_set<string> sysCallsReqFDRights;
+      BitVector permittedSysCallIds;
+      BitVector sysCallIdsReqFDRights;
 
       void addPermittedSysCall(string name, bool reqFDRights = false);
   };
@@ -35,12 +35,13 @@
 
 using namespace soaap;
 
-bool SysCallProvider::isSysCall(string sysCall) {
+bool SysCallProvider::isSysCall(const string& sysCall) {
   return sysCalls.count(sysCall) != 0;
 }
 
-int SysCallProvider::getIdx(string sysCall) {
-  return (sysCallToIdx.find(sysCall) != sysCallToIdx.end()) ? sysCallToIdx[sysCall] : -1;
+int SysCallProvider::getIdx(const string& sysCall) {
+  map<string,int>::const_iterator I = sysCallToIdx.find(sysCall);
+  return (I != sysCallToIdx.end()) ? I->second : NoSysCall;
 }
 
 string SysCallProvider::getSysCall(int idx) {
@@ -48,20 +49,39 @@ string SysCallProvider::getSysCall(int idx) {
 }
 
 void SysCallProvider::addSysCall(string sysCall, bool hasFdArg, int fdArgIdx) {
-  static int nextIdx = 0;
+  static unsigned nextIdx = 0;
   sysCalls.insert(sysCall);
   sysCallToIdx[sysCall] = nextIdx;
   idxToSysCall[nextIdx] = sysCall;
   if (hasFdArg) {
     sysCallToFdArgIdx[sysCall] = fdArgIdx;
   }
+  if (idToFdArgIdx.size() <= nextIdx) {
+    idToFdArgIdx.resize(nextIdx+1, -1);
+  }
+  idToFdArgIdx[nextIdx] = hasFdArg ? fdArgIdx : -1;
   nextIdx++;
 }
 
-bool SysCallProvider::hasFdArg(string sysCall) {
+bool SysCallProvider::hasFdArg(const string& sysCall) {
   return sysCallToFdArgIdx.find(sysCall) != sysCallToFdArgIdx.end();
 }
 
-int SysCallProvider::getFdArgIdx(string sysCall) {
+int SysCallProvider::getFdArgIdx(const string& sysCall) {
   return sysCallToFdArgIdx[sysCall];
 }
+
+void SysCallProvider::resolveSysCalls(Module& M) {
+  funcToSysCallId.clear();
+  for (Function& F : M.functions()) {
+    SysCallId id = getIdx(F.getName().str());
+    if (id != NoSysCall) {
+      funcToSysCallId[&F] = id;
+    }
+  }
+}
+
+SysCallId SysCallProvider::getSysCallId(const Function* F) {
+  DenseMap<const Function*,SysCallId>::const_iterator I = funcToSysCallId.find(F);
+  return (I != funcToSysCallId.end()) ? I->second : NoSysCall;
+}
@@ -34,28 +34,50 @@
 #ifndef SOAAP_OS_SYSCALLPROVIDER_H
 #define SOAAP_OS_SYSCALLPROVIDER_H
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+
 #include <map>
 #include <unordered_set>
 #include <string>
+#include <vector>
 
 using namespace std;
+using namespace llvm;
 
 namespace soaap {
+  // Index of a system call, as assigned by addSysCall()
+  typedef int SysCallId;
+
   class SysCallProvider {
     public:
-      virtual bool isSysCall(string sysCall);
-      virtual int getIdx(string sysCall);
+      static const SysCallId NoSysCall = -1;
+
+      virtual bool isSysCall(const string& sysCall);
+      virtual int getIdx(const string& sysCall);
       virtual string getSysCall(int idx);
       virtual void addSysCall(string sysCall, bool hasFdArg = false, int fdArgIdx = 0); 
-      virtual bool hasFdArg(string sysCall);
-      virtual int getFdArgIdx(string sysCall);
+      virtual bool hasFdArg(const string& sysCall);
+      virtual int getFdArgIdx(const string& sysCall);
       virtual void initSysCalls() = 0;
+
+      // Looks up the system call id of every function in M once, so that
+      // the Function* overloads below do not need to compare names.
+      void resolveSysCalls(Module& M);
+      SysCallId getSysCallId(const Function* F);
+      bool isSysCall(const Function* F) { return getSysCallId(F) != NoSysCall; }
+      bool hasFdArg(SysCallId id) { return id != NoSysCall && idToFdArgIdx[id] != -1; }
+      int getFdArgIdx(SysCallId id) { return idToFdArgIdx[id]; }
+      int getNumSysCalls() { return idToFdArgIdx.size(); }
     
     protected:
       unordered_set<string> sysCalls;
       map<string,int> sysCallToIdx;
       map<int,string> idxToSysCall;
       map<string,int> sysCallToFdArgIdx;
+      vector<int> idToFdArgIdx; // -1 if the system call has no fd arg
+      DenseMap<const Function*,SysCallId> funcToSysCallId;
   };
 }
 
@@ -39,6 +39,8 @@
 #include "soaap.h"
 
 #include "Soaap.h"
+#include "ADT/ValueNumbering.h"
+#include "Common/AnnotationIndex.h"
 #include "Common/CmdLineOpts.h"
 #include "Common/Typedefs.h"
 #include "Common/Sandbox.h"
@@ -49,9 +51,11 @@
 #include "Analysis/CFGFlow/GlobalVariableAnalysis.h"
 #include "Analysis/CFGFlow/SysCallsAnalysis.h"
 #include "Analysis/InfoFlow/AccessOriginAnalysis.h"
+#include "Analysis/InfoFlow/AliasClasses.h"
 #include "Analysis/InfoFlow/CapabilityAnalysis.h"
 #include "Analysis/InfoFlow/CapabilitySysCallsAnalysis.h"
 #include "Analysis/InfoFlow/ClassifiedAnalysis.h"
+#include "Analysis/InfoFlow/ExternModels.h"
 #include "Analysis/InfoFlow/SandboxPrivateAnalysis.h"
 #include "Analysis/InfoFlow/RPC/RPCGraph.h"
 #include "Instrument/PerformanceEmulationInstrumenter.h"
@@ -94,6 +98,15 @@ bool Soaap::runOnModule(Module& M) {
   llvm::CallGraph& CG = getAnalysis<CallGraphWrapperPass>().getCallGraph();
   LLVMAnalyses::setCallGraphAnalysis(&CG);
   
+  // annotations indexed for a previous module are stale
+  AnnotationIndex::clear();
+
+  SDEBUG("soaap", 3, dbgs() << "Compiling extern-function propagation models\n");
+  ExternModels::compile(M);
+
+  // shared by the fact tables of all analyses
+  ValueNumbering::getModuleNumbering().numberModule(M);
+
   outs() << "* Finding class hierarchy (if there is one)\n";
   ClassHierarchyUtils::findClassHierarchy(M);
 
@@ -102,6 +115,7 @@ bool Soaap::runOnModule(Module& M) {
 
   outs() << "* Building basic callgraph\n";
   CallGraphUtils::buildBasicCallGraph(M, sandboxes);
+  CallGraphUtils::compactCallGraph();
   
   CallGraphUtils::warnUnresolvedFuncs(M);
   
@@ -113,6 +127,11 @@ bool Soaap::runOnModule(Module& M) {
 
   outs() << "* Adding annotated/inferred call edges to callgraph (if available)\n";
   CallGraphUtils::loadAnnotatedInferredCallGraphEdges(M, sandboxes);
+  CallGraphUtils::compactCallGraph();
+
+  // shared by the info-flow analyses; refreshed when fp calls gain callees
+  SDEBUG("soaap", 3, dbgs() << "Computing alias classes\n");
+  AliasClasses::getModuleAliases().compute(M);
  
   // reobtain privileged methods
   privilegedMethods = SandboxUtils::getPrivilegedMethods(M);
@@ -219,6 +238,7 @@ void Soaap::processCmdLineArgs(Module& M) {
 
   if (operatingSystem) {
     operatingSystem->initSysCalls();
+    operatingSystem->resolveSysCalls(M);
   }
 
   // process ClSandboxPlatform
@@ -264,6 +284,10 @@ void Soaap::processCmdLineArgs(Module& M) {
     }
   }
 
+  if (sandboxPlatform && operatingSystem) {
+    sandboxPlatform->bindSysCalls(*operatingSystem);
+  }
+
   // process ClReportOutputFormats
   // default value is text
   // TODO: not sure how to specify this in the option itself
@@ -424,8 +448,14 @@ void Soaap::checkFileDescriptors(Module& M) {
 void Soaap::checkSysCalls(Module& M) {
   SysCallsAnalysis sysCallsAnalysis(sandboxPlatform, operatingSystem);
   sysCallsAnalysis.doAnalysis(M, sandboxes);
-  CapabilitySysCallsAnalysis capsAnalysis(CmdLineOpts::ContextInsens, sandboxPlatform, operatingSystem, sysCallsAnalysis);
-  capsAnalysis.doAnalysis(M, sandboxes);
+  if (CmdLineOpts::InfoFlowSparseFacts) {
+    CapabilitySysCallsAnalysis<SparseBitVector<> > capsAnalysis(CmdLineOpts::ContextInsens, sandboxPlatform, operatingSystem, sysCallsAnalysis);
+    capsAnalysis.doAnalysis(M, sandboxes);
+  }
+  else {
+    CapabilitySysCallsAnalysis<IndexSet> capsAnalysis(CmdLineOpts::ContextInsens, sandboxPlatform, operatingSystem, sysCallsAnalysis);
+    capsAnalysis.doAnalysis(M, sandboxes);
+  }
 }
 
 void Soaap::calculatePrivilegedMethods(Module& M) {
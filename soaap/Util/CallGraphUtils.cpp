@@ -31,6 +31,7 @@
  * SUCH DAMAGE.
  */
 
+#include "Analysis/InfoFlow/AliasClasses.h"
 #include "Analysis/InfoFlow/FPAnnotatedTargetsAnalysis.h"
 #include "Analysis/InfoFlow/FPInferredTargetsAnalysis.h"
 #include "Common/CmdLineOpts.h"
@@ -46,6 +47,7 @@
 #include "llvm/Support/GraphWriter.h" 
 #include "llvm/Support/raw_ostream.h"
 
+#include <mutex>
 #include <sstream>
 #include <cxxabi.h>
 
@@ -54,16 +56,16 @@
 using namespace soaap;
 using namespace llvm;
 
-map<const CallInst*, map<Context*, FunctionSet> > CallGraphUtils::callToCallees;
-map<const Function*, map<Context*, FunctionSet> > CallGraphUtils::funcToCallees;
-map<const Function*, map<Context*, set<CallGraphEdge> > > CallGraphUtils::funcToCallEdges;
-map<const Function*, map<Context*, CallInstSet> > CallGraphUtils::calleeToCalls;
+CSRMultimap<pair<const CallInst*,Context*>, Function*> CallGraphUtils::callToCallees;
+CSRMultimap<pair<const Function*,Context*>, Function*> CallGraphUtils::funcToCallees;
+CSRMultimap<pair<const Function*,Context*>, CallGraphEdge> CallGraphUtils::funcToCallEdges;
+CSRMultimap<pair<const Function*,Context*>, CallInst*> CallGraphUtils::calleeToCalls;
+map<Context*,ReachabilityIndex> CallGraphUtils::reachabilityIndices;
 bool CallGraphUtils::caching = false;
-map<Function*, map<Function*,InstTrace> > CallGraphUtils::funcToShortestCallPaths;
+map<pair<Function*,Context*>,CallPathTree> CallGraphUtils::funcToCallPaths;
+map<Sandbox*,CallPathTree> CallGraphUtils::regionToCallPaths;
 
-DAGNode* CallGraphUtils::bottom = new DAGNode;
-map<int,DAGNode*> CallGraphUtils::idToDAGNode;
-map<DAGNode*,int> CallGraphUtils::dagNodeToId;
+TraceTrie<Instruction*> CallGraphUtils::traceTrie;
 
 void CallGraphUtils::listFPCalls(Module& M, SandboxVector& sandboxes) {
   unsigned long numFPcalls = 0;
@@ -119,7 +121,7 @@ void CallGraphUtils::listFPTargets(Module& M, SandboxVector& sandboxes) {
                   outs() << INDENT_4 << T->getName() << " (inferred virtual)\n";
                 }
               }
-              ContextVector contexts = ContextUtils::getContextsForInstruction(C, CmdLineOpts::ContextInsens, sandboxes, M);
+              const ContextVector& contexts = ContextUtils::getContextsForInstruction(C, CmdLineOpts::ContextInsens, sandboxes, M);
               for (Context* Ctx : contexts) {
                 outs() << INDENT_4 << ContextUtils::stringifyContext(Ctx) << ":\n";
                 for (Function* T : getFPAnnotatedTargetsAnalysis().getTargets(C->getCalledValue()->stripPointerCasts(), Ctx)) {
@@ -160,13 +162,14 @@ void CallGraphUtils::loadAnnotatedInferredCallGraphEdges(Module& M, SandboxVecto
   if (CmdLineOpts::PrintCallGraph) {
     XO::emit("Outputting Callgraph...\n");
     map<Function*,map<Function*,int> > funcToCalleeCallCounts;
-    for (pair<const CallInst*, map<Context*, FunctionSet> > p : callToCallees) {
-      const CallInst* C = p.first;
+    for (const pair<const CallInst*,Context*>& key : callToCallees.keys()) {
+      if (key.second == NULL) {
+        continue; // skip the context-merged view
+      }
+      const CallInst* C = key.first;
       Function* F = (Function*)C->getParent()->getParent();
-      for (pair<Context*, FunctionSet> q : p.second) {
-        for (Function* G : q.second) {
-          funcToCalleeCallCounts[F][G]++;
-        }
+      for (Function* G : callToCallees.lookup(key)) {
+        funcToCalleeCallCounts[F][G]++;
       }
     }
     XO::List callgraphRecordList("callgraph_record");
@@ -189,72 +192,36 @@ void CallGraphUtils::loadAnnotatedInferredCallGraphEdges(Module& M, SandboxVecto
 
 }
 
-FunctionSet CallGraphUtils::getCallees(const CallInst* C, Context* Ctx, Module& M) {
+FunctionRange CallGraphUtils::getCallees(const CallInst* C, Context* Ctx, Module& M) {
   SDEBUG("soaap.util.callgraph", 3, dbgs() << INDENT_5 << "Getting callees for call " << *C << "\n");
-  bool debug = false;
-  SDEBUG("soaap.util.callgraph", 3, debug = true);
-  if (debug) {
-    dbgs() << INDENT_5 << "Callees: ";
-    for (Function* F : callToCallees[C][Ctx]) {
-      dbgs() << F->getName() << " ";
-    }
-    dbgs() << "\n";
-  }
-  if (Ctx) {
-    return callToCallees[C][Ctx];
-  }
-  else {
-    // merge contexts
-    FunctionSet result;
-    map<Context*, FunctionSet> ctxToCallees = callToCallees[C];
-    for (pair<Context*, FunctionSet> p : ctxToCallees) {
-      for (Function* F : p.second) {
-        result.insert(F);
-      }
-    }
-    return result;
-  }
+  // a null Ctx looks up the precomputed context-merged callees
+  FunctionRange callees = callToCallees.lookup(make_pair(C, Ctx));
+  SDEBUG("soaap.util.callgraph", 3, dbgs() << INDENT_5 << "Callees: " << stringifyFunctionSet(callees) << "\n");
+  return callees;
 }
 
-FunctionSet CallGraphUtils::getCallees(const Function* F, Context* Ctx, Module& M) {
+FunctionRange CallGraphUtils::getCallees(const Function* F, Context* Ctx, Module& M) {
   SDEBUG("soaap.util.callgraph", 3, dbgs() << INDENT_5 << "Getting callees for function " << F->getName() << "\n");
-  bool debug = false;
-  SDEBUG("soaap.util.callgraph", 3, debug = true);
-  if (debug) {
-    dbgs() << INDENT_5 << "Callees: ";
-    for (Function* F2 : funcToCallees[F][Ctx]) {
-      dbgs() << F->getName() << " ";
-    }
-    dbgs() << "\n";
-  }
-  return funcToCallees[F][Ctx];
+  FunctionRange callees = funcToCallees.lookup(make_pair(F, Ctx));
+  SDEBUG("soaap.util.callgraph", 3, dbgs() << INDENT_5 << "Callees: " << stringifyFunctionSet(callees) << "\n");
+  return callees;
 }
 
-set<CallGraphEdge> CallGraphUtils::getCallGraphEdges(const Function* F, Context* Ctx, Module& M) {
+CallGraphEdgeRange CallGraphUtils::getCallGraphEdges(const Function* F, Context* Ctx, Module& M) {
   SDEBUG("soaap.util.callgraph", 3, dbgs() << INDENT_5 << "Getting callees for function " << F->getName() << "\n");
-  return funcToCallEdges[F][Ctx];
+  return funcToCallEdges.lookup(make_pair(F, Ctx));
 }
 
-CallInstSet CallGraphUtils::getCallers(const Function* F, Context* Ctx, Module& M) {
+CallInstRange CallGraphUtils::getCallers(const Function* F, Context* Ctx, Module& M) {
   SDEBUG("soaap.util.callgraph", 3, dbgs() << INDENT_5 << "Getting callers for " << F->getName() << "\n");
-  if (Ctx) {
-    return calleeToCalls[F][Ctx];
-  }
-  else {
-    CallInstSet result;
-    map<Context*, CallInstSet> ctxToCallers = calleeToCalls[F];
-    for (pair<Context*, CallInstSet> p : ctxToCallers) {
-      for (CallInst* C : p.second) {
-        result.insert(C);
-      }
-    }
-    return result;
-  }
+  // a null Ctx looks up the precomputed context-merged callers
+  return calleeToCalls.lookup(make_pair(F, Ctx));
 }
 
 // build basic context-sensitive callgraph using direct callees only
 void CallGraphUtils::buildBasicCallGraph(Module& M, SandboxVector& sandboxes) {
   ContextVector contexts = ContextUtils::getAllContexts(sandboxes);
+  reachabilityIndices.clear();
 
   if (Function* MainFn = M.getFunction("main")) {
     set<Function*> visited;
@@ -270,7 +237,7 @@ void CallGraphUtils::buildBasicCallGraph(Module& M, SandboxVector& sandboxes) {
 
 }
 
-void CallGraphUtils::buildBasicCallGraphHelper(Module& M, SandboxVector& sandboxes, FunctionSet initialFuncs, Context* Ctx, set<Function*>& visited) {
+void CallGraphUtils::buildBasicCallGraphHelper(Module& M, SandboxVector& sandboxes, const FunctionSet& initialFuncs, Context* Ctx, set<Function*>& visited) {
   
   vector<Function*> worklist;
   set<Function*> processed;
@@ -384,29 +351,59 @@ bool CallGraphUtils::isExternCall(CallInst* C) {
 
 void CallGraphUtils::addCallees(CallInst* C, Context* Ctx, FunctionSet& callees, bool reinit) {
   SDEBUG("soaap.util.callgraph", 3, dbgs() << INDENT_3 << "New callees to add: " << stringifyFunctionSet(callees) << "\n");
-  FunctionSet& currentCallees = (FunctionSet&)callToCallees[C][Ctx];
   Function* EnclosingFunc = C->getParent()->getParent();
   for (Function* callee : callees) {
-    if (currentCallees.insert(callee).second) {
+    if (callToCallees.insert(make_pair(C, Ctx), callee)) {
       SDEBUG("soaap.util.callgraph", 3, dbgs() << INDENT_4 << "Adding: " << callee->getName() << "\n");
-      calleeToCalls[callee][Ctx].insert(C);
-      funcToCallees[EnclosingFunc][Ctx].insert(callee);
-      funcToCallEdges[EnclosingFunc][Ctx].insert(CallGraphEdge(C, callee));
+      callToCallees.insert(make_pair(C, (Context*)NULL), callee);
+      calleeToCalls.insert(make_pair(callee, Ctx), C);
+      calleeToCalls.insert(make_pair(callee, (Context*)NULL), C);
+      funcToCallees.insert(make_pair(EnclosingFunc, Ctx), callee);
+      funcToCallEdges.insert(make_pair(EnclosingFunc, Ctx), CallGraphEdge(C, callee));
+      reachabilityIndices.erase(Ctx);
+      funcToCallPaths.clear();
+      regionToCallPaths.clear();
+      if (isIndirectCall(C)) {
+        // args and returns of C are now unified with those of callee
+        AliasClasses::getModuleAliases().invalidate();
+      }
     }
   }
   if (reinit) {
     if (Sandbox* S = dyn_cast<Sandbox>(Ctx)) {
-      S->reinit();
+      S->addCallees(C, callees);
     }
     else if (Ctx == ContextUtils::PRIV_CONTEXT) {
       Module* M = EnclosingFunc->getParent();
-      SandboxUtils::recalculatePrivilegedMethods(*M);
+      SandboxUtils::addPrivilegedCallees(C, callees, *M);
     }
   }
 }
 
 
-string CallGraphUtils::stringifyFunctionSet(FunctionSet& funcs) {
+// pack all edges added so far into contiguous arrays. Edges added later
+// go into a small overlay until the next compaction.
+void CallGraphUtils::compactCallGraph() {
+  callToCallees.compact();
+  funcToCallees.compact();
+  funcToCallEdges.compact();
+  calleeToCalls.compact();
+}
+
+string CallGraphUtils::stringifyFunctionSet(FunctionRange funcs) {
+  string funcNamesStr = "[";
+  bool first = true;
+  for (Function* F : funcs) {
+    if (!first)
+      funcNamesStr += ",";
+    funcNamesStr += F->getName();
+    first = false;
+  }
+  funcNamesStr += "]";
+  return funcNamesStr;
+}
+
+string CallGraphUtils::stringifyFunctionSet(const FunctionSet& funcs) {
   string funcNamesStr = "[";
   int currIdx = 0;
   bool first = true;
@@ -426,109 +423,95 @@ void CallGraphUtils::dumpDOTGraph() {
   WriteGraph(LLVMAnalyses::getCallGraphAnalysis(), "callgraph");
 }
 
-bool CallGraphUtils::isReachableFrom(Function* Source, Function* Dest, Sandbox* Ctx, Module& M) {
-  set<Function*> visited;
-  return isReachableFromHelper(Source, Source, Dest, Ctx, visited, M);
-}
-
-bool CallGraphUtils::isReachableFromHelper(Function* Source, Function* Curr, Function* Dest, Sandbox* Ctx, set<Function*>& visited, Module& M) {
-  if (Curr == Dest) {
-    return true;
-  }
-  else if (visited.count(Curr) > 0) {
-    return false;
-  }
-  else if (SandboxUtils::isSandboxEntryPoint(M, Curr) && (Ctx != NULL && !Ctx->isEntryPoint(Curr))) {
-    return false;
-  }
-  else {
-    visited.insert(Curr);
-    for (Function* Succ : getCallees(Curr, Ctx, M)) {
-      if (isReachableFromHelper(Source, Succ, Dest, Ctx, visited, M)) {
-        return true;
-      }
+bool CallGraphUtils::isReachableFrom(Function* Source, Function* Dest, Context* Ctx, Module& M) {
+  // map nodes are never moved, so the index can be queried unlocked
+  static std::mutex indicesMutex;
+  map<Context*,ReachabilityIndex>::iterator I;
+  {
+    std::lock_guard<std::mutex> guard(indicesMutex);
+    I = reachabilityIndices.find(Ctx);
+    if (I == reachabilityIndices.end()) {
+      I = reachabilityIndices.insert(make_pair(Ctx, ReachabilityIndex())).first;
+      I->second.build(M, Ctx);
     }
-    return false;
   }
+  return I->second.reaches(Source, Dest);
 }
 
-void CallGraphUtils::calculateShortestCallPathsFromFunc(Function* F, bool privileged, Sandbox* S, Module& M) {
-  // we use Dijkstra's algorithm
-  SDEBUG("soaap.util.callgraph", 3, dbgs() << INDENT_1 << "calculating shortest paths from " << F->getName() << " cache");
-
-  // Find privileged path to instruction I, via a function that calls a sandboxed callee
-  QueueSet<Function*> worklist;
-  unordered_map<Function*,int> distanceFromMain;
-  unordered_map<Function*,Function*> pred;
-  unordered_map<Function*,CallInst*> call;
-
-  worklist.enqueue(F);
-  distanceFromMain[F] = 0;
-  pred[F] = NULL;
-  call[F] = NULL;
+const CallPathTree& CallGraphUtils::getCallPathsFromFunc(Function* F, bool privileged, Sandbox* S, Module& M) {
+  pair<Function*,Context*> key = make_pair(F, privileged ? ContextUtils::PRIV_CONTEXT : S);
+  map<pair<Function*,Context*>,CallPathTree>::iterator I = funcToCallPaths.find(key);
+  if (I == funcToCallPaths.end()) {
+    SDEBUG("soaap.util.callgraph", 3, dbgs() << "populating short call paths (from " << F->getName() << ") cache\n");
+    I = funcToCallPaths.insert(make_pair(key, CallPathTree())).first;
+    I->second.preds[F] = make_pair((Function*)NULL, (CallInst*)NULL);
+    vector<Function*> queue(1, F);
+    calculateShortestCallPaths(I->second, queue, privileged, S, M);
+  }
+  return I->second;
+}
 
-  SDEBUG("soaap.util.callgraph", 3, dbgs() << INDENT_1 << "setting all distances from main to INT_MAX\n")
-  for (Module::iterator F2 = M.begin(), E = M.end(); F2 != E; ++F2) {
-    if (&*F2 != F) {
-      distanceFromMain[&*F2] = INT_MAX;
+// A single search seeded with the callees of all of the region's top-level
+// calls. Each callee is entered through the first call that calls it.
+const CallPathTree& CallGraphUtils::getCallPathsFromRegion(Sandbox* S, Module& M) {
+  map<Sandbox*,CallPathTree>::iterator I = regionToCallPaths.find(S);
+  if (I == regionToCallPaths.end()) {
+    SDEBUG("soaap.util.callgraph", 3, dbgs() << "populating short call paths (from sandboxed region) cache\n");
+    I = regionToCallPaths.insert(make_pair(S, CallPathTree())).first;
+    CallPathTree& tree = I->second;
+    vector<Function*> queue;
+    for (CallInst* C : S->getTopLevelCalls()) {
+      SDEBUG("soaap.util.callgraph", 3, dbgs() << "Call: " << *C << "\n");
+      FunctionRange callees = getCallees(C, S, M);
+      SDEBUG("soaap.util.callgraph", 3, dbgs() << "Callees: " << stringifyFunctionSet(callees) << "\n");
+      for (Function* callee : callees) {
+        if (tree.preds.insert(make_pair(callee, make_pair((Function*)NULL, C))).second) {
+          queue.push_back(callee);
+        }
+      }
     }
+    calculateShortestCallPaths(tree, queue, false, S, M);
   }
+  return I->second;
+}
 
-  SDEBUG("soaap.util.callgraph", 3, dbgs() << INDENT_1 << "computing dijkstra's algorithm\n")
-  while (!worklist.empty()) {
-    Function* F2 = worklist.dequeue();
+// Breadth-first search from the sources in @p queue, which must already be
+// in @p tree. All edges have unit weight, so the first time a function is
+// reached is along a shortest path and it never needs to be revisited.
+void CallGraphUtils::calculateShortestCallPaths(CallPathTree& tree, vector<Function*>& queue, bool privileged, Sandbox* S, Module& M) {
+  SDEBUG("soaap.util.callgraph", 3, dbgs() << INDENT_1 << "calculating shortest paths from " << queue.size() << " source(s)\n");
+
+  Context* Ctx = S ? S : ContextUtils::PRIV_CONTEXT;
+  for (size_t head=0; head<queue.size(); head++) {
+    Function* F2 = queue[head];
     SDEBUG("soaap.util.callgraph", 4, dbgs() << INDENT_2 << "Current func: " << F2->getName() << "\n")
     // only proceed if:
     // a) in the privileged case, N is not a sandbox entrypoint
     // b) in the non-privileged case, if N is a sandbox entrypoint it must be S's
     // (i.e. in both case we are not entering a different protection domain)
-    if (!(privileged && SandboxUtils::isSandboxEntryPoint(M, F2))
-        && !(!privileged && SandboxUtils::isSandboxEntryPoint(M, F2) && !S->isEntryPoint(F2))){
-      for (CallGraphEdge E : getCallGraphEdges(F2, S ? S : ContextUtils::PRIV_CONTEXT, M)) {
-        CallInst* C = E.first;
-        Function* SuccFunc = E.second;
-        // skip non-main root node
-        SDEBUG("soaap.util.callgraph", 4, dbgs() << INDENT_3 << "Succ func: " << SuccFunc->getName() << "\n")
-        if (distanceFromMain[SuccFunc] > distanceFromMain[F2]+1) {
-          distanceFromMain[SuccFunc] = distanceFromMain[F2]+1;
-          pred[SuccFunc] = F2;
-          call[SuccFunc] = C;
-          worklist.enqueue(SuccFunc);
-        }
-      }
+    if (SandboxUtils::isSandboxEntryPoint(M, F2) && (privileged || !S->isEntryPoint(F2))) {
+      continue;
     }
-  }
-
-  // cache shortest paths for each function
-  SDEBUG("soaap.util.callgraph", 3, dbgs() << INDENT_1 << "Caching shortest paths\n")
-  for (Function& F2 : M.functions()) {
-    if (distanceFromMain[&F2] < INT_MAX) { // N is reachable from main
-      InstTrace path;
-      Function* CurrF = &F2;
-      while (CurrF != F) {
-        path.push_back(call[CurrF]);
-        CurrF = pred[CurrF];
+    for (CallGraphEdge E : getCallGraphEdges(F2, Ctx, M)) {
+      Function* SuccFunc = E.second;
+      SDEBUG("soaap.util.callgraph", 4, dbgs() << INDENT_3 << "Succ func: " << SuccFunc->getName() << "\n")
+      if (tree.preds.insert(make_pair(SuccFunc, make_pair(F2, E.first))).second) {
+        queue.push_back(SuccFunc);
       }
-      funcToShortestCallPaths[F][&F2] = path;
-      SDEBUG("soaap.util.callgraph", 3, dbgs() << INDENT_1 << "Paths from " << F->getName() << "() to " << F2.getName() << ": " << path.size() << "\n")
     }
   }
 
-  SDEBUG("soaap.util.callgraph", 4, dbgs() << "completed calculating shortest paths from main cache\n");
+  SDEBUG("soaap.util.callgraph", 4, dbgs() << "completed calculating shortest paths, " << tree.preds.size() << " functions reached\n");
 }
 
 InstTrace CallGraphUtils::findPrivilegedPathToFunction(Function* Target, Module& M) {
   SDEBUG("soaap.util.callgraph", 3, dbgs() << "finding privileged path to function \"" << Target->getName() << "\" (from main)\n");
+  InstTrace callStack;
   if (Function* MainFn = M.getFunction("main")) {
-    if (funcToShortestCallPaths[MainFn].empty()) {
-      SDEBUG("soaap.util.callgraph", 3, dbgs() << "populating short call paths (from main) cache\n");
-      calculateShortestCallPathsFromFunc(MainFn, true, nullptr, M);
-    }
-    InstTrace& callStack = funcToShortestCallPaths[MainFn][Target];
+    getCallPathsFromFunc(MainFn, true, nullptr, M).getTrace(Target, callStack);
     SDEBUG("soaap.util.callgraph", 3, dbgs() << "call stack is empty? " << callStack.empty() << "\n");
-    return callStack;
   }
-  return InstTrace();
+  return callStack;
 }
 
 InstTrace CallGraphUtils::findSandboxedPathToFunction(Function* Target, Sandbox* S, Module& M) {
@@ -538,69 +521,27 @@ InstTrace CallGraphUtils::findSandboxedPathToFunction(Function* Target, Sandbox*
   if (!S->getEntryPoints().empty()) {
     for (Function* F : S->getEntryPoints()) {
       SDEBUG("soaap.util.callgraph", 3, dbgs() << "finding sandboxed path for function-level sandbox\n");
-      if (funcToShortestCallPaths[F].empty()) {
-        SDEBUG("soaap.util.callgraph", 3, dbgs() << "populating short call paths (from " << F->getName() << ") cache\n");
-        calculateShortestCallPathsFromFunc(F, false, S, M);
-      }
       // Find path to Target (in sandbox S) from main() and via S's entrypoint
       privStack = findPrivilegedPathToFunction(F,M);
-      sboxStack = funcToShortestCallPaths[F][Target];
+      sboxStack.clear();
+      getCallPathsFromFunc(F, false, S, M).getTrace(Target, sboxStack);
     }
   }
   else {
     SDEBUG("soaap.util.callgraph", 3, dbgs() << "finding sandboxed path for sandboxed region\n");
     Function* enclosingFunc = S->getEnclosingFunc();
     privStack = findPrivilegedPathToFunction(enclosingFunc, M);
-    CallInstVector calls = S->getTopLevelCalls();
-    map<CallInst*,FunctionSet> callToPotentialSrcs;
-    // Find those call insts within the region (and immediate callees
-    // that can reach Target). In the next phase, we will find the shortest
-    // such path.
-    for (CallInst* C : calls) {
-      SDEBUG("soaap.util.callgraph", 3, dbgs() << "Call: " << *C << "\n");
-      FunctionSet callees = getCallees(C, S, M);
-      SDEBUG("soaap.util.callgraph", 3, dbgs() << "Callees: " << stringifyFunctionSet(callees) << "\n");
-      for (Function* callee : callees) {
-        if (funcToShortestCallPaths[callee].empty()) {
-          SDEBUG("soaap.util.callgraph", 3, dbgs() << "populating short call paths (from " << callee->getName() << ") cache\n");
-          calculateShortestCallPathsFromFunc(callee, false, S, M);
-        }
-        if (funcToShortestCallPaths[callee].find(Target) != funcToShortestCallPaths[callee].end()) {
-          callToPotentialSrcs[C].insert(callee);
-        }
-      }
-    }
-
-    SDEBUG("soaap.util.callgraph", 3, dbgs() << "Finding shortest path from sandboxed region to \"" << Target->getName() << "\""); 
-    // Next, find the shortest path from a call inst in the sandboxed region
-    // to Target
-    tuple<CallInst*,Function*,int> minCallSrc(NULL,NULL,INT_MAX);
-    for (CallInst* C : calls) {
-      for (Function* src : callToPotentialSrcs[C]) {
-        int stackSize = funcToShortestCallPaths[src][Target].size();
-        if (stackSize < get<2>(minCallSrc)) {
-          minCallSrc = make_tuple(C, src, stackSize);
-        }
-      }
-    }
-
-    if (get<2>(minCallSrc) == INT_MAX) {
-      dbgs() << "ERROR: minimum call stack size is still INT_MAX!\n";
+    const CallPathTree& tree = getCallPathsFromRegion(S, M);
+    if (!tree.reaches(Target)) {
+      dbgs() << "ERROR: no call path from sandboxed region to \"" << Target->getName() << "\"\n";
     }
     else {
-      CallInst* call = get<0>(minCallSrc);
-      Function* src = get<1>(minCallSrc);
-      int size = get<2>(minCallSrc);
-      SDEBUG("soaap.util.callgraph", 3, 
-             dbgs() << "Shortest path found from sandboxed region via "
-                    << "\"" << src->getName() << "\" to "
+      // the trace ends with the top-level call in the region
+      tree.getTrace(Target, sboxStack);
+      SDEBUG("soaap.util.callgraph", 3,
+             dbgs() << "Shortest path found from sandboxed region to "
                     << "\"" << Target->getName() << "\", size: "
-                    << size << "\n");
-      // construct sbox stack
-      for (Instruction* I : funcToShortestCallPaths[src][Target]) {
-        sboxStack.push_back(I);
-      }
-      sboxStack.push_back(call);
+                    << sboxStack.size() << "\n");
     }
   }
 
@@ -612,31 +553,10 @@ InstTrace CallGraphUtils::findSandboxedPathToFunction(Function* Target, Sandbox*
   return sboxStack;
 }
 
+// traces are inserted outermost call first, so that traces sharing the
+// same path from main share trie nodes
 int CallGraphUtils::insertIntoTraceDAG(InstTrace& trace) {
-  DAGNode* currNode = bottom;
-  bool newNode = false;
-  for (InstTrace::reverse_iterator I=trace.rbegin(), E=trace.rend(); I!=E; I++) {
-    Instruction* inst = *I;
-    if (currNode->hasChild(inst)) {
-      currNode = currNode->getChild(inst);
-    }
-    else {
-      currNode = currNode->addChild(inst);
-      newNode = true;
-    }
-  }
-  int id;
-  if (newNode || dagNodeToId.find(currNode) == dagNodeToId.end()) {
-    static int nextId = 0;
-    id = nextId++;
-    //dbgs() << "Setting id to " << id << "\n";
-    idToDAGNode[id] = currNode;
-    dagNodeToId[currNode] = id;
-  }
-  else {
-    id = dagNodeToId[currNode];
-  }
-  return id;
+  return traceTrie.insert(trace.rbegin(), trace.rend());
 }
 
 void CallGraphUtils::emitCallTrace(Function* Target, Sandbox* S, Module& M) {
@@ -709,25 +629,27 @@ void CallGraphUtils::emitCallTrace(InstTrace callStack) {
 }
 
 void CallGraphUtils::emitTraceReferences() {
-  for (pair<int,DAGNode*> p : idToDAGNode) {
-    int id = p.first;
-    DAGNode* currNode = p.second;
-    if (currNode == bottom) {
+  for (unsigned traceId=0; traceId<traceTrie.getNumTraces(); traceId++) {
+    int id = traceId;
+    unsigned traceNode = traceTrie.getTraceNode(traceId);
+    unsigned currNode = traceNode;
+    if (currNode == TraceTrie<Instruction*>::Root) {
       continue;
     }
     string traceLabel = ("!trace" + Twine(id)).str();
     XO::Container traceContainer(traceLabel.c_str());
     XO::emit("{e:name/%s}", traceLabel.c_str());
     XO::List trace("trace");
-    while (currNode != bottom) {
-      if (currNode != p.second && dagNodeToId.find(currNode) != dagNodeToId.end()) {
-        id = dagNodeToId[currNode];
+    // emit calls up to the first enclosing trace, which is referred to
+    while (currNode != TraceTrie<Instruction*>::Root) {
+      if (currNode != traceNode && traceTrie.getTraceId(currNode) != TraceTrie<Instruction*>::NoTrace) {
+        id = traceTrie.getTraceId(currNode);
         XO::Instance traceRefInst(trace);
         XO::emit("{e:trace_ref/%s}", ("!trace" + Twine(id)).str().c_str());
         break;
       }
       else {
-        Instruction* I = currNode->getInstruction();
+        Instruction* I = traceTrie.getElement(currNode);
         if (DILocation* Loc = dyn_cast_or_null<DILocation>(I->getMetadata("dbg"))) {
           Function* EnclosingFunc = I->getParent()->getParent();
           unsigned Line = Loc->getLine();
@@ -747,21 +669,26 @@ void CallGraphUtils::emitTraceReferences() {
             XO::emit("{e:library/%s}", library.c_str());
           }
         }
-        currNode = currNode->getParent();
+        currNode = traceTrie.getParent(currNode);
       }
     }
   }
+  traceTrie.clear();
 }
 
 FPTargetsAnalysis& CallGraphUtils::getFPInferredTargetsAnalysis() {
-  static FPInferredTargetsAnalysis* fpInferredTargetsAnalysis
-              = new FPInferredTargetsAnalysis(CmdLineOpts::ContextInsens);
+  static FPTargetsAnalysis* fpInferredTargetsAnalysis
+              = CmdLineOpts::InfoFlowSparseFacts
+                  ? (FPTargetsAnalysis*)new FPInferredTargetsAnalysis<SparseBitVector<> >(CmdLineOpts::ContextInsens)
+                  : (FPTargetsAnalysis*)new FPInferredTargetsAnalysis<IndexSet>(CmdLineOpts::ContextInsens);
   return *fpInferredTargetsAnalysis;
 }
 
 FPTargetsAnalysis& CallGraphUtils::getFPAnnotatedTargetsAnalysis() {
-  static FPAnnotatedTargetsAnalysis* fpAnnotatedTargetsAnalysis
-              = new FPAnnotatedTargetsAnalysis(CmdLineOpts::ContextInsens);
+  static FPTargetsAnalysis* fpAnnotatedTargetsAnalysis
+              = CmdLineOpts::InfoFlowSparseFacts
+                  ? (FPTargetsAnalysis*)new FPAnnotatedTargetsAnalysis<SparseBitVector<> >(CmdLineOpts::ContextInsens)
+                  : (FPTargetsAnalysis*)new FPAnnotatedTargetsAnalysis<IndexSet>(CmdLineOpts::ContextInsens);
   return *fpAnnotatedTargetsAnalysis;
 }
 
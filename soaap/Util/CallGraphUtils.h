@@ -37,45 +37,39 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Support/GraphWriter.h"
 
+#include "ADT/CSRMultimap.h"
+#include "ADT/TraceTrie.h"
 #include "Common/Sandbox.h"
 #include "Common/Typedefs.h"
+#include "Util/ReachabilityIndex.h"
 
 using namespace llvm;
 
 namespace soaap {
   class FPTargetsAnalysis;
-  class DAGNode {
+  // Breadth-first tree of shortest call paths from one or more sources.
+  // Only the predecessor of each reached function is kept; traces are
+  // rebuilt on request by walking back to a source.
+  class CallPathTree {
     public:
-      DAGNode() : DAGNode(nullptr, nullptr) { }
-      DAGNode(DAGNode* p, Instruction* i) : parent(p), inst(i) { }
-
-      DAGNode* parent;
-      Instruction* inst;
-      list<DAGNode*> children;
-
-      bool hasChild(Instruction* I) {
-        for (DAGNode* c : children) {
-          if (c->getInstruction() == I) {
-            return true;
+      bool reaches(const Function* F) const { return preds.count(F) > 0; }
+      // appends the calls on the path to @p Target, innermost first
+      void getTrace(const Function* Target, InstTrace& trace) const {
+        DenseMap<const Function*,pair<Function*,CallInst*> >::const_iterator I = preds.find(Target);
+        while (I != preds.end()) {
+          if (CallInst* C = I->second.second) {
+            trace.push_back(C);
           }
-        }
-        return false;
-      }
-      DAGNode* addChild(Instruction* I) {
-        DAGNode* c = new DAGNode(this, I);
-        children.push_back(c);
-        return c;
-      }
-      DAGNode* getChild(Instruction* I) {
-        for (DAGNode* c : children) {
-          if (c->getInstruction() == I) {
-            return c;
+          if (I->second.first == NULL) {
+            break;
           }
+          I = preds.find(I->second.first);
         }
-        return nullptr;
       }
-      Instruction* getInstruction() { return inst; }
-      DAGNode* getParent() { return parent; }
+
+      // (calling function, call). Sources have no calling function, but
+      // may record the call through which they were entered.
+      DenseMap<const Function*,pair<Function*,CallInst*> > preds;
   };
   class CallGraphUtils {
     public:
@@ -86,17 +80,28 @@ namespace soaap {
       static void listAllFuncs(Module& M);
       static bool isIndirectCall(CallInst* C);
       static Function* getDirectCallee(CallInst* C);
-      static FunctionSet getCallees(const CallInst* C, Context* Ctx, Module& M);
-      static FunctionSet getCallees(const Function* F, Context* Ctx, Module& M);
-      static set<CallGraphEdge> getCallGraphEdges(const Function* F, Context* Ctx, Module& M);
-      static CallInstSet getCallers(const Function* F, Context* Ctx, Module& M);
+      /**
+       * The returned ranges are views into the call graph and are
+       * invalidated by addCallees() and compactCallGraph(). A null @p Ctx
+       * gives the callees/callers across all contexts.
+       */
+      static FunctionRange getCallees(const CallInst* C, Context* Ctx, Module& M);
+      static FunctionRange getCallees(const Function* F, Context* Ctx, Module& M);
+      static CallGraphEdgeRange getCallGraphEdges(const Function* F, Context* Ctx, Module& M);
+      static CallInstRange getCallers(const Function* F, Context* Ctx, Module& M);
       static bool isExternCall(CallInst* C);
       static void addCallees(CallInst* C, Context* Ctx, FunctionSet& callees, bool reinit);
-      static string stringifyFunctionSet(FunctionSet& funcs);
+      static void compactCallGraph();
+      static string stringifyFunctionSet(const FunctionSet& funcs);
+      static string stringifyFunctionSet(FunctionRange funcs);
       static void dumpDOTGraph();
       static InstTrace findPrivilegedPathToFunction(Function* Target, Module& M);
       static InstTrace findSandboxedPathToFunction(Function* Target, Sandbox* S, Module& M);
-      static bool isReachableFrom(Function* Source, Function* Dest, Sandbox* Ctx, Module& M);
+      /**
+       * May be called from several threads at once, provided that each
+       * context's index is only queried by one of them.
+       */
+      static bool isReachableFrom(Function* Source, Function* Dest, Context* Ctx, Module& M);
       /**
        * emits a call trace to @p Target for the given sandbox @p S.
        * If @p S is null then a privileged call graph will be emitted instead.
@@ -108,21 +113,24 @@ namespace soaap {
       static bool isUnresolvedFunc(Function* F);
       static void warnUnresolvedFuncs(Module& M);
     private:
-      static map<const CallInst*, map<Context*, FunctionSet> > callToCallees;
-      static map<const Function*, map<Context*, FunctionSet> > funcToCallees;
-      static map<const Function*, map<Context*, set<CallGraphEdge> > > funcToCallEdges;
-      static map<const Function*, map<Context*, CallInstSet> > calleeToCalls;
-      static map<Function*, map<Function*,InstTrace> > funcToShortestCallPaths; //TODO: check
+      // edges keyed by (call or function, context). callToCallees and
+      // calleeToCalls also hold a context-merged view under a null context.
+      static CSRMultimap<pair<const CallInst*,Context*>, Function*> callToCallees;
+      static CSRMultimap<pair<const Function*,Context*>, Function*> funcToCallees;
+      static CSRMultimap<pair<const Function*,Context*>, CallGraphEdge> funcToCallEdges;
+      static CSRMultimap<pair<const Function*,Context*>, CallInst*> calleeToCalls;
+      static map<Context*,ReachabilityIndex> reachabilityIndices;
+      static map<pair<Function*,Context*>,CallPathTree> funcToCallPaths;
+      static map<Sandbox*,CallPathTree> regionToCallPaths;
       static bool caching;
-      static void buildBasicCallGraphHelper(Module& M, SandboxVector& sandboxes, FunctionSet entryPoints, Context* Ctx, set<Function*>& visited);
-      static void calculateShortestCallPathsFromFunc(Function* F, bool privileged, Sandbox* S, Module& M);
-      static bool isReachableFromHelper(Function* Source, Function* Curr, Function* Dest, Sandbox* Ctx, set<Function*>& visited, Module& M);
+      static void buildBasicCallGraphHelper(Module& M, SandboxVector& sandboxes, const FunctionSet& entryPoints, Context* Ctx, set<Function*>& visited);
+      static const CallPathTree& getCallPathsFromFunc(Function* F, bool privileged, Sandbox* S, Module& M);
+      static const CallPathTree& getCallPathsFromRegion(Sandbox* S, Module& M);
+      static void calculateShortestCallPaths(CallPathTree& tree, vector<Function*>& queue, bool privileged, Sandbox* S, Module& M);
       static FPTargetsAnalysis& getFPAnnotatedTargetsAnalysis();
       static FPTargetsAnalysis& getFPInferredTargetsAnalysis();
       
-      static DAGNode* bottom;
-      static map<int,DAGNode*> idToDAGNode;
-      static map<DAGNode*,int> dagNodeToId;
+      static TraceTrie<Instruction*> traceTrie;
   };
 }
 namespace llvm {
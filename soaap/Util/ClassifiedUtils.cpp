@@ -38,45 +38,36 @@
 using namespace soaap;
 using namespace llvm;
 
-int ClassifiedUtils::nextClassNameBitIdx = 0;
 map<string,int> ClassifiedUtils::classNameToBitIdx;
-map<int,string> ClassifiedUtils::bitIdxToClassName;
+vector<string> ClassifiedUtils::bitIdxToClassName;
 
-string ClassifiedUtils::stringifyClassNames(int classNames) {
+string ClassifiedUtils::stringifyClassNames(const ClassSet& classNames) {
   string classNamesStr = "[";
-  int currIdx = 0;
   bool first = true;
-  for (currIdx=0; currIdx<=31; currIdx++) {
-    if (classNames & (1 << currIdx)) {
-      string className = bitIdxToClassName[currIdx];
-      if (!first) 
-        classNamesStr += ",";
-      classNamesStr += className;
-      first = false;
-    }
+  for (unsigned idx : classNames) {
+    if (!first) 
+      classNamesStr += ",";
+    classNamesStr += bitIdxToClassName[idx];
+    first = false;
   }
   classNamesStr += "]";
   return classNamesStr;
 }
 
-StringVector ClassifiedUtils::convertNamesToVector(int classNames) {
+StringVector ClassifiedUtils::convertNamesToVector(const ClassSet& classNames) {
   StringVector vec;
-  int currIdx = 0;
-  for (currIdx=0; currIdx<=31; currIdx++) {
-    if (classNames & (1 << currIdx)) {
-      string className = bitIdxToClassName[currIdx];
-      vec.push_back(className);
-    }
+  for (unsigned idx : classNames) {
+    vec.push_back(bitIdxToClassName[idx]);
   }
   return vec;
 }
 
 void ClassifiedUtils::assignBitIdxToClassName(string className) {
   if (classNameToBitIdx.find(className) == classNameToBitIdx.end()) {
-    dbgs() << "    Assigning index " << nextClassNameBitIdx << " to class name \"" << className << "\"\n";
-    classNameToBitIdx[className] = nextClassNameBitIdx;
-    bitIdxToClassName[nextClassNameBitIdx] = className;
-    nextClassNameBitIdx++;
+    int idx = bitIdxToClassName.size();
+    dbgs() << "    Assigning index " << idx << " to class name \"" << className << "\"\n";
+    classNameToBitIdx[className] = idx;
+    bitIdxToClassName.push_back(className);
   }
 }
 
@@ -38,6 +38,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 using namespace std;
 
@@ -46,13 +47,12 @@ namespace soaap {
     public:
       static void assignBitIdxToClassName(string className);
       static int getBitIdxFromClassName(string className);
-      static string stringifyClassNames(int classNames);
-      static StringVector convertNamesToVector(int classNames);
+      static string stringifyClassNames(const ClassSet& classNames);
+      static StringVector convertNamesToVector(const ClassSet& classNames);
     
     private:
       static map<string,int> classNameToBitIdx;
-      static map<int,string> bitIdxToClassName;
-      static int nextClassNameBitIdx;
+      static vector<string> bitIdxToClassName;
   };
 }
 
@@ -35,6 +35,7 @@
 #include "Util/ContextUtils.h"
 #include "Util/SandboxUtils.h"
 
+#include "llvm/IR/InstIterator.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -43,6 +44,9 @@ using namespace soaap;
 Context* const ContextUtils::NO_CONTEXT = new Context();
 Context* const ContextUtils::PRIV_CONTEXT = new Context();
 Context* const ContextUtils::SINGLE_CONTEXT = new Context();
+set<ContextVector> ContextUtils::contextLists;
+DenseMap<const Function*, ContextUtils::FunctionContexts> ContextUtils::funcToContexts;
+DenseMap<const Instruction*, const ContextVector*> ContextUtils::instToContexts;
 
 Context* ContextUtils::calleeContext(Context* C, bool contextInsensitive, Function* callee, SandboxVector& sandboxes, Module& M) {
   // callee context is the same sandbox, another sandbox or callgate (privileged)
@@ -61,11 +65,11 @@ Context* ContextUtils::calleeContext(Context* C, bool contextInsensitive, Functi
   return C;
 }
 
-ContextVector ContextUtils::callerContexts(ReturnInst* RI, CallInst* CI, Context* C, bool contextInsensitive, SandboxVector& sandboxes, Module& M) {
+const ContextVector& ContextUtils::callerContexts(ReturnInst* RI, CallInst* CI, Context* C, bool contextInsensitive, SandboxVector& sandboxes, Module& M) {
   // caller context is the same sandbox or other sandboxes/privileged context (if enclosing function is an entry point)
   // TODO: what if RI's enclosing function is a callgate?
   if (contextInsensitive) {
-    return ContextVector(1, SINGLE_CONTEXT);
+    return *intern(ContextVector(1, SINGLE_CONTEXT));
   }
   else {
     Function* enclosingFunc = RI->getParent()->getParent();
@@ -73,33 +77,37 @@ ContextVector ContextUtils::callerContexts(ReturnInst* RI, CallInst* CI, Context
       return getContextsForMethod(CI->getParent()->getParent(), contextInsensitive, sandboxes, M);
     }
     else {
-      return ContextVector(1, C);
+      return *intern(ContextVector(1, C));
     }
   }
 }
 
-ContextVector ContextUtils::getContextsForMethod(Function* F, bool contextInsensitive, SandboxVector& sandboxes, Module& M) {
+const ContextVector& ContextUtils::getContextsForMethod(Function* F, bool contextInsensitive, SandboxVector& sandboxes, Module& M) {
   if (contextInsensitive) {
-    return ContextVector(1, SINGLE_CONTEXT);
+    return *intern(ContextVector(1, SINGLE_CONTEXT));
   }
   else {
-    ContextVector Cs;
-    if (SandboxUtils::isPrivilegedMethod(F, M)) {
-      Cs.push_back(PRIV_CONTEXT);
-    }
-    SandboxVector containers = SandboxUtils::getSandboxesContainingMethod(F, sandboxes);
-    Cs.insert(Cs.begin(), containers.begin(), containers.end());
-    return Cs;
+    return *getFunctionContexts(F, sandboxes, M).contexts;
   }
 }
 
-ContextVector ContextUtils::getContextsForInstruction(Instruction* I, bool contextInsensitive, SandboxVector& sandboxes, Module& M) {
+const ContextVector& ContextUtils::getContextsForInstruction(Instruction* I, bool contextInsensitive, SandboxVector& sandboxes, Module& M) {
   SDEBUG("soaap.util.context", 5, dbgs() << "getContextsForInstruction\n");
   if (contextInsensitive) {
     SDEBUG("soaap.util.context", 5, dbgs() << "context insensitive\n");
-    return ContextVector(1, SINGLE_CONTEXT);
+    return *intern(ContextVector(1, SINGLE_CONTEXT));
   }
   else {
+    // Outside of functions enclosing a sandboxed region, an instruction's
+    // contexts are exactly those of its enclosing function.
+    FunctionContexts FC = getFunctionContexts(I->getParent()->getParent(), sandboxes, M);
+    if (!FC.enclosesRegion) {
+      return *FC.contexts;
+    }
+    DenseMap<const Instruction*, const ContextVector*>::iterator It = instToContexts.find(I);
+    if (It != instToContexts.end()) {
+      return *It->second;
+    }
     ContextVector Cs;
     if (SandboxUtils::isPrivilegedInstruction(I, sandboxes, M)) {
       Cs.push_back(PRIV_CONTEXT);
@@ -107,17 +115,95 @@ ContextVector ContextUtils::getContextsForInstruction(Instruction* I, bool conte
     SDEBUG("soaap.util.context", 5, dbgs() << "looking for sandboxes containing instruction\n");
     SandboxVector containers = SandboxUtils::getSandboxesContainingInstruction(I, sandboxes);
     Cs.insert(Cs.begin(), containers.begin(), containers.end());
-    return Cs;
+    const ContextVector* Interned = intern(Cs);
+    instToContexts[I] = Interned;
+    return *Interned;
+  }
+}
+
+ContextUtils::FunctionContexts ContextUtils::getFunctionContexts(Function* F, SandboxVector& sandboxes, Module& M) {
+  DenseMap<const Function*, FunctionContexts>::iterator It = funcToContexts.find(F);
+  if (It != funcToContexts.end()) {
+    return It->second;
+  }
+  ContextVector Cs;
+  if (SandboxUtils::isPrivilegedMethod(F, M)) {
+    Cs.push_back(PRIV_CONTEXT);
+  }
+  SandboxVector containers = SandboxUtils::getSandboxesContainingMethod(F, sandboxes);
+  Cs.insert(Cs.begin(), containers.begin(), containers.end());
+  FunctionContexts FC;
+  FC.contexts = intern(Cs);
+  FC.enclosesRegion = false;
+  for (Sandbox* S : sandboxes) {
+    if (S->isRegionWithin(F)) {
+      FC.enclosesRegion = true;
+      break;
+    }
+  }
+  funcToContexts[F] = FC;
+  return FC;
+}
+
+const ContextVector* ContextUtils::intern(const ContextVector& Cs) {
+  // set nodes are never moved, so the returned pointer stays valid. Lists
+  // that already exist are only looked up, as the solver's threads do so
+  // concurrently.
+  set<ContextVector>::const_iterator I = contextLists.find(Cs);
+  if (I != contextLists.end()) {
+    return &*I;
   }
+  return &*contextLists.insert(Cs).first;
+}
+
+void ContextUtils::precomputeContextTables(SandboxVector& sandboxes, Module& M) {
+  ContextVector Cs = getAllContexts(sandboxes);
+  Cs.push_back(SINGLE_CONTEXT);
+  for (Context* C : Cs) {
+    intern(ContextVector(1, C));
+  }
+  for (Function& F : M.functions()) {
+    if (getFunctionContexts(&F, sandboxes, M).enclosesRegion) {
+      for (Instruction& I : instructions(&F)) {
+        getContextsForInstruction(&I, false, sandboxes, M);
+      }
+    }
+  }
+}
+
+void ContextUtils::invalidateContextTables() {
+  funcToContexts.clear();
+  instToContexts.clear();
+}
+
+void ContextUtils::invalidateContextsFor(Function* F) {
+  DenseMap<const Function*, FunctionContexts>::iterator It = funcToContexts.find(F);
+  if (It == funcToContexts.end()) {
+    return;
+  }
+  if (It->second.enclosesRegion) {
+    for (Instruction& I : instructions(F)) {
+      instToContexts.erase(&I);
+    }
+  }
+  funcToContexts.erase(It);
 }
 
 bool ContextUtils::isInContext(Instruction* I, Context* C, bool contextInsensitive, SandboxVector& sandboxes, Module& M) {
-  ContextVector Cs = getContextsForInstruction(I, contextInsensitive, sandboxes, M);
+  const ContextVector& Cs = getContextsForInstruction(I, contextInsensitive, sandboxes, M);
   SDEBUG("soaap.util.context", 5, dbgs() << "Looking for " << stringifyContext(C) << " amongst " << Cs.size() << " contexts\n");
   SDEBUG("soaap.util.context", 5, dbgs() << "sandboxes.size(): " << sandboxes.size() << "\n");
   return find(Cs.begin(), Cs.end(), C) != Cs.end();
 }
 
+bool ContextUtils::isFunctionInContext(Function* F, Context* C, bool contextInsensitive, SandboxVector& sandboxes, Module& M) {
+  if (contextInsensitive) {
+    return C == SINGLE_CONTEXT;
+  }
+  FunctionContexts FC = getFunctionContexts(F, sandboxes, M);
+  return !FC.enclosesRegion && find(FC.contexts->begin(), FC.contexts->end(), C) != FC.contexts->end();
+}
+
 string ContextUtils::stringifyContext(Context* C) {
   if (C == PRIV_CONTEXT) {
     return "[<privileged>]";
@@ -34,10 +34,12 @@
 #ifndef SOAAP_UTILS_CONTEXTUTILS_H
 #define SOAAP_UTILS_CONTEXTUTILS_H
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/Function.h"
 #include "Common/Typedefs.h"
 #include "Common/Sandbox.h"
 
+#include <set>
 #include <stack>
 
 using namespace llvm;
@@ -51,12 +53,44 @@ namespace soaap {
       static Context* const SINGLE_CONTEXT;
 
       static Context* calleeContext(Context* C, bool contextInsensitive, Function* callee, SandboxVector& sandboxes, Module& M);
-      static ContextVector callerContexts(ReturnInst* RI, CallInst* CI, Context* C, bool contextInsensitive, SandboxVector& sandboxes, Module& M);
-      static ContextVector getContextsForMethod(Function* F, bool contextInsensitive, SandboxVector& sandboxes, Module& M);
-      static ContextVector getContextsForInstruction(Instruction* I, bool contextInsensitive, SandboxVector& sandboxes, Module& M);
+      /*
+       * The context lists returned below are shared and immutable. They are
+       * cached per function (and per instruction for functions enclosing a
+       * sandboxed region) and stay valid for the lifetime of the process,
+       * even across invalidateContextTables().
+       */
+      static const ContextVector& callerContexts(ReturnInst* RI, CallInst* CI, Context* C, bool contextInsensitive, SandboxVector& sandboxes, Module& M);
+      static const ContextVector& getContextsForMethod(Function* F, bool contextInsensitive, SandboxVector& sandboxes, Module& M);
+      static const ContextVector& getContextsForInstruction(Instruction* I, bool contextInsensitive, SandboxVector& sandboxes, Module& M);
       static bool isInContext(Instruction* I, Context* C, bool contextInsensitive, SandboxVector& sandboxes, Module& M);
+      // whether every instruction of F is in C (i.e. F is in C and does not
+      // enclose a sandboxed region)
+      static bool isFunctionInContext(Function* F, Context* C, bool contextInsensitive, SandboxVector& sandboxes, Module& M);
       static string stringifyContext(Context* C);
       static ContextVector getAllContexts(SandboxVector& sandboxes);
+
+      // Fills the tables for every function of M (and every instruction of
+      // functions enclosing a sandboxed region), so that the lookups above
+      // only read them and may be made from several threads at once, until
+      // the tables are next invalidated.
+      static void precomputeContextTables(SandboxVector& sandboxes, Module& M);
+
+      // Must be called whenever sandbox membership or the set of privileged
+      // methods changes.
+      static void invalidateContextTables();
+      static void invalidateContextsFor(Function* F);
+
+    private:
+      struct FunctionContexts {
+        const ContextVector* contexts;
+        bool enclosesRegion;
+      };
+      static set<ContextVector> contextLists;
+      static DenseMap<const Function*, FunctionContexts> funcToContexts;
+      static DenseMap<const Instruction*, const ContextVector*> instToContexts;
+
+      static const ContextVector* intern(const ContextVector& Cs);
+      static FunctionContexts getFunctionContexts(Function* F, SandboxVector& sandboxes, Module& M);
   };
 }
 
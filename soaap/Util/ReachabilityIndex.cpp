@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "Util/ReachabilityIndex.h"
+#include "Common/Debug.h"
+#include "Util/CallGraphUtils.h"
+#include "Util/SandboxUtils.h"
+
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace soaap;
+
+void ReachabilityIndex::build(Module& M, Context* Ctx) {
+  funcToSCC.clear();
+  sccSuccs.clear();
+  sccToReachable.clear();
+
+  Sandbox* S = dyn_cast_or_null<Sandbox>(Ctx);
+  auto getSuccessors = [&](Function* F, SmallVectorImpl<Function*>& succs) {
+    if (Ctx != NULL && SandboxUtils::isSandboxEntryPoint(M, F) && (S == NULL || !S->isEntryPoint(F))) {
+      return;
+    }
+    FunctionRange callees = CallGraphUtils::getCallees(F, Ctx, M);
+    succs.append(callees.begin(), callees.end());
+  };
+
+  // Iterative Tarjan. A function's SCC number is only known once its SCC
+  // completes, by which point all successor SCCs have been numbered.
+  struct Frame {
+    Function* F;
+    SmallVector<Function*,8> succs;
+    unsigned nextSucc;
+  };
+  DenseMap<const Function*,unsigned> index;
+  DenseMap<const Function*,unsigned> lowlink;
+  DenseMap<const Function*,bool> onStack;
+  vector<Function*> stack;
+  vector<Frame> dfs;
+  unsigned nextIndex = 0;
+
+  for (Function& Root : M.functions()) {
+    if (index.count(&Root)) {
+      continue;
+    }
+    auto push = [&](Function* F) {
+      index[F] = lowlink[F] = nextIndex++;
+      stack.push_back(F);
+      onStack[F] = true;
+      dfs.push_back(Frame());
+      dfs.back().F = F;
+      dfs.back().nextSucc = 0;
+      getSuccessors(F, dfs.back().succs);
+    };
+    push(&Root);
+    while (!dfs.empty()) {
+      Frame& Fr = dfs.back();
+      if (Fr.nextSucc < Fr.succs.size()) {
+        Function* Succ = Fr.succs[Fr.nextSucc++];
+        if (!index.count(Succ)) {
+          push(Succ); // invalidates Fr
+        }
+        else if (onStack[Succ]) {
+          lowlink[Fr.F] = std::min(lowlink[Fr.F], index[Succ]);
+        }
+        continue;
+      }
+      Function* F = Fr.F;
+      dfs.pop_back();
+      if (!dfs.empty()) {
+        Function* P = dfs.back().F;
+        lowlink[P] = std::min(lowlink[P], lowlink[F]);
+      }
+      if (lowlink[F] == index[F]) {
+        unsigned SCC = sccSuccs.size();
+        sccSuccs.push_back(SmallVector<unsigned,4>());
+        SmallVector<Function*,8> members;
+        Function* W;
+        do {
+          W = stack.back();
+          stack.pop_back();
+          onStack[W] = false;
+          funcToSCC[W] = SCC;
+          members.push_back(W);
+        } while (W != F);
+
+        // condensation edges, which all point to already-completed SCCs
+        SmallVector<unsigned,4>& succSCCs = sccSuccs.back();
+        for (Function* Member : members) {
+          SmallVector<Function*,8> succs;
+          getSuccessors(Member, succs);
+          for (Function* Succ : succs) {
+            unsigned SuccSCC = funcToSCC[Succ];
+            if (SuccSCC != SCC) {
+              succSCCs.push_back(SuccSCC);
+            }
+          }
+        }
+        std::sort(succSCCs.begin(), succSCCs.end());
+        succSCCs.erase(std::unique(succSCCs.begin(), succSCCs.end()), succSCCs.end());
+      }
+    }
+  }
+
+  SDEBUG("soaap.util.reachability", 3, dbgs() << "reachability index: " << funcToSCC.size() << " functions in " << sccSuccs.size() << " SCCs\n");
+}
+
+bool ReachabilityIndex::reaches(Function* Source, Function* Dest) {
+  if (Source == Dest) {
+    return true;
+  }
+  DenseMap<const Function*,unsigned>::const_iterator SI = funcToSCC.find(Source);
+  DenseMap<const Function*,unsigned>::const_iterator DI = funcToSCC.find(Dest);
+  if (SI == funcToSCC.end() || DI == funcToSCC.end()) {
+    return false;
+  }
+  unsigned SourceSCC = SI->second;
+  unsigned DestSCC = DI->second;
+  if (SourceSCC == DestSCC) {
+    return true;
+  }
+  else if (DestSCC > SourceSCC) {
+    // successors complete before their predecessors
+    return false;
+  }
+  return getReachableSCCs(SourceSCC).test(DestSCC);
+}
+
+const BitVector& ReachabilityIndex::getReachableSCCs(unsigned SCC) {
+  DenseMap<unsigned,BitVector>::iterator I = sccToReachable.find(SCC);
+  if (I != sccToReachable.end()) {
+    return I->second;
+  }
+  // everything reachable from SCC has a smaller number, so SCC+1 bits suffice
+  BitVector reachable(SCC+1);
+  SmallVector<unsigned,16> worklist;
+  reachable.set(SCC);
+  worklist.push_back(SCC);
+  while (!worklist.empty()) {
+    unsigned Curr = worklist.pop_back_val();
+    DenseMap<unsigned,BitVector>::const_iterator CI = sccToReachable.find(Curr);
+    if (Curr != SCC && CI != sccToReachable.end()) {
+      reachable |= CI->second;
+      continue;
+    }
+    for (unsigned Succ : sccSuccs[Curr]) {
+      if (!reachable.test(Succ)) {
+        reachable.set(Succ);
+        worklist.push_back(Succ);
+      }
+    }
+  }
+  return sccToReachable[SCC] = reachable;
+}
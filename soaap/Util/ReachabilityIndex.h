@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SOAAP_UTILS_REACHABILITYINDEX_H
+#define SOAAP_UTILS_REACHABILITYINDEX_H
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Module.h"
+
+#include "Common/Typedefs.h"
+
+#include <vector>
+
+using namespace llvm;
+
+namespace soaap {
+  class Context;
+
+  // Answers "can Dest be reached from Source?" over the call graph of a
+  // single context without walking the graph on every query.
+  //
+  // The graph is condensed into its strongly-connected components once.
+  // SCCs are numbered in the order Tarjan completes them, which is reverse
+  // topological, so a query whose destination SCC has a larger number than
+  // the source's is answered negatively straight away. Otherwise the set of
+  // SCCs reachable from the source's SCC is computed with an explicit stack
+  // and memoised, so repeated queries from the same function are O(1).
+  //
+  // As in the walk this replaces, entrypoints of sandboxes other than the
+  // one being queried can be reached but are not expanded further.
+  class ReachabilityIndex {
+    public:
+      void build(Module& M, Context* Ctx);
+      bool reaches(Function* Source, Function* Dest);
+      unsigned getNumSCCs() const { return sccSuccs.size(); }
+
+    private:
+      DenseMap<const Function*,unsigned> funcToSCC;
+      vector<SmallVector<unsigned,4> > sccSuccs;
+      DenseMap<unsigned,BitVector> sccToReachable;
+      const BitVector& getReachableSCCs(unsigned SCC);
+  };
+}
+
+#endif
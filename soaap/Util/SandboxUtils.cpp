@@ -31,6 +31,7 @@
  * SUCH DAMAGE.
  */
 
+#include "Common/AnnotationIndex.h"
 #include "Common/Debug.h"
 #include "Common/XO.h"
 #include "Util/CallGraphUtils.h"
@@ -49,8 +50,6 @@
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/IntrinsicInst.h"
 
-#include <sstream>
-
 using namespace soaap;
 using namespace llvm;
 using namespace std;
@@ -58,35 +57,27 @@ using namespace std;
 FunctionSet SandboxUtils::privilegedMethods;
 int SandboxUtils::nextSandboxNameBitIdx = 0;
 map<string,int> SandboxUtils::sandboxNameToBitIdx;
-map<int,string> SandboxUtils::bitIdxToSandboxName;
+StringVector SandboxUtils::bitIdxToSandboxName;
 SmallSet<Function*,16> SandboxUtils::sandboxEntryPoints;
 
-string SandboxUtils::stringifySandboxNames(int sandboxNames) {
+string SandboxUtils::stringifySandboxNames(const SandboxSet& sandboxNames) {
   string sandboxNamesStr = "[";
-  int currIdx = 0;
   bool first = true;
-  for (currIdx=0; currIdx<=31; currIdx++) {
-    if (sandboxNames & (1 << currIdx)) {
-      string sandboxName = bitIdxToSandboxName[currIdx];
-      if (!first) {
-        sandboxNamesStr += ",";
-      }
-      sandboxNamesStr += sandboxName;
-      first = false;
+  for (unsigned currIdx : sandboxNames) {
+    if (!first) {
+      sandboxNamesStr += ",";
     }
+    sandboxNamesStr += bitIdxToSandboxName[currIdx];
+    first = false;
   }
   sandboxNamesStr += "]";
   return sandboxNamesStr;
 }
 
-SandboxVector SandboxUtils::convertNamesToVector(int sandboxNames, SandboxVector& sandboxes) {
+SandboxVector SandboxUtils::convertNamesToVector(const SandboxSet& sandboxNames, SandboxVector& sandboxes) {
   SandboxVector vec;
-  int currIdx = 0;
-  for (currIdx=0; currIdx<=31; currIdx++) {
-    if (sandboxNames & (1 << currIdx)) {
-      string sandboxName = bitIdxToSandboxName[currIdx];
-      vec.push_back(getSandboxWithName(sandboxName, sandboxes));
-    }
+  for (unsigned currIdx : sandboxNames) {
+    vec.push_back(getSandboxWithName(bitIdxToSandboxName[currIdx], sandboxes));
   }
   return vec;
 }
@@ -109,7 +100,7 @@ int SandboxUtils::assignBitIdxToSandboxName(string sandboxName) {
   if (sandboxNameToBitIdx.find(sandboxName) == sandboxNameToBitIdx.end()) {
     outs() << "    Assigning index " << nextSandboxNameBitIdx << " to sandbox name \"" << sandboxName << "\"\n";
     sandboxNameToBitIdx[sandboxName] = nextSandboxNameBitIdx;
-    bitIdxToSandboxName[nextSandboxNameBitIdx] = sandboxName;
+    bitIdxToSandboxName.push_back(sandboxName);
     nextSandboxNameBitIdx++;
     return nextSandboxNameBitIdx-1;
   }
@@ -125,7 +116,7 @@ bool SandboxUtils::isSandboxEntryPoint(Module& M, Function* F) {
 
 SandboxVector SandboxUtils::findSandboxes(Module& M) {
   FunctionIntMap funcToOverhead;
-  FunctionIntMap funcToClearances;
+  map<Function*,ClassSet> funcToClearances;
   map<Function*,string> funcToSandboxName;
   map<string,FunctionSet> sandboxNameToEntryPoints;
   StringSet ephemeralSandboxes;
@@ -135,53 +126,41 @@ SandboxVector SandboxUtils::findSandboxes(Module& M) {
   // function-level annotations of sandboxed code
   Regex *sboxPerfRegex = new Regex("perf_overhead_\\(([0-9]{1,2})\\)", true);
   SmallVector<StringRef, 4> matches;
-  if (GlobalVariable* lga = M.getNamedGlobal("llvm.global.annotations")) {
-    ConstantArray* lgaArray = dyn_cast<ConstantArray>(lga->getInitializer()->stripPointerCasts());
-    for (User::op_iterator i=lgaArray->op_begin(), e = lgaArray->op_end(); e!=i; i++) {
-      ConstantStruct* lgaArrayElement = dyn_cast<ConstantStruct>(i->get());
-
-      // get the annotation value first
-      GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(lgaArrayElement->getOperand(1)->stripPointerCasts());
-      ConstantDataArray* annotationStrArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-      StringRef annotationStrArrayCString = annotationStrArray->getAsCString();
-      GlobalValue* annotatedVal = dyn_cast<GlobalValue>(lgaArrayElement->getOperand(0)->stripPointerCasts());
-      if (isa<Function>(annotatedVal)) {
-        Function* annotatedFunc = dyn_cast<Function>(annotatedVal);
-        StringRef sandboxName;
-        if (annotationStrArrayCString.startswith(SANDBOX_PERSISTENT) || annotationStrArrayCString.startswith(SANDBOX_EPHEMERAL)) {
-          sandboxEntryPoints.insert(annotatedFunc);
-          outs() << INDENT_1 << "Found sandbox entrypoint " << annotatedFunc->getName() << "\n";
-          outs() << INDENT_2 << "Annotation string: " << annotationStrArrayCString << "\n";
-          if (annotationStrArrayCString.startswith(SANDBOX_PERSISTENT)) {
-            sandboxName = annotationStrArrayCString.substr(strlen(SANDBOX_PERSISTENT)+1);
-          }
-          else if (annotationStrArrayCString.startswith(SANDBOX_EPHEMERAL)) {
-            sandboxName = annotationStrArrayCString.substr(strlen(SANDBOX_EPHEMERAL)+1);
-            ephemeralSandboxes.insert(sandboxName);
-          }
-          outs() << INDENT_2 << "Sandbox name: " << sandboxName << "\n";
-          if (funcToSandboxName.find(annotatedFunc) != funcToSandboxName.end()) {
-            outs() << INDENT_1 << "*** Error: Function " << annotatedFunc->getName() << " is already an entrypoint for another sandbox\n";
-          }
-          else {
-            funcToSandboxName[annotatedFunc] = sandboxName;
-            sandboxNameToEntryPoints[sandboxName].insert(annotatedFunc);
-          }
+  for (const Annotation* A : AnnotationIndex::getAnnotations(M)) {
+    if (A->origin == Annotation::GlobalAnnotation && A->func != NULL) {
+      Function* annotatedFunc = A->func;
+      StringRef annotationStrArrayCString = A->str;
+      StringRef sandboxName;
+      if (A->is(SANDBOX_PERSISTENT) || A->is(SANDBOX_EPHEMERAL)) {
+        sandboxEntryPoints.insert(annotatedFunc);
+        outs() << INDENT_1 << "Found sandbox entrypoint " << annotatedFunc->getName() << "\n";
+        outs() << INDENT_2 << "Annotation string: " << annotationStrArrayCString << "\n";
+        sandboxName = A->sandbox;
+        if (A->is(SANDBOX_EPHEMERAL)) {
+          ephemeralSandboxes.insert(sandboxName);
         }
-        else if (sboxPerfRegex->match(annotationStrArrayCString, &matches)) {
-          int overhead;
-          outs() << INDENT_2 << "Threshold set to " << matches[1].str() <<
-                  "%\n";
-          matches[1].getAsInteger(0, overhead);
-          funcToOverhead[annotatedFunc] = overhead;
+        outs() << INDENT_2 << "Sandbox name: " << sandboxName << "\n";
+        if (funcToSandboxName.find(annotatedFunc) != funcToSandboxName.end()) {
+          outs() << INDENT_1 << "*** Error: Function " << annotatedFunc->getName() << " is already an entrypoint for another sandbox\n";
         }
-        else if (annotationStrArrayCString.startswith(CLEARANCE)) {
-          StringRef className = annotationStrArrayCString.substr(strlen(CLEARANCE)+1);
-          outs() << INDENT_2 << "Sandbox has clearance for \"" << className << "\"\n";
-          ClassifiedUtils::assignBitIdxToClassName(className);
-          funcToClearances[annotatedFunc] |= (1 << ClassifiedUtils::getBitIdxFromClassName(className));
+        else {
+          funcToSandboxName[annotatedFunc] = sandboxName;
+          sandboxNameToEntryPoints[sandboxName].insert(annotatedFunc);
         }
       }
+      else if (sboxPerfRegex->match(annotationStrArrayCString, &matches)) {
+        int overhead;
+        outs() << INDENT_2 << "Threshold set to " << matches[1].str() <<
+                "%\n";
+        matches[1].getAsInteger(0, overhead);
+        funcToOverhead[annotatedFunc] = overhead;
+      }
+      else if (A->is(CLEARANCE)) {
+        StringRef className = A->payload;
+        outs() << INDENT_2 << "Sandbox has clearance for \"" << className << "\"\n";
+        ClassifiedUtils::assignBitIdxToClassName(className);
+        funcToClearances[annotatedFunc].set(ClassifiedUtils::getBitIdxFromClassName(className));
+      }
     }
   }
 
@@ -193,7 +172,7 @@ SandboxVector SandboxUtils::findSandboxes(Module& M) {
     FunctionSet entryPoints = p.second;
     int idx = assignBitIdxToSandboxName(sandboxName);
     int overhead = 0;
-    int clearances = 0; 
+    ClassSet clearances;
     bool persistent = find(ephemeralSandboxes.begin(), ephemeralSandboxes.end(), sandboxName) == ephemeralSandboxes.end();
 
     // set overhead and clearances; any of the entry points could be annotated
@@ -226,88 +205,37 @@ SandboxVector SandboxUtils::findSandboxes(Module& M) {
   */
 
   // Handle sandboxed code regions, i.e. start_sandboxed_code(N) and end_sandboxed_code(N) blocks 
-  if (Function* SboxStart = M.getFunction("llvm.annotation.i32")) {
-    for (User* U : SboxStart->users()) {
-      if (IntrinsicInst* annotCall = dyn_cast<IntrinsicInst>(U)) {
-        GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(annotCall->getOperand(1)->stripPointerCasts());
-        ConstantDataArray* annotationStrValArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-        StringRef annotationStrValCString = annotationStrValArray->getAsCString();
-        
-        if (annotationStrValCString.startswith(SOAAP_SANDBOX_REGION_START)) {
-          StringRef sandboxName = annotationStrValCString.substr(strlen(SOAAP_SANDBOX_REGION_START)+1); //+1 because of _
-          SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Found start of sandboxed code region: "; annotCall->dump(););
-          InstVector sandboxedInsts;
-          findAllSandboxedInstructions(annotCall, sandboxName, sandboxedInsts);
-          int idx = assignBitIdxToSandboxName(sandboxName);
-          sandboxes.push_back(new Sandbox(sandboxName, idx, sandboxedInsts, false, M)); //TODO: obtain persistent/ephemeral information in a better way (currently we obtain it from the creation point)
-        }
-      }
+  for (const Annotation* A : AnnotationIndex::getAnnotations(SOAAP_SANDBOX_REGION_START, M)) {
+    if (A->origin == Annotation::CodeAnnotation) {
+      IntrinsicInst* annotCall = A->call;
+      StringRef sandboxName = A->sandbox;
+      SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_3 << "Found start of sandboxed code region: "; annotCall->dump(););
+      InstVector sandboxedInsts;
+      findAllSandboxedInstructions(annotCall, sandboxName, sandboxedInsts);
+      int idx = assignBitIdxToSandboxName(sandboxName);
+      sandboxes.push_back(new Sandbox(sandboxName, idx, sandboxedInsts, false, M)); //TODO: obtain persistent/ephemeral information in a better way (currently we obtain it from the creation point)
     }
   }
 
   // Find other sandboxes that have been referenced in annotations but not
   // explicitly created.  This allows the developer to use annotations, such as
   // __soaap_private(N), to understand what should be sandboxed.
-  if (Function* F = M.getFunction("llvm.ptr.annotation.p0i8")) {
-    for (User* U : F->users()) {
-      if (IntrinsicInst* annotCall = dyn_cast<IntrinsicInst>(U)) {
-        GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(annotCall->getOperand(1)->stripPointerCasts());
-        ConstantDataArray* annotationStrValArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-        StringRef annotationStrValCString = annotationStrValArray->getAsCString();
-        if (annotationStrValCString.startswith(SANDBOX_PRIVATE)) {
-          string sandboxName = annotationStrValCString.substr(strlen(SANDBOX_PRIVATE)+1); //+1 because of _
-          createEmptySandboxIfNew(sandboxName, sandboxes, M);
-        }
-      }
+  // __soaap_private(N) may annotate struct fields, locals and globals, and
+  // globals may also be annotated with __soaap_var_{read,write}(N) and
+  // __soaap_sandboxed(N...)
+  for (const Annotation* A : AnnotationIndex::getAnnotations(M)) {
+    if (A->origin == Annotation::CodeAnnotation) {
+      continue;
     }
-  }
-
-  if (Function* F = M.getFunction("llvm.var.annotation")) {
-    for (User* U : F->users()) {
-      if (IntrinsicInst* annotCall = dyn_cast<IntrinsicInst>(U)) {
-        GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(annotCall->getOperand(1)->stripPointerCasts());
-        ConstantDataArray* annotationStrValArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-        StringRef annotationStrValCString = annotationStrValArray->getAsCString();
-        if (annotationStrValCString.startswith(SANDBOX_PRIVATE)) {
-          string sandboxName = annotationStrValCString.substr(strlen(SANDBOX_PRIVATE)+1); //+1 because of _
-          createEmptySandboxIfNew(sandboxName, sandboxes, M);
-        }
-      }
+    if (A->is(SANDBOX_PRIVATE)) {
+      createEmptySandboxIfNew(A->sandbox, sandboxes, M);
     }
-  }
-
-  // annotations on variables are stored in the llvm.global.annotations global
-  // array
-  if (GlobalVariable* lga = M.getNamedGlobal("llvm.global.annotations")) {
-    ConstantArray* lgaArray = dyn_cast<ConstantArray>(lga->getInitializer()->stripPointerCasts());
-    for (User::op_iterator i=lgaArray->op_begin(), e = lgaArray->op_end(); e!=i; i++) {
-      ConstantStruct* lgaArrayElement = dyn_cast<ConstantStruct>(i->get());
-
-      // get the annotation value first
-      GlobalVariable* annotationStrVar = dyn_cast<GlobalVariable>(lgaArrayElement->getOperand(1)->stripPointerCasts());
-      ConstantDataArray* annotationStrArray = dyn_cast<ConstantDataArray>(annotationStrVar->getInitializer());
-      StringRef annotationStrArrayCStr = annotationStrArray->getAsCString();
-      if (annotationStrArrayCStr.startswith(SANDBOX_PRIVATE)) {
-        string sandboxName = annotationStrArrayCStr.substr(strlen(SANDBOX_PRIVATE)+1);
-        createEmptySandboxIfNew(sandboxName, sandboxes, M);
-      }
-      else if (annotationStrArrayCStr.startswith(VAR_READ)) {
-        string sandboxName = annotationStrArrayCStr.substr(strlen(VAR_READ)+1);
-        createEmptySandboxIfNew(sandboxName, sandboxes, M);
+    else if (A->origin == Annotation::GlobalAnnotation) {
+      if (A->is(VAR_READ) || A->is(VAR_WRITE)) {
+        createEmptySandboxIfNew(A->sandbox, sandboxes, M);
       }
-      else if (annotationStrArrayCStr.startswith(VAR_WRITE)) {
-        string sandboxName = annotationStrArrayCStr.substr(strlen(VAR_WRITE)+1);
-        createEmptySandboxIfNew(sandboxName, sandboxes, M);
-      }
-      else if (annotationStrArrayCStr.startswith(SOAAP_SANDBOXED)) {
-        string sandboxListCsv = annotationStrArrayCStr.substr(strlen(SOAAP_SANDBOXED)+1); //+1 because of _
-        istringstream ss(sandboxListCsv);
-        string sandbox;
-        while(getline(ss, sandbox, ',')) {
-          // trim leading and trailing spaces and quotes ("")
-          size_t start = sandbox.find_first_not_of(" \"");
-          size_t end = sandbox.find_last_not_of(" \"");
-          sandbox = sandbox.substr(start, end-start+1);
+      else if (A->is(SOAAP_SANDBOXED)) {
+        for (const string& sandbox : A->items) {
           createEmptySandboxIfNew(sandbox, sandboxes, M);
         }
       }
@@ -441,7 +369,7 @@ void SandboxUtils::findAllSandboxedInstructions(Instruction* I, string sboxName,
   }
 }
 
-FunctionSet SandboxUtils::getPrivilegedMethods(Module& M) {
+const FunctionSet& SandboxUtils::getPrivilegedMethods(Module& M) {
   if (privilegedMethods.empty()) {
     calculatePrivilegedMethods(M);
   }
@@ -455,20 +383,30 @@ void SandboxUtils::calculatePrivilegedMethods(Module& M) {
 }
 
 void SandboxUtils::calculatePrivilegedMethodsHelper(Module& M, Function* F) {
-  // if a sandbox entry point, then ignore
-  if (isSandboxEntryPoint(M, F))
-    return;
-  
-  // if already visited this function, then ignore as cycle detected
-  if (privilegedMethods.count(F) > 0)
-    return;
-
-  SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_1 << "Added " << F->getName() << " as privileged method\n");
-  privilegedMethods.insert(F);
-
-  // recurse on privileged callees
-  for (Function* SuccFunc : CallGraphUtils::getCallees(F, ContextUtils::PRIV_CONTEXT, M)) {
-    calculatePrivilegedMethodsHelper(M, SuccFunc);
+  // Depth-first walk over privileged callees with an explicit stack, so
+  // that deep call chains cannot overflow the native one. Functions are
+  // added in the same pre-order a recursive walk would produce.
+  SmallVector<pair<FunctionRange,unsigned>,32> stack;
+  auto visit = [&](Function* Curr) {
+    // ignore sandbox entry points, and already-visited functions as a
+    // cycle has been detected
+    if (isSandboxEntryPoint(M, Curr) || privilegedMethods.count(Curr) > 0)
+      return;
+
+    SDEBUG("soaap.util.sandbox", 3, dbgs() << INDENT_1 << "Added " << Curr->getName() << " as privileged method\n");
+    privilegedMethods.insert(Curr);
+    ContextUtils::invalidateContextsFor(Curr);
+    stack.push_back(make_pair(CallGraphUtils::getCallees(Curr, ContextUtils::PRIV_CONTEXT, M), 0u));
+  };
+
+  visit(F);
+  while (!stack.empty()) {
+    pair<FunctionRange,unsigned>& top = stack.back();
+    if (top.second == top.first.size()) {
+      stack.pop_back();
+      continue;
+    }
+    visit(top.first[top.second++]); // may invalidate top
   }
 }
 
@@ -606,9 +544,22 @@ void SandboxUtils::reinitSandboxes(SandboxVector& sandboxes) {
 
 void SandboxUtils::recalculatePrivilegedMethods(Module& M) {
   privilegedMethods.clear();
+  ContextUtils::invalidateContextTables();
   calculatePrivilegedMethods(M);
 }
 
+// Extend the privileged methods with those newly reachable through the
+// privileged-context call-graph edges C -> callees. Edges are only ever
+// added, so this gives the same result as recalculatePrivilegedMethods.
+void SandboxUtils::addPrivilegedCallees(CallInst* C, FunctionSet& callees, Module& M) {
+  if (!isPrivilegedMethod(C->getParent()->getParent(), M)) {
+    return;
+  }
+  for (Function* F : callees) {
+    calculatePrivilegedMethodsHelper(M, F);
+  }
+}
+
 void SandboxUtils::validateSandboxCreations(SandboxVector& sandboxes) {
   for (Sandbox* S : sandboxes) {
     S->validateCreationPoints();
@@ -617,11 +568,8 @@ void SandboxUtils::validateSandboxCreations(SandboxVector& sandboxes) {
 
 bool SandboxUtils::isWithinSandboxedRegion(Instruction* I, SandboxVector& sandboxes) {
   for (Sandbox* S : sandboxes) {
-    if (S->getEntryPoints().empty()) {
-      InstVector region = S->getRegion();
-      if (find(region.begin(), region.end(), I) != region.end()) {
-        return true;
-      }
+    if (S->getEntryPoints().empty() && S->isInRegion(I)) {
+      return true;
     }
   }
   return false;
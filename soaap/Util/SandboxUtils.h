@@ -50,7 +50,7 @@ namespace soaap {
     public:
       static SandboxVector findSandboxes(Module& M);
       static void reinitSandboxes(SandboxVector& sandboxes);
-      static string stringifySandboxNames(int sandboxNames);
+      static string stringifySandboxNames(const SandboxSet& sandboxNames);
       static string stringifySandboxVector(SandboxVector& sandboxes);
       static bool isSandboxEntryPoint(Module& M, Function* F);
       static bool isWithinSandboxedRegion(Instruction* I, SandboxVector& sandboxes);
@@ -61,18 +61,19 @@ namespace soaap {
       static void outputSandboxedFunctions(SandboxVector& sandboxes);
       static void outputPrivilegedFunctions();
       static bool isSandboxedFunction(Function* F, SandboxVector& sandboxes);
-      static SandboxVector convertNamesToVector(int sandboxNames, SandboxVector& sandboxes);
+      static SandboxVector convertNamesToVector(const SandboxSet& sandboxNames, SandboxVector& sandboxes);
       static void validateSandboxCreations(SandboxVector& sandboxes);
       
-      static FunctionSet getPrivilegedMethods(Module& M);
+      static const FunctionSet& getPrivilegedMethods(Module& M);
       static void recalculatePrivilegedMethods(Module& M);
+      static void addPrivilegedCallees(CallInst* C, FunctionSet& callees, Module& M);
       static bool isPrivilegedMethod(Function* F, Module& M);
       static bool isPrivilegedInstruction(Instruction* I, SandboxVector& sandboxes, Module& M);
     
     private:
       static FunctionSet privilegedMethods;
       static map<string,int> sandboxNameToBitIdx;
-      static map<int,string> bitIdxToSandboxName;
+      static StringVector bitIdxToSandboxName;
       static int nextSandboxNameBitIdx;
       static SmallSet<Function*,16> sandboxEntryPoints;
       static void createEmptySandboxIfNew(string name, SandboxVector& sandboxes, Module& M);
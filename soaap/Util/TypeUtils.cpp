@@ -38,16 +38,15 @@
 
 using namespace soaap;
 
-BitVector TypeUtils::convertFunctionSetToBitVector(FunctionSet& set, function<int (Function*)> funcToIdMapper) {
-  BitVector vector;
+IndexSet TypeUtils::convertFunctionSetToIndexSet(const FunctionSet& set, function<int (Function*)> funcToIdMapper) {
+  IndexSet indices;
   for (Function* F : set) {
     int idx = funcToIdMapper(F);
-    if (vector.size() <= idx) {
-      vector.resize(idx+1);
+    if (idx >= 0) { // skip functions without an id
+      indices.set(idx);
     }
-    vector.set(idx);
   }
-  return vector;
+  return indices;
 }
 
 string TypeUtils::stringifyStringSet(StringSet& strings) {
@@ -34,6 +34,7 @@
 #ifndef SOAAP_UTIL_TYPEUTILS_H
 #define SOAAP_UTIL_TYPEUTILS_H
 
+#include "ADT/IndexSet.h"
 #include "Common/Typedefs.h"
 
 #include <functional>
@@ -41,7 +42,7 @@
 namespace soaap {
   class TypeUtils {
     public:
-      static BitVector convertFunctionSetToBitVector(FunctionSet& set, function<int (Function*)> funcToIdMapper);
+      static IndexSet convertFunctionSetToIndexSet(const FunctionSet& set, function<int (Function*)> funcToIdMapper);
       static string stringifyStringSet(StringSet& strings);
   };
 }
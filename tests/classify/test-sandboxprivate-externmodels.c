@@ -0,0 +1,47 @@
+/*
+ * RUN: echo "my_wrap 0 -> ret" > %t.models
+ * RUN: echo "my_copy 1 -> 0" >> %t.models
+ * RUN: clang %cflags -emit-llvm -S %s -o %t.ll
+ * RUN: soaap -soaap-extern-models=%t.models -o %t.soaap.ll %t.ll > %t.out
+ * RUN: FileCheck %s -input-file %t.out
+ *
+ * CHECK: Running Soaap Pass
+ */
+#include "soaap.h"
+
+// extern functions with no builtin propagation model
+char* my_wrap(char* s);
+void my_copy(char* dst, const char* src);
+char* not_modelled(char* s);
+void show(const char* s);
+void write_out(const char* s);
+void other_out(const char* s);
+
+void dostuff();
+
+int main() {
+  dostuff();
+  return 0;
+}
+
+__soaap_sandbox_persistent("box")
+void dostuff() {
+  char* password __soaap_private("box");
+  char buf[16];
+  password = "mypass";
+
+  // arg -> ret
+  // CHECK: may leak private data through the extern function "show"
+  char* wrapped = my_wrap(password);
+  show(wrapped);
+
+  // arg -> arg
+  // CHECK: may leak private data through the extern function "write_out"
+  my_copy(buf, password);
+  write_out(buf);
+
+  // no model, so nothing flows to the return value
+  // CHECK-NOT: may leak private data through the extern function "other_out"
+  char* other = not_modelled(password);
+  other_out(other);
+}
@@ -0,0 +1,83 @@
+/*
+ * RUN: clang %cflags -emit-llvm -S %s -o %t.ll
+ * RUN: soaap -o %t.soaap.ll %t.ll > %t.out
+ * RUN: FileCheck %s -input-file %t.out
+ *
+ * CHECK: Running Soaap Pass
+ */
+#include "soaap.h"
+#include <stdio.h>
+
+/*
+ * 70 sandboxes, each with its own private variable, so that both the
+ * sandbox names and the sandbox-private sources need more than one
+ * 64-bit word.
+ */
+#define BOX(N) \
+  int secret##N __soaap_private("box" #N) = N; \
+  __soaap_sandbox_persistent("box" #N) \
+  void entry##N() { \
+    int v = secret##N; \
+    printf("secret is: %d\n", v); \
+  }
+#define BOX10(T) \
+  BOX(T##0) BOX(T##1) BOX(T##2) BOX(T##3) BOX(T##4) \
+  BOX(T##5) BOX(T##6) BOX(T##7) BOX(T##8) BOX(T##9)
+
+BOX10()
+BOX10(1)
+BOX10(2)
+BOX10(3)
+BOX10(4)
+BOX10(5)
+BOX10(6)
+
+#define READ(N) v += secret##N;
+#define READ10(T) \
+  READ(T##0) READ(T##1) READ(T##2) READ(T##3) READ(T##4) \
+  READ(T##5) READ(T##6) READ(T##7) READ(T##8) READ(T##9)
+
+__soaap_sandbox_persistent("reader")
+void reader() {
+  int v = 0;
+  READ10()
+  READ10(1)
+  READ10(2)
+  READ10(3)
+  READ10(4)
+  READ10(5)
+  READ10(6)
+  printf("secrets sum to: %d\n", v);
+}
+
+#define CALL(N) entry##N();
+#define CALL10(T) \
+  CALL(T##0) CALL(T##1) CALL(T##2) CALL(T##3) CALL(T##4) \
+  CALL(T##5) CALL(T##6) CALL(T##7) CALL(T##8) CALL(T##9)
+
+int main() {
+  CALL10()
+  CALL10(1)
+  CALL10(2)
+  CALL10(3)
+  CALL10(4)
+  CALL10(5)
+  CALL10(6)
+  reader();
+  return 0;
+}
+
+/*
+ * Sandboxes are numbered in the order they are found, so the boxes given
+ * indices 64 and 69 sit in the second word of every sandbox set.
+ *
+ * CHECK: Assigning index 64 to sandbox name "box[[N64:[0-9]+]]"
+ * CHECK: Assigning index 69 to sandbox name "box[[N69:[0-9]+]]"
+ *
+ * CHECK-DAG: *** Sandboxed method "reader" read data value belonging to sandboxes: {{\[}}box[[N64]]{{\]}} but it executes in sandboxes: [reader]
+ * CHECK-DAG: *** Sandboxed method "reader" read data value belonging to sandboxes: {{\[}}box[[N69]]{{\]}} but it executes in sandboxes: [reader]
+ * CHECK-DAG: *** Sandboxed method "reader" read data value belonging to sandboxes: [box0] but it executes in sandboxes: [reader]
+ * CHECK-DAG: *** Sandboxed method "entry[[N64]]" executing in sandboxes: {{\[}}box[[N64]]{{\]}} may leak private data through the extern function "printf"
+ * CHECK-DAG: *** Sandboxed method "entry[[N69]]" executing in sandboxes: {{\[}}box[[N69]]{{\]}} may leak private data through the extern function "printf"
+ * CHECK-DAG: *** Sandboxed method "entry0" executing in sandboxes: [box0] may leak private data through the extern function "printf"
+ */
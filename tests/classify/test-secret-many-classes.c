@@ -0,0 +1,100 @@
+/*
+ * RUN: clang %cflags -emit-llvm -S %s -o %t.ll
+ * RUN: soaap -o %t.soaap.ll %t.ll > %t.out
+ * RUN: FileCheck %s -input-file %t.out
+ * RUN: FileCheck %s -check-prefix=ALLOWED -input-file %t.out
+ *
+ * CHECK: Running Soaap Pass
+ */
+#include "soaap.h"
+#include <stdio.h>
+
+/*
+ * 130 classifications. Clearances are numbered before classifications, so
+ * bar's 67 clearances (secret0 to secret66) take indices 0 to 66, which
+ * spill into a second 64-bit word. The remaining classes take indices 67
+ * to 129, so secret129 sits in a third word, wider than any clearance set.
+ */
+#define CLASS(N) int sensitive##N __soaap_classify("secret" #N);
+#define CLASS10(T) \
+  CLASS(T##0) CLASS(T##1) CLASS(T##2) CLASS(T##3) CLASS(T##4) \
+  CLASS(T##5) CLASS(T##6) CLASS(T##7) CLASS(T##8) CLASS(T##9)
+
+CLASS10()
+CLASS10(1)
+CLASS10(2)
+CLASS10(3)
+CLASS10(4)
+CLASS10(5)
+CLASS10(6)
+CLASS10(7)
+CLASS10(8)
+CLASS10(9)
+CLASS10(10)
+CLASS10(11)
+CLASS10(12)
+
+#define CLEARANCE10(T) \
+  __soaap_clearance("secret" #T "0") __soaap_clearance("secret" #T "1") \
+  __soaap_clearance("secret" #T "2") __soaap_clearance("secret" #T "3") \
+  __soaap_clearance("secret" #T "4") __soaap_clearance("secret" #T "5") \
+  __soaap_clearance("secret" #T "6") __soaap_clearance("secret" #T "7") \
+  __soaap_clearance("secret" #T "8") __soaap_clearance("secret" #T "9")
+
+#define READ(N) v += sensitive##N;
+#define READ10(T) \
+  READ(T##0) READ(T##1) READ(T##2) READ(T##3) READ(T##4) \
+  READ(T##5) READ(T##6) READ(T##7) READ(T##8) READ(T##9)
+
+void foo();
+void bar();
+
+int main() {
+  foo();
+  bar();
+  return 0;
+}
+
+// no clearances, so every classified read is reported
+__soaap_sandbox_persistent("foo")
+void foo() {
+  int y = sensitive67;
+  printf("secret y is: %d\n", y);
+}
+
+// reads every class it has clearance for, including those at index 64 and
+// above, and one class in the third word that it does not
+__soaap_sandbox_persistent("bar")
+__soaap_clearance("secret0") __soaap_clearance("secret1")
+__soaap_clearance("secret2") __soaap_clearance("secret3")
+__soaap_clearance("secret4") __soaap_clearance("secret5")
+__soaap_clearance("secret6") __soaap_clearance("secret7")
+__soaap_clearance("secret8") __soaap_clearance("secret9")
+CLEARANCE10(1)
+CLEARANCE10(2)
+CLEARANCE10(3)
+CLEARANCE10(4)
+CLEARANCE10(5)
+__soaap_clearance("secret60") __soaap_clearance("secret61")
+__soaap_clearance("secret62") __soaap_clearance("secret63")
+__soaap_clearance("secret64") __soaap_clearance("secret65")
+__soaap_clearance("secret66")
+void bar() {
+  int v = 0;
+  READ10()
+  READ10(1)
+  READ10(2)
+  READ10(3)
+  READ10(4)
+  READ10(5)
+  READ(60) READ(61) READ(62) READ(63) READ(64) READ(65) READ(66)
+  READ(129)
+  printf("secrets sum to: %d\n", v);
+}
+
+/*
+ * CHECK-DAG: *** Sandboxed method "foo" read data value of class: [secret67] but only has clearances for: []
+ * CHECK-DAG: *** Sandboxed method "bar" read data value of class: [secret129] but only has clearances for: [{{(secret[0-9]+,){66}secret[0-9]+}}]
+ *
+ * ALLOWED-NOT: "bar" read data value of class: [secret{{([0-9]|[1-5][0-9]|6[0-6])}}]
+ */
@@ -0,0 +1,61 @@
+/*
+ * RUN: clang %cflags -emit-llvm -S %s -o %t.ll
+ * RUN: soaap --soaap-infer-fp-targets --soaap-list-fp-targets -o %t.soaap.ll %t.ll > %t.out
+ * RUN: FileCheck %s -input-file %t.out
+ *
+ * CHECK: Running Soaap Pass
+ */
+#include "soaap.h"
+
+struct handler {
+  void (*fn)();
+};
+
+struct buffer {
+  int len;
+  struct handler h;
+};
+
+// returns a pointer into b
+struct handler* buffer_ptr(struct buffer* b);
+
+void install(struct buffer* b, void (*f)()) {
+  buffer_ptr(b)->fn = f;
+}
+
+void f1() {
+}
+
+void f2() {
+}
+
+__soaap_sandbox_persistent("box1")
+void sandbox1() {
+  struct buffer b1;
+  install(&b1, f1);
+// CHECK: Function "sandbox1"
+// CHECK-NEXT:   Call at {{.*}}:[[@LINE+6]]
+// CHECK-NEXT:     Targets:
+// CHECK-NEXT:       [box1]:
+// CHECK-NEXT:         f1 (inferred)
+// CHECK-NOT:          f2 (inferred)
+// CHECK: Function "sandbox2"
+  b1.h.fn();
+}
+
+__soaap_sandbox_persistent("box2")
+void sandbox2() {
+  struct buffer b2;
+  install(&b2, f2);
+// CHECK-NEXT:   Call at {{.*}}:[[@LINE+5]]
+// CHECK-NEXT:     Targets:
+// CHECK-NEXT:       [box2]:
+// CHECK-NEXT:         f2 (inferred)
+// CHECK-NOT:          f1 (inferred)
+  b2.h.fn();
+}
+
+int main(int argc, char** argv) {
+  sandbox1();
+  sandbox2();
+}
@@ -0,0 +1,54 @@
+/*
+ * RUN: clang %cflags -emit-llvm -S %s -o %t.ll
+ * RUN: soaap --soaap-infer-fp-targets --soaap-list-fp-targets -o %t.soaap.ll %t.ll > %t.out
+ * RUN: FileCheck %s -input-file %t.out
+ *
+ * CHECK: Running Soaap Pass
+ */
+#include "soaap.h"
+
+struct ops {
+  void (*fn)();
+};
+
+// shared by both sandboxes, so its param aliases both of their structs
+void set_handler(struct ops* o, void (*f)()) {
+  o->fn = f;
+}
+
+void f1() {
+}
+
+void f2() {
+}
+
+__soaap_sandbox_persistent("box1")
+void sandbox1() {
+  struct ops o1;
+  set_handler(&o1, f1);
+// CHECK: Function "sandbox1"
+// CHECK-NEXT:   Call at {{.*}}:[[@LINE+6]]
+// CHECK-NEXT:     Targets:
+// CHECK-NEXT:       [box1]:
+// CHECK-NEXT:         f1 (inferred)
+// CHECK-NOT:          f2 (inferred)
+// CHECK: Function "sandbox2"
+  o1.fn();
+}
+
+__soaap_sandbox_persistent("box2")
+void sandbox2() {
+  struct ops o2;
+  set_handler(&o2, f2);
+// CHECK-NEXT:   Call at {{.*}}:[[@LINE+5]]
+// CHECK-NEXT:     Targets:
+// CHECK-NEXT:       [box2]:
+// CHECK-NEXT:         f2 (inferred)
+// CHECK-NOT:          f1 (inferred)
+  o2.fn();
+}
+
+int main(int argc, char** argv) {
+  sandbox1();
+  sandbox2();
+}
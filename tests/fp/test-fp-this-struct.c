@@ -0,0 +1,40 @@
+/*
+ * RUN: clang %cflags -emit-llvm -S %s -o %t.ll
+ * RUN: soaap --soaap-infer-fp-targets --soaap-list-fp-targets -o %t.soaap.ll %t.ll > %t.out
+ * RUN: FileCheck %s -input-file %t.out
+ *
+ * CHECK: Running Soaap Pass
+ */
+#include "soaap.h"
+
+struct ops {
+  void (*fn)();
+};
+
+// "this" params of plain structs are not C++ objects, so ops_set and
+// ops_run do not share the object they point to
+void ops_set(struct ops* this, void (*f)()) {
+  this->fn = f;
+}
+
+void ops_run(struct ops* this) {
+// CHECK: Function "ops_run"
+// CHECK-NEXT:   Call at {{.*}}:[[@LINE+4]]
+// CHECK-NEXT:     Targets:
+// CHECK-NEXT:       [<privileged>]:
+// CHECK-NOT:          f1 (inferred)
+  this->fn();
+}
+
+void f1() {
+}
+
+void f2() {
+}
+
+int main(int argc, char** argv) {
+  struct ops a, b;
+  b.fn = f2;
+  ops_set(&a, f1);
+  ops_run(&b);
+}
@@ -0,0 +1,35 @@
+/*
+ * RUN: clang++ %cflags -emit-llvm -S %s -o %t.ll
+ * RUN: soaap --soaap-infer-fp-targets --soaap-list-fp-targets -o %t.soaap.ll %t.ll | c++filt > %t.out
+ * RUN: FileCheck %s -input-file %t.out
+ *
+ * CHECK: Running Soaap Pass
+ */
+// a function pointer stored through "this" in one method reaches the
+// "this" of the other methods of the class
+void f1() {
+}
+
+void f2() {
+}
+
+class Handler {
+  public:
+    void (*fn)();
+    void set(void (*f)()) { fn = f; }
+    // CHECK: Function "Handler::run()"
+    // CHECK-NEXT:   Call at {{.*}}:[[@LINE+5]]
+    // CHECK-NEXT:     Targets:
+    // CHECK-NEXT:       [<privileged>]:
+    // CHECK-NEXT:         f1() (inferred)
+    // CHECK-NOT:          f2() (inferred)
+    void run() { fn(); }
+};
+
+int main(int argc, char** argv) {
+  Handler* h = new Handler;
+  h->set(f1);
+  h->run();
+  f2();
+  return 0;
+}
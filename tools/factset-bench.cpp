@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2013-2015 Khilan Gudka
+ * All rights reserved.
+ *
+ * This software was developed by SRI International and the University of
+ * Cambridge Computer Laboratory under DARPA/AFRL contract FA8750-10-C-0237
+ * ("CTSRD"), as part of the DARPA CRASH research programme.
+ *
+ * This software was developed at the University of Cambridge Computer
+ * Laboratory with support from a grant from Google, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Compares the dense (IndexSet) and sparse (SparseBitVector) fact types
+ * selected by -soaap-infoflow-sparse-facts, using the solver's own fact
+ * storage (FactTable) and merge operations. Each value starts with a few
+ * random bits out of a universe the size of a module's function or
+ * system call set, and facts are then joined along random edges, as the
+ * solver does when propagating. Memory is counted as in
+ * InfoFlowAnalysis::getFactMemoryUsage. It is not built by default; build
+ * it with "make factset-bench".
+ */
+
+#include "llvm/ADT/SparseBitVector.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "ADT/BitSetTraits.h"
+#include "ADT/FactTable.h"
+#include "ADT/IndexSet.h"
+#include "Analysis/InfoFlow/LatticeTraits.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+using namespace llvm;
+using namespace soaap;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Workload {
+  const char* name;
+  unsigned numValues;
+  unsigned universe;
+  unsigned bitsPerValue;
+  unsigned numJoins;
+};
+
+template<typename FactType>
+static void run(const char* typeName, const Workload& W) {
+  typedef FactTable<FactType,LatticeTraits<FactType> > Table;
+  Table state;
+  Context C;
+  typename Table::Facts& facts = state[&C];
+  mt19937 rng(1);
+
+  Clock::time_point t0 = Clock::now();
+  for (unsigned id=0; id<W.numValues; id++) {
+    FactType F;
+    for (unsigned k=0; k<W.bitsPerValue; k++) {
+      BitSetTraits<FactType>::set(F, rng() % W.universe);
+    }
+    facts.getOrInsert(id) = state.intern(F);
+  }
+  unsigned changes = 0;
+  for (unsigned i=0; i<W.numJoins; i++) {
+    FactId& to = facts.getOrInsert(rng() % W.numValues);
+    FactId from = *facts.lookup(rng() % W.numValues);
+    FactId joined = state.joinIds(to, from);
+    changes += joined != to;
+    to = joined;
+  }
+  Clock::time_point t1 = Clock::now();
+
+  size_t bytes = facts.size() * sizeof(FactId) + state.getInterner().getMemoryUsage();
+  outs() << format("%-12s %-10s %8u distinct facts %9.1f MB %8.0f ms  (%u changed)\n",
+                   W.name, typeName, state.getInterner().size(), bytes / (1024.0*1024.0),
+                   chrono::duration<double,milli>(t1 - t0).count(), changes);
+}
+
+int main(int argc, char** argv) {
+  // few joins, so facts stay as sparse as they start out
+  Workload sparse = { "sparse", 100000, 20000, 3, 20000 };
+  // enough joins along random edges that facts merge into large sets
+  Workload saturated = { "saturated", 20000, 20000, 3, 100000 };
+  for (const Workload& W : { sparse, saturated }) {
+    run<IndexSet>("dense", W);
+    run<SparseBitVector<> >("sparse", W);
+  }
+  return EXIT_SUCCESS;
+}